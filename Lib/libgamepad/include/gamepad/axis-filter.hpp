@@ -0,0 +1,114 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace gamepad {
+
+/* What an axis filter has learned about a device, by lane */
+struct axis_calibration {
+    static constexpr int max_lanes = 64;
+    uint64_t lanes = 0; /* Which lanes have been learned */
+    std::array<int16_t, max_lanes> center = {};
+    std::array<int16_t, max_lanes> deadzone = {};
+};
+
+/* Decides which axis changes of a device are reported. All axes of a
+ * device are filtered together, eight at a time with SSE2 or NEON, in
+ * 16 bit integers. Each axis has a rest position, and at rest a change
+ * is only reported once the axis is further than the deadzone from it.
+ * It then counts as moving until it comes back to within half the
+ * deadzone, and while moving a change is reported if it is more than
+ * the configured deadzone from the last value reported.
+ *
+ * Worn sticks drift, so the rest position and the noise around it are
+ * learned. Every change while the axis is at rest moves the rest position
+ * towards it and updates the average distance from it, the noise floor.
+ * Nothing is learned while it is moving, since that is someone using it,
+ * until it has changed settle_samples times without a change big enough
+ * to report. It has then stopped somewhere, and the rest position may
+ * follow it there, so a stick that comes back off center still ends up
+ * at rest. A slow push starts out looking just like drift though, so each change
+ * may only move the rest position by max_center_step and grow the noise
+ * floor by max_noise_step, while a noise floor that has grown too high
+ * falls back at the full rate. The deadzone is three times the noise
+ * floor, but never less than the configured one or more than
+ * max_deadzone, a sixteenth of the range. A drifting stick ends up with
+ * a deadzone that covers the drift, while a real push still gets past it
+ * and a stick kept moving keeps being reported */
+class axis_filter {
+public:
+    static constexpr int max_lanes = axis_calibration::max_lanes;
+    static constexpr int16_t max_deadzone = 2048; /* Learned, a sixteenth of the range */
+    static constexpr int16_t max_noise = max_deadzone / 3;
+    static constexpr int16_t max_center_step = 2; /* Per sample learned from */
+    static constexpr int16_t max_noise_step = 2;
+    static constexpr int16_t settle_samples = 64; /* Unreported changes before a moving axis has stopped */
+
+private:
+    /* A lane of all ones is true */
+    std::array<int16_t, max_lanes> m_last = {}; /* The last value filtered */
+    std::array<int16_t, max_lanes> m_reported = {};
+    std::array<int16_t, max_lanes> m_center = {};
+    std::array<int16_t, max_lanes> m_noise = {};
+    std::array<int16_t, max_lanes> m_floor = {}; /* Configured deadzone, or -1 */
+    std::array<int16_t, max_lanes> m_step = {}; /* Configured deadzone, at least 0 */
+    std::array<int16_t, max_lanes> m_learn = {};
+    std::array<int16_t, max_lanes> m_seeded = {};
+    std::array<int16_t, max_lanes> m_moving = {};
+    std::array<int16_t, max_lanes> m_quiet = {}; /* Changes since the last report */
+
+public:
+    axis_filter();
+
+    /**
+     * @brief Sets the deadzone of a lane. A negative deadzone reports
+     * every change and learns nothing. What was learned is kept
+     */
+    void configure(int lane, int32_t deadzone);
+
+    /**
+     * @brief Sets the value of a lane without reporting it, for the
+     * state a device starts in. Unless the lane is calibrated already
+     * with a rest position within max_deadzone of it, the value is also
+     * its rest position
+     */
+    void seed(int lane, int16_t value);
+
+    /**
+     * @brief Filters the lanes
+     * @param values The current value of every lane, count of them
+     * @param count Rounded up to a multiple of eight, and at most
+     * max_lanes. values needs as many
+     * @return The lanes whose value should be reported, by bit
+     */
+    uint64_t filter(const int16_t* values, int count);
+
+    /* The deadzone a lane has now, learned or configured */
+    int32_t get_deadzone(int lane) const;
+
+    /* Whether any of the first count lanes has learned a deadzone larger
+     * than the configured one */
+    bool has_drift(int count) const;
+
+    void get_calibration(axis_calibration& c) const;
+    void set_calibration(const axis_calibration& c);
+};
+}
@@ -0,0 +1,147 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+#include "binding.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gamepad {
+namespace cfg {
+    /* Binary form of a bindings file. It is written next to the json
+     * whenever the json has to be parsed, and records the size and
+     * modification time of the json it came from. As long as those still
+     * match, the cache is mapped into memory and used as is. Opening it
+     * validates the header and the bounds of every table once and then
+     * never parses or allocates anything per binding. Lookups are binary
+     * searches over sorted fixed size records, and a binding is only
+     * turned into a cfg::binding when a device or a caller asks for it.
+     * The file is in native byte order and is rejected on a machine with
+     * a different one, or by any other version of this code */
+    namespace cache {
+        constexpr uint32_t version = 1;
+
+        struct header {
+            char magic[4]; /* LGPB */
+            uint32_t version;
+            uint32_t byte_order; /* byte_order_mark as written */
+            uint32_t file_size;
+            uint64_t source_size; /* Of the json it was made from */
+            int64_t source_time; /* Modification time of the json, in ns */
+            uint32_t binding_count;
+            uint32_t device_count;
+            uint32_t entry_count;
+            uint32_t string_size;
+        };
+
+        /* Sorted by name. The axis entries follow the button entries */
+        struct binding {
+            uint32_t name; /* Offset into the string table */
+            uint32_t first_entry;
+            uint16_t button_count;
+            uint16_t axis_count;
+        };
+
+        /* The device ids of the binding map, sorted by id */
+        struct device {
+            uint32_t id; /* Offset into the string table */
+            uint32_t binding; /* Index into the bindings */
+        };
+
+        /* Sorted by native code within each binding */
+        struct entry {
+            uint16_t from; /* Native code */
+            uint16_t to; /* Virtual code */
+        };
+
+        constexpr uint32_t byte_order_mark = 0x01020304;
+    }
+
+    class binding_cache {
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+        void* m_mapping = nullptr; /* The file mapping handle on Windows */
+
+        const cache::header* m_header = nullptr;
+        const cache::binding* m_bindings = nullptr;
+        const cache::device* m_devices = nullptr;
+        const cache::entry* m_entries = nullptr;
+        const char* m_strings = nullptr;
+
+        bool validate();
+        const char* string(uint32_t offset) const { return m_strings + offset; }
+
+    public:
+        binding_cache() = default;
+        binding_cache(const binding_cache&) = delete;
+        binding_cache& operator=(const binding_cache&) = delete;
+        ~binding_cache() { close(); }
+
+        /**
+         * @brief Finds the size and modification time of a source file
+         * @return false if the file can't be found
+         */
+        static bool stat_source(const std::string& path, uint64_t& size, int64_t& time);
+
+        /**
+         * @brief Writes a cache of the bindings and the binding map. The file
+         * is written under a temporary name and renamed over the old one, so
+         * a process that has the old one mapped keeps reading it undisturbed
+         * @param path Where to write the cache
+         * @param source_path The json the bindings came from
+         * @return true on success
+         */
+        static bool write(const std::string& path, const std::string& source_path,
+            const std::vector<std::shared_ptr<binding>>& bindings, const std::map<std::string, std::string>& map);
+
+        /**
+         * @brief Maps a cache into memory
+         * @param path The cache
+         * @param source_path The json it should have been made from
+         * @return false if it is missing, damaged, from another version,
+         * or older than the json
+         */
+        bool open(const std::string& path, const std::string& source_path);
+        void close();
+        bool is_open() const { return m_header != nullptr; }
+
+        size_t binding_count() const { return m_header ? m_header->binding_count : 0; }
+        size_t device_count() const { return m_header ? m_header->device_count : 0; }
+
+        /* Index of the binding with the name, or -1 */
+        int find_binding(const char* name) const;
+
+        /* Index of the binding mapped to the device, or -1 */
+        int find_device_binding(const char* device_id) const;
+
+        const char* get_name(int index) const { return string(m_bindings[index].name); }
+        const char* get_device_id(int device) const { return string(m_devices[device].id); }
+        int get_device_binding(int device) const { return int(m_devices[device].binding); }
+
+        /* The entries of a binding, sorted by native code */
+        const cache::entry* get_buttons(int index, size_t& count) const;
+        const cache::entry* get_axes(int index, size_t& count) const;
+
+        /* Fills in a binding from the cache */
+        void load(int index, binding& b) const;
+    };
+}
+}
@@ -17,11 +17,84 @@
  **/
 
 #pragma once
+#include "binding.hpp"
+#include "device.hpp"
 
 namespace gamepad {
 namespace defaults {
     extern const char* linux_bind_json;
     extern const char* dinput_bind_json;
     extern const char* xinput_bind_json;
+
+    /* The same Linux and XInput defaults as the json, with the tables
+     * used to translate events built by the compiler */
+    constexpr cfg::bind linux_buttons[] = {
+        { 0, button::A },
+        { 1, button::B },
+        { 2, button::X },
+        { 3, button::Y },
+        { 4, button::LB },
+        { 5, button::RB },
+        { 7, button::BACK },
+        { 6, button::START },
+        { 8, button::GUIDE },
+        { 9, button::L_THUMB },
+        { 10, button::R_THUMB },
+        { 11, button::DPAD_LEFT },
+        { 12, button::DPAD_RIGHT },
+        { 13, button::DPAD_UP },
+        { 14, button::DPAD_DOWN }
+    };
+
+    constexpr cfg::bind linux_axes[] = {
+        { 0, axis::LEFT_STICK_X },
+        { 1, axis::LEFT_STICK_Y },
+        { 2, axis::LEFT_TRIGGER },
+        { 3, axis::RIGHT_STICK_X },
+        { 4, axis::RIGHT_STICK_Y },
+        { 5, axis::RIGHT_TRIGGER }
+    };
+
+    constexpr cfg::bind xinput_buttons[] = {
+        { 0x1000, button::A },
+        { 0x2000, button::B },
+        { 0x4000, button::X },
+        { 0x8000, button::Y },
+        { 0x0100, button::LB },
+        { 0x0200, button::RB },
+        { 0x0020, button::BACK },
+        { 0x0010, button::START },
+        { 0x0400, button::GUIDE },
+        { 0x0040, button::L_THUMB },
+        { 0x0080, button::R_THUMB },
+        { 0x0004, button::DPAD_LEFT },
+        { 0x0008, button::DPAD_RIGHT },
+        { 0x0001, button::DPAD_UP },
+        { 0x0002, button::DPAD_DOWN }
+    };
+
+    constexpr cfg::bind xinput_axes[] = {
+        { axis::LEFT_STICK_X, axis::LEFT_STICK_X },
+        { axis::LEFT_STICK_Y, axis::LEFT_STICK_Y },
+        { axis::LEFT_TRIGGER, axis::LEFT_TRIGGER },
+        { axis::RIGHT_STICK_X, axis::RIGHT_STICK_X },
+        { axis::RIGHT_STICK_Y, axis::RIGHT_STICK_Y },
+        { axis::RIGHT_TRIGGER, axis::RIGHT_TRIGGER }
+    };
+
+    constexpr cfg::builtin_binding linux_binding
+        = cfg::make_builtin_binding("Default Linux binding", linux_buttons, linux_axes);
+    constexpr cfg::builtin_binding xinput_binding
+        = cfg::make_builtin_binding("Default Xinput binding", xinput_buttons, xinput_axes);
+
+    static_assert(linux_binding.button_table.is_flat() && linux_binding.axis_table.is_flat(),
+        "The default Linux binding must translate through flat tables");
+    static_assert(xinput_binding.button_table.is_flat() && xinput_binding.axis_table.is_flat(),
+        "The default XInput binding must translate through flat tables");
+    static_assert(linux_binding.button_table.map(7) == button::BACK && linux_binding.axis_table.map(9) == 9,
+        "The default Linux binding tables are wrong");
+    static_assert(xinput_binding.button_table.map(0x8000) == button::Y
+            && xinput_binding.axis_table.map(axis::RIGHT_TRIGGER) == axis::RIGHT_TRIGGER,
+        "The default XInput binding tables are wrong");
 }
 }
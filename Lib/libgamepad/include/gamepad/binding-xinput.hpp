@@ -31,6 +31,10 @@ namespace cfg {
 
     public:
         binding_xinput() = default;
+        binding_xinput(const builtin_binding& builtin)
+            : binding(builtin)
+        {
+        }
 #if LGP_WINDOWS
         binding_xinput(const std::string& json);
 
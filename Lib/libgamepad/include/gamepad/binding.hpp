@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <json/json11.hpp>
 #include <map>
 #include <string>
@@ -25,15 +27,147 @@ namespace gamepad {
 namespace cfg {
     using mappings = std::map<uint16_t, uint16_t>;
 
+    /* Receives parse errors of the default bindings */
+    extern std::string default_error;
+
+    /* One native code and the virtual code it maps to */
+    struct bind {
+        uint16_t from;
+        uint16_t to;
+    };
+
+    /* Flat form of a binding's mappings, for translating events. Every
+     * mapped native code has a slot of its own, found by a multiply, a
+     * shift and a mask that are picked when the table is built so that
+     * no two codes share a slot. Codes that all fit in the table are
+     * indexed directly, as joydev's always do. A lookup is one load and
+     * one compare with no branches and no pointers followed, and a code
+     * that isn't mapped comes back as it is. The tables of the built-in
+     * bindings are built at compile time */
+    class code_table {
+    public:
+        static constexpr uint32_t max_slots = 256;
+
+        constexpr code_table()
+        {
+            clear();
+        }
+
+        /* Returns false if the codes can't be given a slot each in
+         * max_slots or 0xFFFF is one of them, and the table is then not
+         * flat and maps nothing. Later duplicates win */
+        constexpr bool build(const bind* binds, size_t count)
+        {
+            clear();
+            uint32_t largest = 0;
+            for (size_t i = 0; i < count && count <= max_slots; i++)
+                largest = binds[i].from > largest ? binds[i].from : largest;
+
+            /* 0xFFFF marks an empty slot, so it can't be mapped in one */
+            if (count > max_slots || largest == 0xFFFF) {
+                m_flat = false;
+                return false;
+            }
+            if (largest < max_slots)
+                return place(binds, count, 1, 0, max_slots - 1);
+
+            /* Multiplicative hashing on the top bits, trying odd multiples
+             * of the golden ratio until one separates the codes. A table
+             * at most half full needs few tries. Larger ones are tried if
+             * it can't be done */
+            uint32_t bits = 1;
+            while ((1u << bits) < count * 2)
+                bits++;
+            for (; (1u << bits) <= max_slots; bits++) {
+                for (uint32_t attempt = 0; attempt < 1024; attempt++) {
+                    if (place(binds, count, 2654435761u * (attempt * 2 + 1), 32 - bits, (1u << bits) - 1))
+                        return true;
+                }
+            }
+            clear();
+            m_flat = false;
+            return false;
+        }
+
+        constexpr uint16_t map(uint16_t native) const
+        {
+            const bind& slot = m_slots[((uint32_t(native) * m_multiplier) >> m_shift) & m_mask];
+            return slot.from == native ? slot.to : native;
+        }
+
+        constexpr bool is_flat() const { return m_flat; }
+
+    private:
+        /* An empty slot only ever matches 0xFFFF, which it maps to itself */
+        constexpr void clear()
+        {
+            for (auto& slot : m_slots)
+                slot = { 0xFFFF, 0xFFFF };
+            m_multiplier = 1;
+            m_shift = 0;
+            m_mask = 0;
+            m_flat = true;
+        }
+
+        constexpr bool place(const bind* binds, size_t count, uint32_t multiplier, uint32_t shift, uint32_t mask)
+        {
+            /* Slots past the mask are never looked at and stay empty */
+            for (uint32_t s = 0; s <= mask; s++)
+                m_slots[s] = { 0xFFFF, 0xFFFF };
+            m_multiplier = multiplier;
+            m_shift = shift;
+            m_mask = mask;
+            for (size_t i = 0; i < count; i++) {
+                bind& slot = m_slots[((uint32_t(binds[i].from) * multiplier) >> shift) & mask];
+                if (slot.from != 0xFFFF && slot.from != binds[i].from)
+                    return false;
+                slot = binds[i];
+            }
+            return true;
+        }
+
+        bind m_slots[max_slots] = {};
+        uint32_t m_multiplier = 1;
+        uint32_t m_shift = 0;
+        uint32_t m_mask = 0;
+        bool m_flat = true;
+    };
+
+    /* A binding known at compile time, with its tables already built */
+    struct builtin_binding {
+        const char* name;
+        const bind* buttons;
+        size_t button_count;
+        const bind* axes;
+        size_t axis_count;
+        code_table button_table;
+        code_table axis_table;
+    };
+
+    template <size_t buttons, size_t axes>
+    constexpr builtin_binding make_builtin_binding(const char* name, const bind (&b)[buttons], const bind (&a)[axes])
+    {
+        builtin_binding builtin { name, b, buttons, a, axes, code_table(), code_table() };
+        builtin.button_table.build(b, buttons);
+        builtin.axis_table.build(a, axes);
+        return builtin;
+    }
+
     class binding {
     protected:
         std::string m_binding_name;
         mappings m_buttons_mappings;
         mappings m_axis_mappings;
+        code_table m_button_table;
+        code_table m_axis_table;
+
+        /* Used if the mappings can't be made flat, which takes hundreds */
+        static uint16_t map_slow(const mappings& m, uint16_t native);
 
     public:
         binding() = default;
         binding(const std::string& json);
+        binding(const builtin_binding& builtin);
 #ifdef LGP_ENABLE_JSON
         binding(const json11::Json& j);
 
@@ -50,6 +184,24 @@ namespace cfg {
         mappings& get_axis_mappings() { return m_axis_mappings; }
         const mappings& get_button_mappings() const { return m_buttons_mappings; }
         const mappings& get_axis_mappings() const { return m_axis_mappings; }
+
+        /**
+         * @brief Builds the tables used to translate events from the
+         * mappings. Loading and copying do this. Anything that changes
+         * the mappings directly has to call it afterwards
+         */
+        void compile();
+
+        /* The virtual code of a native button or axis, or the native code
+         * if it isn't mapped */
+        uint16_t map_button(uint16_t native) const
+        {
+            return m_button_table.is_flat() ? m_button_table.map(native) : map_slow(m_buttons_mappings, native);
+        }
+        uint16_t map_axis(uint16_t native) const
+        {
+            return m_axis_table.is_flat() ? m_axis_table.map(native) : map_slow(m_axis_mappings, native);
+        }
     };
 }
 }
@@ -18,8 +18,11 @@
 
 #pragma once
 
+#include "axis-filter.hpp"
 #include "binding.hpp"
 #include <array>
+#include <bitset>
+#include <cstddef>
 #include <cmath>
 #include <map>
 #include <memory>
@@ -67,7 +70,10 @@ namespace update_result {
     enum type {
         NONE,
         AXIS = 1 << 0,
-        BUTTON = 1 << 1
+        BUTTON = 1 << 1,
+        PACKET = 1 << 2 /* Input happened since the last poll but the
+                         * state is back where it was, so there is no
+                         * event to report. Only polled devices set this */
     };
 }
 
@@ -81,25 +87,111 @@ struct input_event {
 };
 /* clang-format on */
 
+/* An input event tagged with the device it came from, for batched delivery */
+struct device_event {
+    input_event event;
+    int device_index;   /* gamepad::device::get_index() */
+    int type;           /* update_result::AXIS, BUTTON or PACKET */
+};
+
+/* Receives every event of one poll cycle, for all devices, in one call.
+ * The events are only valid for the duration of the call */
+using batch_callback = void (*)(const device_event* events, size_t count, void* user);
+
+#define LGP_BATCH_SIZE 256
+
+/* Fixed size buffer that devices append events to while they update.
+ * A cycle with more events than fit is delivered in several calls */
+class event_batch {
+    std::array<device_event, LGP_BATCH_SIZE> m_events;
+    size_t m_count = 0;
+    batch_callback m_callback = nullptr;
+    void* m_user = nullptr;
+
+public:
+    void set_callback(batch_callback callback, void* user)
+    {
+        m_callback = callback;
+        m_user = user;
+    }
+
+    bool enabled() const { return m_callback != nullptr; }
+
+    void push(const input_event& e, int device_index, int type)
+    {
+        if (m_count == m_events.size())
+            flush();
+        m_events[m_count++] = { e, device_index, type };
+    }
+
+    void flush()
+    {
+        if (m_count && m_callback)
+            m_callback(m_events.data(), m_count, m_user);
+        m_count = 0;
+    }
+};
+
 class device {
+public:
+    /* Button and axis state is kept in fixed arrays indexed by slot.
+     * The virtual ids come first, followed by the native ids that
+     * Linux reports for inputs the binding doesn't map. Joydev
+     * numbers are 8 bit and only ABS_CNT axes are tracked, so both
+     * ranges are small and a poll cycle never allocates */
+    static constexpr int native_button_count = 256;
+    static constexpr int native_axis_count = 64;
+    static constexpr int button_slot_count = button::COUNT + native_button_count;
+    static constexpr int axis_slot_count = axis::COUNT + native_axis_count;
+
+    /* Returns -1 for ids that have no slot */
+    static inline int button_slot(uint16_t code)
+    {
+        if (code >= button::A && code < button::LAST)
+            return code - button::A;
+        return code < native_button_count ? button::COUNT + code : -1;
+    }
+
+    static inline int axis_slot(uint16_t code)
+    {
+        if (code >= axis::LEFT_STICK_X && code < axis::LAST)
+            return code - axis::LEFT_STICK_X;
+        return code < native_axis_count ? axis::COUNT + code : -1;
+    }
+
+    static inline uint16_t button_code(int slot) { return uint16_t(slot < button::COUNT ? button::A + slot : slot - button::COUNT); }
+    static inline uint16_t axis_code(int slot) { return uint16_t(slot < axis::COUNT ? axis::LEFT_STICK_X + slot : slot - axis::COUNT); }
+
 protected:
     /**
-     * @brief Maps a button code to its state
+     * @brief Button states by slot.
      * On Windows this will only contain X-Box gamepad::buttons
-     * when using XInput. With DirectInput or on Linux it will
-     * contain all button inputs.
+     * when using XInput. On Linux unmapped buttons are stored
+     * under their native id.
      */
-    std::map<uint16_t, bool> m_buttons;
+    std::bitset<button_slot_count> m_buttons;
 
     /**
-     * @brief Maps an axis to it's state.
+     * @brief Axis states by slot.
      * The state will range from -1 to 1.
      * For most gamepads the axis mapping in gamepad::axis is used,
      * but for gamepads with more axis this will also contain them
      */
-    std::map<uint16_t, float> m_axis;
+    std::array<float, axis_slot_count> m_axis = {};
 
-    std::map<uint16_t, int32_t> m_axis_deadzones;
+    /* Which slots have received an event, for the map views */
+    std::bitset<button_slot_count> m_buttons_seen;
+    std::bitset<axis_slot_count> m_axis_seen;
+
+    /* A negative deadzone means every change is reported. These are the
+     * least the filter uses, it learns larger ones for drifting axes */
+    std::array<int32_t, axis_slot_count> m_axis_deadzones;
+
+    /* Decides which axis changes are reported. Devices give it their axes
+     * in whatever order they read them, and configure it again from the
+     * deadzones and the binding when m_axes_configured is cleared */
+    axis_filter m_axis_filter;
+    bool m_axes_configured = false;
 
     /* Misc */
 
@@ -123,28 +215,49 @@ protected:
     /* Device index assigned when querying the devices */
     int m_index = 0;
 
-    void button_event(uint16_t native_id, uint16_t vc, int32_t value, float vv);
-    void axis_event(uint16_t native_id, uint16_t vc, int32_t value, float vv);
+    /* Where events are appended if batched delivery is in use. Set by
+     * the hook thread */
+    event_batch* m_batch = nullptr;
+
+    /* Events that only set up the initial state aren't reported */
+    void button_event(uint16_t native_id, uint16_t vc, int32_t value, float vv, bool report = true);
+    void axis_event(uint16_t native_id, uint16_t vc, int32_t value, float vv, bool report = true);
 
     inline float clamp(float x, float lower, float upper) { return fminf(upper, fmaxf(x, lower)); }
 
 public:
     device()
     {
-        m_axis_deadzones[axis::RIGHT_TRIGGER] = 100;
-        m_axis_deadzones[axis::LEFT_TRIGGER] = 100;
-        m_axis_deadzones[axis::LEFT_STICK_X] = 100;
-        m_axis_deadzones[axis::LEFT_STICK_Y] = 100;
-        m_axis_deadzones[axis::RIGHT_STICK_X] = 100;
-        m_axis_deadzones[axis::RIGHT_STICK_Y] = 100;
+        m_axis_deadzones.fill(-1);
+        for (int i = 0; i < axis::COUNT; i++)
+            m_axis_deadzones[i] = 100;
     }
 
     ~device() { }
 
     void set_index(int i) { m_index = i; }
+    void set_batch(event_batch* batch) { m_batch = batch; }
     int get_index() const { return m_index; }
 
-    void set_axis_deadzone(uint16_t id, int32_t val) { m_axis_deadzones[id] = val; }
+    void set_axis_deadzone(uint16_t id, int32_t val)
+    {
+        int slot = axis_slot(id);
+        if (slot >= 0)
+            m_axis_deadzones[slot] = val;
+        m_axes_configured = false;
+    }
+
+    int32_t get_axis_deadzone(uint16_t id) const
+    {
+        int slot = axis_slot(id);
+        return slot >= 0 ? m_axis_deadzones[slot] : -1;
+    }
+
+    /* What the filter has learned, by the device's own axis order. The
+     * hook keeps it by device id */
+    void get_axis_calibration(axis_calibration& c) const { m_axis_filter.get_calibration(c); }
+    void set_axis_calibration(const axis_calibration& c) { m_axis_filter.set_calibration(c); }
+    const axis_filter& get_axis_filter() const { return m_axis_filter; }
 
     void set_name(const std::string& name) { m_name = name; }
     const std::string& get_name() const { return m_name; }
@@ -165,17 +278,27 @@ public:
      */
     virtual const std::string& get_cache_id() { return get_id(); }
 
-    bool is_button_pressed(uint16_t code) { return m_buttons[code]; }
-
-    float get_axis(uint16_t axis) { return m_axis[axis]; }
-
-    const std::map<uint16_t, bool>& get_buttons() const { return m_buttons; }
+    bool is_button_pressed(uint16_t code) const
+    {
+        int slot = button_slot(code);
+        return slot >= 0 && m_buttons[slot];
+    }
 
-    std::map<uint16_t, bool>& get_buttons() { return m_buttons; }
+    float get_axis(uint16_t axis) const
+    {
+        int slot = axis_slot(axis);
+        return slot >= 0 ? m_axis[slot] : 0.f;
+    }
 
-    const std::map<uint16_t, float>& get_axis() const { return m_axis; }
+    /* Direct access to the state arrays, indexed by slot */
+    const std::bitset<button_slot_count>& get_button_states() const { return m_buttons; }
+    const std::array<float, axis_slot_count>& get_axis_states() const { return m_axis; }
 
-    std::map<uint16_t, float>& get_axis() { return m_axis; }
+    /* Compatibility views. These build a map of every id that has
+     * received an event, so they allocate and are not meant for
+     * use in the input path */
+    std::map<uint16_t, bool> get_buttons() const;
+    std::map<uint16_t, float> get_axis() const;
 
     bool is_valid() const { return m_valid; }
 
@@ -196,6 +319,7 @@ public:
     {
         m_binding.reset();
         m_binding = b;
+        m_axes_configured = false;
     }
 
     virtual void deinit()
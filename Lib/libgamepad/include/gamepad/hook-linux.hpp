@@ -0,0 +1,77 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+
+#include "hook.hpp"
+
+#ifdef LGP_LINUX
+/* Maximum number of ready descriptors handled per wakeup. More ready
+ * devices than this are simply picked up on the next epoll_wait */
+#define LGP_LINUX_MAX_EVENTS 64
+
+namespace gamepad {
+class device_linux;
+
+extern void linux_hook_thread(class hook_linux* h);
+
+/* Instead of sleep-polling every device like the default hook thread, all
+ * device descriptors share one epoll set. The hook thread blocks until a
+ * device has input (or is unplugged) and only reads the ready devices, so
+ * an idle hook uses no CPU and the cost of a wakeup doesn't depend on how
+ * many gamepads are connected. Events are delivered as soon as the kernel
+ * queues them, so the sleep time set with set_sleep_time() is not used.
+ * With hotplug enabled an inotify watch on the device directory is part
+ * of the same epoll set, so devices are added and removed as their nodes
+ * come and go. Otherwise, with plug and play enabled, the devices are
+ * rescanned every refresh interval */
+class hook_linux : public hook {
+    friend void linux_hook_thread(class hook_linux* h);
+
+    bool m_use_by_id = false;
+    std::string m_dir; /* Where device nodes are looked for */
+    int m_epoll_fd = -1;
+    int m_wake_fd = -1; /* eventfd used to wake the hook thread on stop() */
+    int m_inotify_fd = -1; /* Watches m_dir if hotplug is enabled */
+
+    bool is_device_node(const std::string& name) const;
+    bool watch_device(const std::shared_ptr<device_linux>& dev);
+    void unwatch_device(const std::shared_ptr<device>& dev);
+    void add_device(const std::string& path);
+    bool start_hotplug();
+    bool handle_hotplug();
+
+public:
+    hook_linux(uint16_t flags);
+    ~hook_linux() override { hook_linux::stop(); }
+
+    void remove_invalid_devices() override;
+    void query_devices() override;
+    bool start() override;
+    void stop() override;
+
+    std::shared_ptr<cfg::binding> make_empty_binding() override;
+    std::shared_ptr<cfg::binding> make_default_binding() override;
+
+#ifdef LGP_ENABLE_JSON
+    virtual std::shared_ptr<cfg::binding> make_native_binding(const json11::Json& j) override;
+    virtual const json11::Json& get_default_binding() override;
+#endif
+};
+}
+#endif
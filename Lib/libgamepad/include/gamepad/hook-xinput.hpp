@@ -49,6 +49,9 @@ public:
     void query_devices() override;
     bool start() override;
 
+    std::shared_ptr<cfg::binding> make_empty_binding() override;
+    std::shared_ptr<cfg::binding> make_default_binding() override;
+
 #ifdef LGP_ENABLE_JSON
     virtual std::shared_ptr<cfg::binding> make_native_binding(const json11::Json& j) override;
     virtual const json11::Json& get_default_binding() override;
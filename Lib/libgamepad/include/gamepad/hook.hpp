@@ -17,10 +17,12 @@
  **/
 
 #pragma once
+#include "binding-cache.hpp"
 #include "binding.hpp"
 #include "config.h"
 #include "device.hpp"
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -33,6 +35,7 @@ using bindings_list = std::vector<std::shared_ptr<gamepad::cfg::binding>>;
 using binding_map = std::map<std::string, std::string>;
 using event_callback = std::function<void(std::shared_ptr<device>)>;
 using ms = std::chrono::milliseconds;
+using deadline_callback = std::function<ms()>;
 using ns = std::chrono::nanoseconds;
 using mcs = std::chrono::microseconds;
 
@@ -72,19 +75,56 @@ protected:
     event_callback m_disconnect_handler;
     event_callback m_reconnect_handler;
 
+    /* Batched delivery, see set_batch_event_handler */
+    event_batch m_batch;
+
     /* Map of previously connected devices, to ensure that no new instance
      * is created on reconnection */
     std::map<std::string, std::shared_ptr<device>> m_device_cache;
 
     binding_map m_binding_map; /* Map device id to binding name */
 
+    /* Bindings loaded through a cache stay in it until they are used.
+     * Lookups by name or device id that miss m_bindings and m_binding_map
+     * fall back to it and move what they find over */
+    cfg::binding_cache m_binding_cache;
+    std::shared_ptr<cfg::binding> load_cached_binding(int index);
+
+    /* Moves everything left in the cache over and closes it, for anything
+     * that needs all the bindings at hand */
+    void load_cached_bindings();
+
+    /* What the axis filters learned, by device id, see load_calibration.
+     * Devices are given theirs when they connect and it is taken back when
+     * they disconnect. The file is only written if something changed */
+    std::map<std::string, axis_calibration> m_calibrations;
+    std::string m_calibration_path;
+    bool m_calibration_changed = false;
+    void apply_calibration(const std::shared_ptr<device>& dev);
+    void store_calibration(const device& dev);
+    bool write_calibration();
+
     std::thread m_hook_thread;
     std::mutex m_mutex;
     std::atomic<bool> m_running;
     bool m_plug_and_play = false;
+    bool m_hotplug = false;
     ns m_plug_and_play_interval = ms(1000);
     ns m_thread_sleep = ms(50);
 
+    /* Adaptive polling, see set_adaptive_polling */
+    bool m_adaptive = false;
+    ns m_adaptive_max_sleep = ms(2000);
+    deadline_callback m_deadline_callback;
+
+    /* Lets stop() wake the polling thread out of a long sleep */
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep_cv;
+
+    /* How long the polling thread sleeps after a poll, given how long
+     * the pads have been idle. Called with the hook mutex held */
+    ns adaptive_sleep(ns idle_time);
+
     /* Can be used for platform specific bind options
      * Only used for DirectInput currently, which needs a sepcial hack
      * for separating the left and right trigger
@@ -126,6 +166,16 @@ public:
         m_plug_and_play_interval = refresh_rate >= m_thread_sleep ? refresh_rate : m_thread_sleep;
     }
 
+    /**
+     * @brief Enable or disable hotplug notifications. Instead of rescanning
+     * every refresh interval the hook is told when a device node appears or
+     * disappears and only probes that device. Only the Linux hook supports
+     * this. Elsewhere, or if notifications can't be set up, plug and play
+     * rescans are used if enabled
+     * @param state Enable or disable hotplug notifications
+     */
+    void set_hotplug(bool state) { m_hotplug = state; }
+
     /**
      * @brief Save bindings to a file
      * @param path The target path
@@ -149,6 +199,33 @@ public:
      */
     bool load_bindings(const std::string& path);
 
+    /**
+     * @brief load bindings from file through a binary cache. If the cache
+     * was made from the file as it is now, the file isn't read and the
+     * bindings are used straight from the cache. Otherwise the file is
+     * loaded and the cache is written again
+     * @param path The json bindings
+     * @param cache_path Where the cache is kept
+     * @return true on sucess
+     */
+    bool load_bindings(const std::string& path, const std::string& cache_path);
+
+    /**
+     * @brief Keeps what the axis filters learn about each device, such as
+     * the deadzone a drifting stick needs, in a file. It is read now and
+     * applied to devices as they connect, and written when a device
+     * disconnects and when the hook stops. A missing file isn't an error
+     * @param path The json calibration
+     * @return false if the file can't be parsed
+     */
+    bool load_calibration(const std::string& path);
+
+    /**
+     * @brief Writes the calibration of every device now, if it changed
+     * @return false if there is no calibration file or it can't be written
+     */
+    bool save_calibration();
+
     /**
      * @brief Event handler function called when buttons are pressed on any device
      * @param handler Function pointer to the handler
@@ -161,6 +238,16 @@ public:
      */
     void set_axis_event_handler(event_callback handler);
 
+    /**
+     * @brief Handler called once per poll cycle with the button and axis
+     * events of all devices. Unlike the per-event handlers it doesn't copy
+     * a shared_ptr per event, and several changes in one cycle don't hide
+     * each other behind last_button_event(). Can be used alongside them
+     * @param handler Function pointer to the handler, or nullptr
+     * @param user Passed to the handler as is
+     */
+    void set_batch_event_handler(batch_callback handler, void* user = nullptr);
+
     /**
      * @brief Event handler function called when a device is connected
      * @param handler Function pointer to the handler
@@ -190,6 +277,30 @@ public:
         m_mutex.unlock();
     }
 
+    /**
+     * @brief Poll rarely while nothing is happening. For applications that
+     * only need to know whether there was input before some deadline.
+     * While pads are idle the polling thread sleeps until shortly before
+     * the deadline, up to max_sleep at a time, so it polls less often the
+     * further away the deadline is. Any input switches back to the normal
+     * sleep time until the pads have been idle for max_sleep again. Input
+     * that comes and goes between two polls is still reported because
+     * devices compare hardware packet counters, not just state. Only used
+     * by polling hooks. The Linux hook already sleeps until input arrives.
+     * @param state Enable or disable adaptive polling
+     * @param max_sleep The longest the thread sleeps between polls
+     * @param time_to_deadline Returns the time left until the deadline
+     */
+    template <class Rep, class Period>
+    void set_adaptive_polling(bool state, std::chrono::duration<Rep, Period> max_sleep, deadline_callback time_to_deadline)
+    {
+        m_mutex.lock();
+        m_adaptive = state;
+        m_adaptive_max_sleep = max_sleep;
+        m_deadline_callback = time_to_deadline;
+        m_mutex.unlock();
+    }
+
     virtual void remove_invalid_devices();
     virtual void close_devices();
     virtual void close_bindings();
@@ -205,6 +316,12 @@ public:
 
     virtual std::shared_ptr<cfg::binding> make_native_binding(const std::string& json = "");
 
+    /* A native binding with no name and no mappings */
+    virtual std::shared_ptr<cfg::binding> make_empty_binding() = 0;
+
+    /* The built-in binding of this platform, for devices without one */
+    virtual std::shared_ptr<cfg::binding> make_default_binding() = 0;
+
     std::shared_ptr<cfg::binding> get_binding_for_device(const std::string& id);
     std::shared_ptr<device> get_device_by_id(const std::string& id);
     std::shared_ptr<cfg::binding> get_binding_by_name(const std::string& name);
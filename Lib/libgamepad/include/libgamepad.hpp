@@ -20,7 +20,7 @@
 
 // Begin Bluescan Divergence
 //#include "gamepad/binding-dinput.hpp"
-//#include "gamepad/binding-linux.hpp"
+#include "gamepad/binding-linux.hpp"
 // End Bluescan Divergence
 #include "gamepad/binding-xinput.hpp"
 #include "gamepad/binding.hpp"
@@ -28,7 +28,7 @@
 #include "gamepad/device.hpp"
 // Begin Bluescan Divergence
 //#include "gamepad/hook-dinput.hpp"
-//#include "gamepad/hook-linux.hpp"
+#include "gamepad/hook-linux.hpp"
 // End Bluescan Divergence
 #include "gamepad/hook-xinput.hpp"
 #include "gamepad/hook.hpp"
@@ -0,0 +1,262 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <gamepad/axis-filter.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LGP_AXIS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LGP_AXIS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace gamepad {
+namespace {
+    /* Eight lanes of 16 bit integers. Comparisons give all ones for true.
+     * Subtraction and addition saturate, so the distance between any two
+     * values fits. Loads and stores don't assume alignment, devices are
+     * allocated by make_shared */
+#if defined(LGP_AXIS_SSE2)
+    using vec = __m128i;
+    inline vec load(const int16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline void store(int16_t* p, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    inline vec splat(int16_t x) { return _mm_set1_epi16(x); }
+    inline vec adds(vec a, vec b) { return _mm_adds_epi16(a, b); }
+    inline vec subs(vec a, vec b) { return _mm_subs_epi16(a, b); }
+    inline vec max(vec a, vec b) { return _mm_max_epi16(a, b); }
+    inline vec min(vec a, vec b) { return _mm_min_epi16(a, b); }
+    inline vec gt(vec a, vec b) { return _mm_cmpgt_epi16(a, b); }
+    inline vec ne(vec a, vec b) { return _mm_xor_si128(_mm_cmpeq_epi16(a, b), _mm_set1_epi16(-1)); }
+    inline vec and_(vec a, vec b) { return _mm_and_si128(a, b); }
+    inline vec or_(vec a, vec b) { return _mm_or_si128(a, b); }
+    inline vec and_not(vec a, vec b) { return _mm_andnot_si128(b, a); } /* a & ~b */
+    inline vec select(vec m, vec a, vec b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+    template <int n>
+    inline vec sra(vec a) { return _mm_srai_epi16(a, n); }
+    inline uint32_t bits(vec m) { return uint32_t(_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128()))); }
+#elif defined(LGP_AXIS_NEON)
+    using vec = int16x8_t;
+    inline vec load(const int16_t* p) { return vld1q_s16(p); }
+    inline void store(int16_t* p, vec v) { vst1q_s16(p, v); }
+    inline vec splat(int16_t x) { return vdupq_n_s16(x); }
+    inline vec adds(vec a, vec b) { return vqaddq_s16(a, b); }
+    inline vec subs(vec a, vec b) { return vqsubq_s16(a, b); }
+    inline vec max(vec a, vec b) { return vmaxq_s16(a, b); }
+    inline vec min(vec a, vec b) { return vminq_s16(a, b); }
+    inline vec gt(vec a, vec b) { return vreinterpretq_s16_u16(vcgtq_s16(a, b)); }
+    inline vec ne(vec a, vec b) { return vreinterpretq_s16_u16(vmvnq_u16(vceqq_s16(a, b))); }
+    inline vec and_(vec a, vec b) { return vandq_s16(a, b); }
+    inline vec or_(vec a, vec b) { return vorrq_s16(a, b); }
+    inline vec and_not(vec a, vec b) { return vbicq_s16(a, b); }
+    inline vec select(vec m, vec a, vec b) { return vbslq_s16(vreinterpretq_u16_s16(m), a, b); }
+    template <int n>
+    inline vec sra(vec a) { return vshrq_n_s16(a, n); }
+    inline uint32_t bits(vec m)
+    {
+        static const uint16_t weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+        return vaddvq_u16(vandq_u16(vreinterpretq_u16_s16(m), vld1q_u16(weights)));
+    }
+#else
+    struct vec {
+        int16_t l[8];
+    };
+    template <class F>
+    inline vec each(vec a, vec b, F f)
+    {
+        vec r;
+        for (int i = 0; i < 8; i++)
+            r.l[i] = int16_t(f(int32_t(a.l[i]), int32_t(b.l[i])));
+        return r;
+    }
+    inline int32_t saturate(int32_t x) { return x > 32767 ? 32767 : (x < -32768 ? -32768 : x); }
+    inline vec load(const int16_t* p)
+    {
+        vec r;
+        for (int i = 0; i < 8; i++)
+            r.l[i] = p[i];
+        return r;
+    }
+    inline void store(int16_t* p, vec v)
+    {
+        for (int i = 0; i < 8; i++)
+            p[i] = v.l[i];
+    }
+    inline vec splat(int16_t x) { return vec { { x, x, x, x, x, x, x, x } }; }
+    inline vec adds(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return saturate(x + y); }); }
+    inline vec subs(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return saturate(x - y); }); }
+    inline vec max(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x > y ? x : y; }); }
+    inline vec min(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x < y ? x : y; }); }
+    inline vec gt(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x > y ? -1 : 0; }); }
+    inline vec ne(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x != y ? -1 : 0; }); }
+    inline vec and_(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x & y; }); }
+    inline vec or_(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x | y; }); }
+    inline vec and_not(vec a, vec b) { return each(a, b, [](int32_t x, int32_t y) { return x & ~y; }); }
+    inline vec select(vec m, vec a, vec b) { return or_(and_(m, a), and_not(b, m)); }
+    template <int n>
+    inline vec sra(vec a) { return each(a, a, [](int32_t x, int32_t) { return x >> n; }); }
+    inline uint32_t bits(vec m)
+    {
+        uint32_t r = 0;
+        for (int i = 0; i < 8; i++)
+            r |= uint32_t(m.l[i] & 1) << i;
+        return r;
+    }
+#endif
+
+    inline vec absdiff(vec a, vec b) { return max(subs(a, b), subs(b, a)); }
+}
+
+axis_filter::axis_filter()
+{
+    m_floor.fill(-1);
+}
+
+void axis_filter::configure(int lane, int32_t deadzone)
+{
+    if (lane < 0 || lane >= max_lanes)
+        return;
+    deadzone = deadzone < 32767 ? deadzone : 32767;
+    m_floor[lane] = int16_t(deadzone < 0 ? -1 : deadzone);
+    m_step[lane] = int16_t(deadzone < 0 ? 0 : deadzone);
+    m_learn[lane] = int16_t(deadzone < 0 ? 0 : -1);
+}
+
+void axis_filter::seed(int lane, int16_t value)
+{
+    if (lane < 0 || lane >= max_lanes)
+        return;
+    m_last[lane] = value;
+    m_reported[lane] = value;
+    m_moving[lane] = 0;
+    m_quiet[lane] = 0;
+
+    /* A calibrated rest position further out than any deadzone is wrong,
+     * and one the axis is never at rest around could never be corrected */
+    int32_t offset = int32_t(value) - m_center[lane];
+    offset = offset < 0 ? -offset : offset;
+    if (!m_seeded[lane] || offset > max_deadzone) {
+        m_center[lane] = value;
+        m_seeded[lane] = -1;
+    }
+}
+
+uint64_t axis_filter::filter(const int16_t* values, int count)
+{
+    const vec noise_limit = splat(max_noise);
+    const vec center_rate = splat(max_center_step);
+    const vec noise_rate = splat(max_noise_step);
+    const vec settled = splat(settle_samples);
+    uint64_t report_bits = 0;
+    count = count < max_lanes ? count : max_lanes;
+    for (int i = 0; i < count; i += 8) {
+        vec value = load(values + i);
+        vec seeded = load(&m_seeded[i]);
+        vec center = select(seeded, load(&m_center[i]), value);
+        vec noise = load(&m_noise[i]);
+        vec configured = load(&m_floor[i]);
+        vec moving = load(&m_moving[i]);
+        vec reported = load(&m_reported[i]);
+        vec changed = ne(value, load(&m_last[i]));
+
+        /* Hysteresis around the rest position */
+        vec distance = absdiff(value, center);
+        vec enter = max(configured, adds(adds(noise, noise), noise));
+        vec exit = sra<1>(enter);
+        vec now_moving = or_(gt(distance, enter), and_(moving, gt(distance, exit)));
+
+        /* Coming to rest is reported too, so the state ends up where the
+         * axis is */
+        vec step = gt(absdiff(value, reported), load(&m_step[i]));
+        vec report = and_(step, or_(moving, now_moving));
+        store(&m_reported[i], select(report, value, reported));
+
+        /* Changes since the last report. A moving axis that has had
+         * settle_samples of them without one has stopped somewhere */
+        vec quiet = and_not(adds(load(&m_quiet[i]), and_(changed, splat(1))), report);
+        store(&m_quiet[i], quiet);
+
+        /* Only new values are learned from, so a poll of an unchanged axis
+         * doesn't count as another sample. The noise floor is only learned
+         * at rest. The rest position is also learned once a moving axis
+         * has stopped, which is how a stick that comes back somewhere new
+         * gets back to rest. A slow push starts out looking like drift, so
+         * each sample may only move the rest position and grow the noise
+         * floor by a few units, rounded to nearest. A noise floor that is
+         * too high falls back at the full rate */
+        vec learn = and_(and_(load(&m_learn[i]), changed), seeded);
+        vec learn_center = and_not(learn, and_not(moving, gt(quiet, settled)));
+        vec learn_noise = and_not(learn, moving);
+        vec center_step = sra<4>(adds(subs(value, center), splat(8)));
+        center_step = max(min(center_step, center_rate), subs(splat(0), center_rate));
+        vec noise_step = min(sra<5>(adds(subs(distance, noise), splat(16))), noise_rate);
+        store(&m_center[i], adds(center, and_(center_step, learn_center)));
+        store(&m_noise[i], min(adds(noise, and_(noise_step, learn_noise)), noise_limit));
+
+        store(&m_last[i], value);
+        store(&m_seeded[i], splat(-1));
+        store(&m_moving[i], now_moving);
+        report_bits |= uint64_t(bits(report)) << i;
+    }
+    return report_bits;
+}
+
+int32_t axis_filter::get_deadzone(int lane) const
+{
+    if (lane < 0 || lane >= max_lanes || m_floor[lane] < 0)
+        return -1;
+    int32_t learned = m_noise[lane] * 3;
+    return m_floor[lane] > learned ? m_floor[lane] : learned;
+}
+
+bool axis_filter::has_drift(int count) const
+{
+    count = count < max_lanes ? count : max_lanes;
+    for (int lane = 0; lane < count; lane++) {
+        if (m_learn[lane] && get_deadzone(lane) > m_floor[lane])
+            return true;
+    }
+    return false;
+}
+
+void axis_filter::get_calibration(axis_calibration& c) const
+{
+    c.lanes = 0;
+    for (int lane = 0; lane < max_lanes; lane++) {
+        if (!m_learn[lane] || !m_seeded[lane])
+            continue;
+        c.lanes |= uint64_t(1) << lane;
+        c.center[lane] = m_center[lane];
+        c.deadzone[lane] = int16_t(m_noise[lane] * 3);
+    }
+}
+
+void axis_filter::set_calibration(const axis_calibration& c)
+{
+    for (int lane = 0; lane < max_lanes; lane++) {
+        if (!(c.lanes & (uint64_t(1) << lane)))
+            continue;
+        /* A cache written by an older version may hold more than is
+         * learned now */
+        int32_t deadzone = c.deadzone[lane] < max_deadzone ? c.deadzone[lane] : max_deadzone;
+        m_center[lane] = c.center[lane];
+        m_noise[lane] = int16_t(deadzone > 0 ? deadzone / 3 : 0);
+        m_seeded[lane] = -1;
+    }
+}
+}
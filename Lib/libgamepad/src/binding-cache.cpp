@@ -0,0 +1,317 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <gamepad/binding-cache.hpp>
+#include <gamepad/config.h>
+#include <gamepad/log.hpp>
+#ifdef LGP_WINDOWS
+#define VC_EXTRALEAN
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gamepad {
+namespace cfg {
+    bool binding_cache::stat_source(const std::string& path, uint64_t& size, int64_t& time)
+    {
+#ifdef LGP_WINDOWS
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+            return false;
+        size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+        time = int64_t((uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        size = uint64_t(st.st_size);
+#ifdef LGP_MACOS
+        time = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        time = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+        return true;
+    }
+
+    bool binding_cache::write(const std::string& path, const std::string& source_path,
+        const std::vector<std::shared_ptr<binding>>& bindings, const std::map<std::string, std::string>& map)
+    {
+        cache::header header {};
+        memcpy(header.magic, "LGPB", 4);
+        header.version = cache::version;
+        header.byte_order = cache::byte_order_mark;
+        if (!stat_source(source_path, header.source_size, header.source_time))
+            return false;
+
+        /* Names must be unique for the lookups. add_binding keeps them that way */
+        std::vector<const binding*> sorted;
+        for (const auto& b : bindings) {
+            if (b)
+                sorted.emplace_back(b.get());
+        }
+        std::sort(sorted.begin(), sorted.end(),
+            [](const binding* a, const binding* b) { return a->get_name() < b->get_name(); });
+
+        std::vector<cache::binding> records;
+        std::vector<cache::device> devices;
+        std::vector<cache::entry> entries;
+        std::string strings;
+        auto add_string = [&strings](const std::string& s) {
+            auto offset = uint32_t(strings.size());
+            strings.append(s.c_str(), s.size() + 1);
+            return offset;
+        };
+
+        for (const auto* b : sorted) {
+            cache::binding record {};
+            record.name = add_string(b->get_name());
+            record.first_entry = uint32_t(entries.size());
+            record.button_count = uint16_t(b->get_button_mappings().size());
+            record.axis_count = uint16_t(b->get_axis_mappings().size());
+            for (const auto& m : b->get_button_mappings())
+                entries.push_back({ m.first, m.second });
+            for (const auto& m : b->get_axis_mappings())
+                entries.push_back({ m.first, m.second });
+            records.emplace_back(record);
+        }
+
+        /* The map is ordered by id already. Devices mapped to a binding
+         * that doesn't exist are left out */
+        for (const auto& mapping : map) {
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), mapping.second,
+                [](const binding* b, const std::string& name) { return b->get_name() < name; });
+            if (it == sorted.end() || (*it)->get_name() != mapping.second)
+                continue;
+            devices.push_back({ add_string(mapping.first), uint32_t(it - sorted.begin()) });
+        }
+
+        if (strings.empty())
+            strings.push_back('\0');
+
+        header.binding_count = uint32_t(records.size());
+        header.device_count = uint32_t(devices.size());
+        header.entry_count = uint32_t(entries.size());
+        header.string_size = uint32_t(strings.size());
+        header.file_size = uint32_t(sizeof(header) + records.size() * sizeof(cache::binding)
+            + devices.size() * sizeof(cache::device) + entries.size() * sizeof(cache::entry) + strings.size());
+
+        /* The cache is never rewritten in place. Another process may have it
+         * mapped, and truncating a mapped file faults its readers on Linux
+         * and fails outright on Windows. It is written next to the cache under
+         * a name of its own and renamed over it, so a reader sees either the
+         * old file or the new one, never a partial one */
+#ifdef LGP_WINDOWS
+        std::string temp_path = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+        std::string temp_path = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out.good()) {
+            gerr("Couldn't write binding cache to %s", temp_path.c_str());
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(cache::binding)));
+        out.write(reinterpret_cast<const char*>(devices.data()), std::streamsize(devices.size() * sizeof(cache::device)));
+        out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(cache::entry)));
+        out.write(strings.data(), std::streamsize(strings.size()));
+        out.close();
+
+        bool written = !out.fail();
+#ifdef LGP_WINDOWS
+        written = written && MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+        written = written && rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+        if (!written) {
+            gerr("Couldn't write binding cache to %s", path.c_str());
+            std::remove(temp_path.c_str());
+        }
+        return written;
+    }
+
+    bool binding_cache::open(const std::string& path, const std::string& source_path)
+    {
+        close();
+#ifdef LGP_WINDOWS
+        /* Sharing delete lets write() rename a new cache over this one while
+         * it is mapped */
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart >= LONGLONG(sizeof(cache::header)))
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping)
+            return false;
+
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            CloseHandle(mapping);
+            return false;
+        }
+        m_mapping = mapping;
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = size_t(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size >= off_t(sizeof(cache::header)))
+            data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return false;
+
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = size_t(st.st_size);
+#endif
+
+        uint64_t source_size = 0;
+        int64_t source_time = 0;
+        if (!validate() || !stat_source(source_path, source_size, source_time)
+            || m_header->source_size != source_size || m_header->source_time != source_time) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool binding_cache::validate()
+    {
+        /* Everything that is read later is bounds checked here, once */
+        const auto* h = reinterpret_cast<const cache::header*>(m_data);
+        if (memcmp(h->magic, "LGPB", 4) != 0 || h->version != cache::version
+            || h->byte_order != cache::byte_order_mark || h->file_size != m_size)
+            return false;
+
+        uint64_t bindings_at = sizeof(cache::header);
+        uint64_t devices_at = bindings_at + uint64_t(h->binding_count) * sizeof(cache::binding);
+        uint64_t entries_at = devices_at + uint64_t(h->device_count) * sizeof(cache::device);
+        uint64_t strings_at = entries_at + uint64_t(h->entry_count) * sizeof(cache::entry);
+        if (strings_at + h->string_size != m_size || h->string_size == 0 || m_data[m_size - 1] != '\0')
+            return false;
+
+        m_bindings = reinterpret_cast<const cache::binding*>(m_data + bindings_at);
+        m_devices = reinterpret_cast<const cache::device*>(m_data + devices_at);
+        m_entries = reinterpret_cast<const cache::entry*>(m_data + entries_at);
+        m_strings = reinterpret_cast<const char*>(m_data + strings_at);
+
+        for (uint32_t i = 0; i < h->binding_count; i++) {
+            const auto& b = m_bindings[i];
+            if (b.name >= h->string_size
+                || uint64_t(b.first_entry) + b.button_count + b.axis_count > h->entry_count)
+                return false;
+        }
+        for (uint32_t i = 0; i < h->device_count; i++) {
+            if (m_devices[i].id >= h->string_size || m_devices[i].binding >= h->binding_count)
+                return false;
+        }
+        m_header = h;
+        return true;
+    }
+
+    void binding_cache::close()
+    {
+        if (m_data) {
+#ifdef LGP_WINDOWS
+            UnmapViewOfFile(m_data);
+            CloseHandle(HANDLE(m_mapping));
+#else
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        }
+        m_data = nullptr;
+        m_size = 0;
+        m_mapping = nullptr;
+        m_header = nullptr;
+        m_bindings = nullptr;
+        m_devices = nullptr;
+        m_entries = nullptr;
+        m_strings = nullptr;
+    }
+
+    int binding_cache::find_binding(const char* name) const
+    {
+        if (!m_header)
+            return -1;
+
+        const auto* end = m_bindings + m_header->binding_count;
+        const auto* it = std::lower_bound(m_bindings, end, name,
+            [this](const cache::binding& b, const char* n) { return strcmp(string(b.name), n) < 0; });
+        return (it != end && strcmp(string(it->name), name) == 0) ? int(it - m_bindings) : -1;
+    }
+
+    int binding_cache::find_device_binding(const char* device_id) const
+    {
+        if (!m_header)
+            return -1;
+
+        const auto* end = m_devices + m_header->device_count;
+        const auto* it = std::lower_bound(m_devices, end, device_id,
+            [this](const cache::device& d, const char* id) { return strcmp(string(d.id), id) < 0; });
+        return (it != end && strcmp(string(it->id), device_id) == 0) ? int(it->binding) : -1;
+    }
+
+    const cache::entry* binding_cache::get_buttons(int index, size_t& count) const
+    {
+        count = m_bindings[index].button_count;
+        return m_entries + m_bindings[index].first_entry;
+    }
+
+    const cache::entry* binding_cache::get_axes(int index, size_t& count) const
+    {
+        count = m_bindings[index].axis_count;
+        return m_entries + m_bindings[index].first_entry + m_bindings[index].button_count;
+    }
+
+    void binding_cache::load(int index, binding& b) const
+    {
+        b.set_name(get_name(index));
+        b.get_button_mappings().clear();
+        b.get_axis_mappings().clear();
+
+        size_t count;
+        const auto* entries = get_buttons(index, count);
+        for (size_t i = 0; i < count; i++)
+            b.get_button_mappings()[entries[i].from] = entries[i].to;
+
+        entries = get_axes(index, count);
+        for (size_t i = 0; i < count; i++)
+            b.get_axis_mappings()[entries[i].from] = entries[i].to;
+        b.compile();
+    }
+}
+}
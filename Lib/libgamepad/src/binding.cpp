@@ -0,0 +1,153 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <gamepad/binding.hpp>
+#include <gamepad/log.hpp>
+
+namespace gamepad {
+namespace cfg {
+    std::string default_error;
+
+    binding::binding(const std::string& json)
+    {
+        binding::load(json);
+    }
+
+    binding::binding(const builtin_binding& builtin)
+        : m_binding_name(builtin.name)
+        , m_button_table(builtin.button_table)
+        , m_axis_table(builtin.axis_table)
+    {
+        for (size_t i = 0; i < builtin.button_count; i++)
+            m_buttons_mappings[builtin.buttons[i].from] = builtin.buttons[i].to;
+        for (size_t i = 0; i < builtin.axis_count; i++)
+            m_axis_mappings[builtin.axes[i].from] = builtin.axes[i].to;
+    }
+
+#ifdef LGP_ENABLE_JSON
+    binding::binding(const json11::Json& j)
+    {
+        binding::load(j);
+    }
+
+    bool binding::load(const json11::Json& j)
+    {
+        m_binding_name = j["name"].string_value();
+        m_buttons_mappings.clear();
+        m_axis_mappings.clear();
+
+        for (const auto& bind : j["binds"].array_items()) {
+            auto from = uint16_t(bind["from"].int_value());
+            auto to = uint16_t(bind["to"].int_value());
+            if (bind["is_axis"].bool_value())
+                m_axis_mappings[from] = to;
+            else
+                m_buttons_mappings[from] = to;
+        }
+        compile();
+        return !m_binding_name.empty();
+    }
+
+    void binding::save(json11::Json& j) const
+    {
+        json11::Json::array binds;
+        for (const auto& bind : m_buttons_mappings) {
+            binds.emplace_back(json11::Json::object {
+                { "from", bind.first },
+                { "to", bind.second },
+                { "is_axis", false } });
+        }
+
+        for (const auto& bind : m_axis_mappings) {
+            binds.emplace_back(json11::Json::object {
+                { "from", bind.first },
+                { "to", bind.second },
+                { "is_axis", true } });
+        }
+
+        j = json11::Json::object {
+            { "name", m_binding_name },
+            { "binds", binds }
+        };
+    }
+#endif
+
+    bool binding::load(const std::string& json)
+    {
+#ifdef LGP_ENABLE_JSON
+        std::string err;
+        auto j = json11::Json::parse(json, err);
+        if (!err.empty()) {
+            gerr("Couldn't parse binding json: %s", err.c_str());
+            return false;
+        }
+        return load(j);
+#else
+        LGP_UNUSED(json);
+        return false;
+#endif
+    }
+
+    void binding::save(std::string& json)
+    {
+#ifdef LGP_ENABLE_JSON
+        json11::Json j;
+        save(j);
+        json = j.dump();
+#else
+        LGP_UNUSED(json);
+#endif
+    }
+
+    void binding::copy(const std::shared_ptr<binding> other)
+    {
+        m_binding_name = other->m_binding_name;
+        m_buttons_mappings = other->m_buttons_mappings;
+        m_axis_mappings = other->m_axis_mappings;
+        m_button_table = other->m_button_table;
+        m_axis_table = other->m_axis_table;
+    }
+
+    void binding::compile()
+    {
+        /* More codes than slots can't be flat, which build finds out
+         * without reading any of them */
+        bind binds[code_table::max_slots];
+        auto build = [&binds](const mappings& m, code_table& table) {
+            size_t count = 0;
+            for (const auto& mapping : m) {
+                if (count < code_table::max_slots)
+                    binds[count] = { mapping.first, mapping.second };
+                count++;
+            }
+            return table.build(binds, count);
+        };
+
+        bool buttons_flat = build(m_buttons_mappings, m_button_table);
+        bool axes_flat = build(m_axis_mappings, m_axis_table);
+        if (!buttons_flat || !axes_flat)
+            gwarn("Binding '%s' can't be made flat. Its events are translated more slowly", m_binding_name.c_str());
+    }
+
+    uint16_t binding::map_slow(const mappings& m, uint16_t native)
+    {
+        auto it = m.find(native);
+        return it != m.end() ? it->second : native;
+    }
+}
+}
@@ -0,0 +1,75 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <gamepad/device.hpp>
+#include <gamepad/hook.hpp>
+
+namespace gamepad {
+
+void device::button_event(uint16_t native_id, uint16_t vc, int32_t value, float vv, bool report)
+{
+    m_last_button_event.native_id = native_id;
+    m_last_button_event.vc = vc;
+    m_last_button_event.value = value;
+    m_last_button_event.virtual_value = vv;
+    m_last_button_event.time = hook::ms_ticks();
+    int slot = button_slot(vc);
+    if (slot >= 0) {
+        m_buttons[slot] = value != 0;
+        m_buttons_seen[slot] = true;
+    }
+    if (report && m_batch)
+        m_batch->push(m_last_button_event, m_index, update_result::BUTTON);
+}
+
+void device::axis_event(uint16_t native_id, uint16_t vc, int32_t value, float vv, bool report)
+{
+    m_last_axis_event.native_id = native_id;
+    m_last_axis_event.vc = vc;
+    m_last_axis_event.value = value;
+    m_last_axis_event.virtual_value = vv;
+    m_last_axis_event.time = hook::ms_ticks();
+    int slot = axis_slot(vc);
+    if (slot >= 0) {
+        m_axis[slot] = vv;
+        m_axis_seen[slot] = true;
+    }
+    if (report && m_batch)
+        m_batch->push(m_last_axis_event, m_index, update_result::AXIS);
+}
+
+std::map<uint16_t, bool> device::get_buttons() const
+{
+    std::map<uint16_t, bool> buttons;
+    for (int slot = 0; slot < button_slot_count; slot++) {
+        if (m_buttons_seen[slot])
+            buttons[button_code(slot)] = m_buttons[slot];
+    }
+    return buttons;
+}
+
+std::map<uint16_t, float> device::get_axis() const
+{
+    std::map<uint16_t, float> axes;
+    for (int slot = 0; slot < axis_slot_count; slot++) {
+        if (m_axis_seen[slot])
+            axes[axis_code(slot)] = m_axis[slot];
+    }
+    return axes;
+}
+}
@@ -0,0 +1,642 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <gamepad/hook-xinput.hpp>
+#include <gamepad/hook.hpp>
+#include <gamepad/log.hpp>
+#include <sstream>
+#ifdef LGP_LINUX
+#include <gamepad/hook-linux.hpp>
+#endif
+
+namespace gamepad {
+
+std::vector<std::tuple<std::string, uint16_t>> hook::button_prompts = {
+    { "A", button::A },
+    { "B", button::B },
+    { "X", button::X },
+    { "Y", button::Y },
+    { "LB", button::LB },
+    { "RB", button::RB },
+    { "Back", button::BACK },
+    { "Start", button::START },
+    { "Guide (Big circle in the middle)", button::GUIDE },
+    { "left analog stick", button::L_THUMB },
+    { "right analog stick", button::R_THUMB },
+    { "dpad left", button::DPAD_LEFT },
+    { "dpad right", button::DPAD_RIGHT },
+    { "dpad up", button::DPAD_UP },
+    { "dpad down", button::DPAD_DOWN }
+};
+
+std::vector<std::tuple<std::string, uint16_t>> hook::axis_prompts = {
+    { "left analog stick horizontally", axis::LEFT_STICK_X },
+    { "left analog stick vertically", axis::LEFT_STICK_Y },
+    { "left trigger", axis::LEFT_TRIGGER },
+    { "right analog stick horizontally", axis::RIGHT_STICK_X },
+    { "right analog vertically", axis::RIGHT_STICK_Y },
+    { "right trigger", axis::RIGHT_TRIGGER }
+};
+
+ns hook::adaptive_sleep(ns idle_time)
+{
+    /* Poll fast while there is input and for a while after */
+    if (!m_adaptive || !m_deadline_callback || idle_time < m_adaptive_max_sleep)
+        return m_thread_sleep;
+
+    /* Otherwise wake up one fast poll ahead of the deadline, so input
+     * right up to it is still seen in time */
+    ns remaining = m_deadline_callback() - m_thread_sleep;
+    if (remaining < m_thread_sleep)
+        return m_thread_sleep;
+    return remaining < m_adaptive_max_sleep ? remaining : m_adaptive_max_sleep;
+}
+
+void default_hook_thread(hook* h)
+{
+    ns time_since_query = ns(0);
+    ns idle_time = ns(0);
+    ns sleep = ns(0);
+
+    while (h->running()) {
+        h->m_mutex.lock();
+
+        /* Check for new devices */
+        if (h->m_plug_and_play) {
+            time_since_query += sleep;
+            if (time_since_query >= h->m_plug_and_play_interval) {
+                h->query_devices();
+                time_since_query = ns(0);
+            }
+        }
+
+        /* Update all devices */
+        event_batch* batch = h->m_batch.enabled() ? &h->m_batch : nullptr;
+        for (auto& dev : h->m_devices) {
+            if (!dev->is_valid())
+                continue;
+
+            dev->set_batch(batch);
+            auto result = dev->update();
+            if (result & update_result::AXIS && h->m_axis_handler)
+                h->m_axis_handler(dev);
+            if (result & update_result::BUTTON && h->m_button_handler)
+                h->m_button_handler(dev);
+
+            /* There is no event to report, only the fact that there
+             * was input. The button handler gets the last event again */
+            if (result == update_result::PACKET) {
+                if (batch)
+                    batch->push(*dev->last_button_event(), dev->get_index(), update_result::PACKET);
+                if (h->m_button_handler)
+                    h->m_button_handler(dev);
+                else if (h->m_axis_handler)
+                    h->m_axis_handler(dev);
+            }
+            if (result != update_result::NONE)
+                idle_time = ns(0);
+        }
+        if (batch)
+            batch->flush();
+        sleep = h->adaptive_sleep(idle_time);
+        idle_time += sleep;
+        h->m_mutex.unlock();
+
+        std::unique_lock<std::mutex> lock(h->m_sleep_mutex);
+        h->m_sleep_cv.wait_for(lock, sleep, [h] { return !h->running(); });
+    }
+}
+
+hook::hook()
+{
+    m_running = false;
+}
+
+#ifdef LGP_ENABLE_JSON
+void hook::on_bind(json11::Json::object& j, uint16_t native_code, uint16_t vc, int16_t val, bool is_axis)
+{
+    LGP_UNUSED(val);
+    j["from"] = native_code;
+    j["to"] = vc;
+    j["is_axis"] = is_axis;
+}
+#endif
+
+bool hook::save_bindings(const std::string& path)
+{
+#ifdef LGP_ENABLE_JSON
+    json11::Json j;
+    if (!save_bindings(j))
+        return false;
+
+    std::ofstream out(path);
+    if (!out.good()) {
+        gerr("Couldn't write bindings to %s", path.c_str());
+        return false;
+    }
+    out << j.dump();
+    return out.good();
+#else
+    LGP_UNUSED(path);
+    return false;
+#endif
+}
+
+#ifdef LGP_ENABLE_JSON
+bool hook::save_bindings(json11::Json& j)
+{
+    load_cached_bindings();
+    json11::Json::array bindings, bindings_map;
+    for (const auto& binding : m_bindings) {
+        json11::Json b;
+        binding->save(b);
+        bindings.emplace_back(b);
+    }
+
+    for (const auto& mapping : m_binding_map) {
+        bindings_map.emplace_back(json11::Json::object {
+            { "device_id", mapping.first },
+            { "binding_id", mapping.second } });
+    }
+
+    j = json11::Json::object {
+        { "bindings", bindings },
+        { "bindings_map", bindings_map }
+    };
+    return true;
+}
+#endif
+
+bool hook::load_bindings(const std::string& path)
+{
+#ifdef LGP_ENABLE_JSON
+    std::ifstream in(path);
+    if (!in.good()) {
+        gerr("Couldn't read bindings from %s", path.c_str());
+        return false;
+    }
+
+    std::stringstream buf;
+    buf << in.rdbuf();
+
+    std::string err;
+    auto j = json11::Json::parse(buf.str(), err);
+    if (!err.empty()) {
+        gerr("Couldn't parse bindings in %s: %s", path.c_str(), err.c_str());
+        return false;
+    }
+    return load_bindings(j);
+#else
+    LGP_UNUSED(path);
+    return false;
+#endif
+}
+
+bool hook::load_bindings(const std::string& path, const std::string& cache_path)
+{
+    /* Bindings already loaded are kept, as they are when loading json */
+    load_cached_bindings();
+    if (m_binding_cache.open(cache_path, path)) {
+        for (auto& dev : m_devices) {
+            auto b = get_binding_for_device(dev->get_id());
+            if (b)
+                dev->set_binding(b);
+        }
+        return true;
+    }
+
+    if (!load_bindings(path))
+        return false;
+    if (!cfg::binding_cache::write(cache_path, path, m_bindings, m_binding_map))
+        gwarn("Couldn't cache bindings from %s in %s", path.c_str(), cache_path.c_str());
+    return true;
+}
+
+std::shared_ptr<cfg::binding> hook::load_cached_binding(int index)
+{
+    auto b = make_empty_binding();
+    m_binding_cache.load(index, *b);
+    m_bindings.emplace_back(b);
+    return b;
+}
+
+void hook::load_cached_bindings()
+{
+    if (!m_binding_cache.is_open())
+        return;
+
+    /* Anything already moved over, or set since, wins. Looking a binding
+     * up by name moves it over if it hasn't been */
+    for (int i = 0; i < int(m_binding_cache.binding_count()); i++)
+        get_binding_by_name(m_binding_cache.get_name(i));
+    for (int d = 0; d < int(m_binding_cache.device_count()); d++) {
+        std::string id = m_binding_cache.get_device_id(d);
+        if (m_binding_map.find(id) == m_binding_map.end())
+            m_binding_map[id] = m_binding_cache.get_name(m_binding_cache.get_device_binding(d));
+    }
+    m_binding_cache.close();
+}
+
+#ifdef LGP_ENABLE_JSON
+bool hook::load_bindings(const json11::Json& j)
+{
+    load_cached_bindings();
+    for (const auto& b : j["bindings"].array_items())
+        add_binding(make_native_binding(b));
+
+    for (const auto& mapping : j["bindings_map"].array_items()) {
+        auto device_id = mapping["device_id"].string_value();
+        auto binding_id = mapping["binding_id"].string_value();
+        if (!device_id.empty() && !binding_id.empty())
+            m_binding_map[device_id] = binding_id;
+    }
+
+    /* Apply the loaded bindings to devices that are already connected */
+    for (auto& dev : m_devices) {
+        auto b = get_binding_for_device(dev->get_id());
+        if (b)
+            dev->set_binding(b);
+    }
+    return true;
+}
+#endif
+
+bool hook::load_calibration(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_calibration_path = path;
+#ifdef LGP_ENABLE_JSON
+    std::ifstream in(path);
+    if (!in.good())
+        return true;
+
+    std::stringstream buf;
+    buf << in.rdbuf();
+
+    std::string err;
+    auto j = json11::Json::parse(buf.str(), err);
+    if (!err.empty()) {
+        gerr("Couldn't parse calibration in %s: %s", path.c_str(), err.c_str());
+        return false;
+    }
+
+    for (const auto& entry : j["calibrations"].array_items()) {
+        auto id = entry["device_id"].string_value();
+        if (id.empty())
+            continue;
+
+        axis_calibration c;
+        for (const auto& axis : entry["axes"].array_items()) {
+            int lane = axis["axis"].int_value();
+            if (lane < 0 || lane >= axis_calibration::max_lanes)
+                continue;
+            c.lanes |= uint64_t(1) << lane;
+            c.center[lane] = int16_t(axis["center"].int_value());
+            c.deadzone[lane] = int16_t(axis["deadzone"].int_value());
+        }
+        m_calibrations[id] = c;
+    }
+
+    for (auto& dev : m_devices)
+        apply_calibration(dev);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool hook::save_calibration()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return write_calibration();
+}
+
+void hook::apply_calibration(const std::shared_ptr<device>& dev)
+{
+    auto it = m_calibrations.find(dev->get_id());
+    if (it != m_calibrations.end())
+        dev->set_axis_calibration(it->second);
+}
+
+void hook::store_calibration(const device& dev)
+{
+    axis_calibration c;
+    dev.get_axis_calibration(c);
+    if (!c.lanes)
+        return;
+
+    auto& stored = m_calibrations[dev.get_id()];
+    if (stored.lanes != c.lanes || stored.center != c.center || stored.deadzone != c.deadzone) {
+        stored = c;
+        m_calibration_changed = true;
+    }
+}
+
+bool hook::write_calibration()
+{
+    if (m_calibration_path.empty())
+        return false;
+    for (const auto& dev : m_devices)
+        store_calibration(*dev);
+    if (!m_calibration_changed)
+        return true;
+
+#ifdef LGP_ENABLE_JSON
+    json11::Json::array calibrations;
+    for (const auto& stored : m_calibrations) {
+        json11::Json::array axes;
+        for (int lane = 0; lane < axis_calibration::max_lanes; lane++) {
+            if (!(stored.second.lanes & (uint64_t(1) << lane)))
+                continue;
+            axes.emplace_back(json11::Json::object {
+                { "axis", lane },
+                { "center", stored.second.center[lane] },
+                { "deadzone", stored.second.deadzone[lane] } });
+        }
+        calibrations.emplace_back(json11::Json::object {
+            { "device_id", stored.first },
+            { "axes", axes } });
+    }
+
+    std::ofstream out(m_calibration_path);
+    if (!out.good()) {
+        gerr("Couldn't write calibration to %s", m_calibration_path.c_str());
+        return false;
+    }
+    out << json11::Json(json11::Json::object { { "calibrations", calibrations } }).dump();
+    if (!out.good())
+        return false;
+    m_calibration_changed = false;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void hook::set_button_event_handler(event_callback handler)
+{
+    m_mutex.lock();
+    m_button_handler = handler;
+    m_mutex.unlock();
+}
+
+void hook::set_axis_event_handler(event_callback handler)
+{
+    m_mutex.lock();
+    m_axis_handler = handler;
+    m_mutex.unlock();
+}
+
+void hook::set_batch_event_handler(batch_callback handler, void* user)
+{
+    m_mutex.lock();
+    m_batch.set_callback(handler, user);
+    m_mutex.unlock();
+}
+
+void hook::set_connect_event_handler(event_callback handler)
+{
+    m_mutex.lock();
+    m_connect_handler = handler;
+    m_mutex.unlock();
+}
+
+void hook::set_disconnect_event_handler(event_callback handler)
+{
+    m_mutex.lock();
+    m_disconnect_handler = handler;
+    m_mutex.unlock();
+}
+
+void hook::set_reconnect_event_handler(event_callback handler)
+{
+    m_mutex.lock();
+    m_reconnect_handler = handler;
+    m_mutex.unlock();
+}
+
+void hook::remove_invalid_devices()
+{
+    for (auto it = m_devices.begin(); it != m_devices.end();) {
+        if ((*it)->is_valid()) {
+            ++it;
+            continue;
+        }
+
+        /* The instance stays in the device cache so it can be reused on
+         * reconnection. What it learned is written out in case it isn't */
+        store_calibration(**it);
+        if (m_disconnect_handler)
+            m_disconnect_handler(*it);
+        it = m_devices.erase(it);
+    }
+    if (m_calibration_changed)
+        write_calibration();
+}
+
+void hook::close_devices()
+{
+    for (auto& dev : m_devices)
+        dev->deinit();
+    m_devices.clear();
+
+    for (auto& cached : m_device_cache) {
+        if (cached.second.use_count() > 1) {
+            gwarn("Gamepad device '%s' is still in use! (Ref count %li)", cached.first.c_str(),
+                long(cached.second.use_count()));
+        }
+    }
+    m_device_cache.clear();
+}
+
+void hook::close_bindings()
+{
+    m_binding_cache.close();
+    m_bindings.clear();
+}
+
+bool hook::start()
+{
+    if (m_running)
+        return true;
+
+    m_mutex.lock();
+    query_devices();
+    m_mutex.unlock();
+
+    m_running = true;
+    m_hook_thread = std::thread(default_hook_thread, this);
+    return true;
+}
+
+void hook::stop()
+{
+    m_sleep_mutex.lock();
+    m_running = false;
+    m_sleep_mutex.unlock();
+    m_sleep_cv.notify_all();
+    if (m_hook_thread.joinable())
+        m_hook_thread.join();
+
+    m_mutex.lock();
+    write_calibration();
+    close_devices();
+    close_bindings();
+    m_mutex.unlock();
+}
+
+#ifdef LGP_ENABLE_JSON
+void hook::make_xbox_config(const std::shared_ptr<gamepad::device>& dv, json11::Json& out)
+{
+    json11::Json::array binds;
+    auto wait_for_event = [&](const input_event* e) {
+        auto last = e->time;
+        while (e->time == last)
+            std::this_thread::sleep_for(m_thread_sleep);
+    };
+
+    for (const auto& prompt : button_prompts) {
+        printf("Press %s\n", std::get<0>(prompt).c_str());
+        wait_for_event(dv->last_button_event());
+
+        json11::Json::object bind;
+        m_mutex.lock();
+        auto* e = dv->last_button_event();
+        on_bind(bind, e->native_id, std::get<1>(prompt), int16_t(e->value), false);
+        m_mutex.unlock();
+        binds.emplace_back(bind);
+    }
+
+    for (const auto& prompt : axis_prompts) {
+        printf("Move %s\n", std::get<0>(prompt).c_str());
+        wait_for_event(dv->last_axis_event());
+
+        json11::Json::object bind;
+        m_mutex.lock();
+        auto* e = dv->last_axis_event();
+        on_bind(bind, e->native_id, std::get<1>(prompt), int16_t(e->value), true);
+        m_mutex.unlock();
+        binds.emplace_back(bind);
+    }
+
+    out = json11::Json::object {
+        { "name", dv->get_name() },
+        { "binds", binds }
+    };
+}
+#endif
+
+std::shared_ptr<cfg::binding> hook::make_native_binding(const std::string& json)
+{
+#ifdef LGP_ENABLE_JSON
+    if (json.empty())
+        return make_native_binding(get_default_binding());
+
+    std::string err;
+    auto j = json11::Json::parse(json, err);
+    if (!err.empty()) {
+        gerr("Couldn't parse binding json: %s", err.c_str());
+        return nullptr;
+    }
+    return make_native_binding(j);
+#else
+    LGP_UNUSED(json);
+    return nullptr;
+#endif
+}
+
+std::shared_ptr<cfg::binding> hook::get_binding_for_device(const std::string& id)
+{
+    auto it = m_binding_map.find(id);
+    if (it != m_binding_map.end())
+        return get_binding_by_name(it->second);
+
+    int index = m_binding_cache.find_device_binding(id.c_str());
+    if (index < 0)
+        return nullptr;
+    m_binding_map[id] = m_binding_cache.get_name(index);
+    return get_binding_by_name(m_binding_cache.get_name(index));
+}
+
+std::shared_ptr<device> hook::get_device_by_id(const std::string& id)
+{
+    for (auto& dev : m_devices) {
+        if (dev->get_id() == id)
+            return dev;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<cfg::binding> hook::get_binding_by_name(const std::string& name)
+{
+    for (auto& b : m_bindings) {
+        if (b->get_name() == name)
+            return b;
+    }
+
+    int index = m_binding_cache.find_binding(name.c_str());
+    return index < 0 ? nullptr : load_cached_binding(index);
+}
+
+bool hook::set_device_binding(const std::string& device_id, const std::string& binding_id)
+{
+    auto b = get_binding_by_name(binding_id);
+    if (!b) {
+        gwarn("No binding with name '%s'", binding_id.c_str());
+        return false;
+    }
+
+    auto dev = get_device_by_id(device_id);
+    if (!dev) {
+        gwarn("No device with id '%s'", device_id.c_str());
+        return false;
+    }
+
+    m_binding_map[device_id] = binding_id;
+    dev->set_binding(b);
+    if (dev->get_binding() != b) {
+        gerr("Couldn't set binding.");
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<hook> hook::make(uint16_t flags)
+{
+#ifdef LGP_WINDOWS
+    if (flags & hook_type::XINPUT)
+        return std::make_shared<hook_xinput>();
+    gerr("Only the XInput hook is available on Windows");
+    return nullptr;
+#elif LGP_LINUX
+    return std::make_shared<hook_linux>(flags);
+#else
+    LGP_UNUSED(flags);
+    return nullptr;
+#endif
+}
+
+uint64_t hook::ms_ticks()
+{
+    using namespace std::chrono;
+    return uint64_t(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+}
@@ -0,0 +1,216 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "device-linux.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <gamepad/log.hpp>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace gamepad {
+
+device_linux::device_linux(const std::string& path)
+    : m_dev_path(path)
+{
+}
+
+void device_linux::init()
+{
+    if (m_fd >= 0)
+        return;
+
+    m_fd = open(m_dev_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0) {
+        gdebug("Couldn't open %s: %s", m_dev_path.c_str(), strerror(errno));
+        invalidate();
+        return;
+    }
+
+    m_state = {};
+    m_decoded = {};
+    m_pressed = {};
+    m_has_pressed = false;
+    char name[128] = {};
+    if (ioctl(m_fd, JSIOCGNAME(sizeof(name) - 1), name) < 0)
+        strncpy(name, "Unknown gamepad", sizeof(name) - 1);
+
+    /* Only as many lanes as the device has axes are filtered, in blocks
+     * of eight */
+    uint8_t axes = 0;
+    if (ioctl(m_fd, JSIOCGAXES, &axes) < 0 || axes > ABS_CNT)
+        axes = ABS_CNT;
+    m_axis_lanes = (axes + 7) & ~7;
+    m_name = name;
+    if (m_id.empty())
+        m_id = m_name;
+    set_valid();
+}
+
+void device_linux::deinit()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    invalidate();
+}
+
+uint16_t device_linux::map_button(uint16_t native) const
+{
+    /* Unmapped buttons are reported with their native id */
+    return m_native_binding ? m_native_binding->map_button(native) : native;
+}
+
+uint16_t device_linux::map_axis(uint16_t native) const
+{
+    return m_native_binding ? m_native_binding->map_axis(native) : native;
+}
+
+void device_linux::configure_axes()
+{
+    for (int native = 0; native < ABS_CNT; native++)
+        m_axis_filter.configure(native, get_axis_deadzone(map_axis(uint16_t(native))));
+    m_axes_configured = true;
+}
+
+void device_linux::handle_event(const js_event& e)
+{
+    /* Events only update the raw snapshot. Joydev sends the current
+     * state of every button and axis as JS_EVENT_INIT events right
+     * after the device is opened. These also become the decoded state
+     * so they aren't reported as input */
+    bool init = (e.type & JS_EVENT_INIT) != 0;
+    uint16_t native = e.number;
+
+    if ((e.type & ~JS_EVENT_INIT) == JS_EVENT_BUTTON) {
+        uint64_t bit = uint64_t(1) << (native % 64);
+        if (e.value) {
+            m_state.buttons[native / 64] |= bit;
+            if (!init) {
+                m_pressed[native / 64] |= bit;
+                m_has_pressed = true;
+            }
+        } else {
+            m_state.buttons[native / 64] &= ~bit;
+        }
+
+        if (init) {
+            m_decoded.buttons[native / 64] ^= (m_decoded.buttons[native / 64] ^ m_state.buttons[native / 64]) & bit;
+            button_event(native, map_button(native), e.value, e.value ? 1.f : 0.f, false);
+        }
+    } else if ((e.type & ~JS_EVENT_INIT) == JS_EVENT_AXIS && native < m_state.axes.size()) {
+        m_state.axes[native] = e.value;
+        if (init) {
+            m_decoded.axes[native] = e.value;
+            m_axis_filter.seed(native, e.value);
+            axis_event(native, map_axis(native), e.value, clamp(e.value / 32767.f, -1.f, 1.f), false);
+        }
+    }
+}
+
+int device_linux::decode()
+{
+    int result = update_result::NONE;
+    for (int w = 0; w < int(m_state.buttons.size()); w++) {
+        uint64_t changed = m_state.buttons[w] ^ m_decoded.buttons[w];
+        uint64_t tapped = m_pressed[w] & ~changed;
+        uint64_t report = changed | m_pressed[w];
+        m_pressed[w] = 0;
+        while (report) {
+            int bit = __builtin_ctzll(report);
+            report &= report - 1;
+
+            /* A button pressed and released within one batch leaves the
+             * snapshot unchanged but is still input, so the press is
+             * reported ahead of the release */
+            uint16_t native = uint16_t(w * 64 + bit);
+            uint16_t vc = map_button(native);
+            int32_t value = (m_state.buttons[w] >> bit) & 1;
+            if (((tapped >> bit) & 1) && !value)
+                button_event(native, vc, 1, 1.f);
+            button_event(native, vc, value, value ? 1.f : 0.f);
+            result |= update_result::BUTTON;
+        }
+    }
+    m_has_pressed = false;
+
+    /* Every axis goes through the filter in one pass, so a resting or
+     * drifting stick doesn't generate events */
+    if (!m_axes_configured)
+        configure_axes();
+    uint64_t report = m_axis_filter.filter(m_state.axes.data(), m_axis_lanes);
+    while (report) {
+        int native = __builtin_ctzll(report);
+        report &= report - 1;
+
+        int32_t value = m_state.axes[native];
+        axis_event(uint16_t(native), map_axis(uint16_t(native)), value, clamp(value / 32767.f, -1.f, 1.f));
+        result |= update_result::AXIS;
+    }
+
+    m_decoded = m_state;
+    return result;
+}
+
+int device_linux::update()
+{
+    if (m_fd < 0)
+        return update_result::NONE;
+
+    /* Drain everything the kernel has queued, the descriptor is non-blocking */
+    js_event events[32];
+    for (;;) {
+        ssize_t n = read(m_fd, events, sizeof(events));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                invalidate(); /* ENODEV once the device is unplugged */
+            break;
+        }
+
+        int count = int(n / sizeof(js_event));
+        for (int i = 0; i < count; i++)
+            handle_event(events[i]);
+
+        if (n < ssize_t(sizeof(events)))
+            break;
+    }
+
+    /* Fast path. A batch that left the pad where it was, for example an
+     * axis jittering back to the same value, costs one compare of the
+     * snapshots and no decoding */
+    if (!m_has_pressed && m_state == m_decoded)
+        return update_result::NONE;
+    return decode();
+}
+
+void device_linux::set_binding(std::shared_ptr<cfg::binding> b)
+{
+    auto native = std::dynamic_pointer_cast<cfg::binding_linux>(b);
+    if (!native) {
+        gerr("Couldn't set binding.");
+        return;
+    }
+
+    device::set_binding(b);
+    m_native_binding = native;
+}
+}
@@ -0,0 +1,77 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+#include <array>
+#include <gamepad/binding-linux.hpp>
+#include <gamepad/device.hpp>
+#include <linux/input.h>
+#include <linux/joystick.h>
+
+#ifdef LGP_LINUX
+namespace gamepad {
+class device_linux : public device, public std::enable_shared_from_this<device_linux> {
+    int m_fd = -1;
+    std::string m_dev_path; /* Device node, also used as the cache id */
+    std::string m_id;
+    std::shared_ptr<cfg::binding_linux> m_native_binding;
+
+    /* Raw state by joydev number. Joydev numbers are 8 bit so the
+     * buttons fit in four words */
+    struct snapshot {
+        std::array<uint64_t, 4> buttons = {};
+        std::array<int16_t, ABS_CNT> axes = {};
+        bool operator==(const snapshot& o) const { return buttons == o.buttons && axes == o.axes; }
+    };
+
+    /* Events are applied to m_state as they are read. m_decoded is the
+     * state as of the last decode, so comparing the two tells whether
+     * anything needs decoding at all */
+    snapshot m_state;
+    snapshot m_decoded;
+
+    /* Buttons pressed since the last decode, so taps aren't lost */
+    std::array<uint64_t, 4> m_pressed = {};
+    bool m_has_pressed = false;
+
+    /* The axes are filtered by joydev axis number, this many of them */
+    static_assert(ABS_CNT <= axis_filter::max_lanes, "Every joydev axis needs a filter lane");
+    int m_axis_lanes = ABS_CNT;
+
+    uint16_t map_button(uint16_t native) const;
+    uint16_t map_axis(uint16_t native) const;
+    void configure_axes();
+    void handle_event(const js_event& e);
+    int decode();
+
+public:
+    device_linux(const std::string& path);
+    ~device_linux() { device_linux::deinit(); }
+
+    void init() override;
+    void deinit() override;
+    int update() override;
+    void set_binding(std::shared_ptr<cfg::binding> b) override;
+
+    int get_fd() const { return m_fd; }
+    const std::string& get_id() const override { return m_id; }
+    void set_id(const std::string& id) override { m_id = id; }
+    const std::string& get_cache_id() override { return m_dev_path; }
+};
+}
+#endif
@@ -0,0 +1,364 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "device-linux.hpp"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <gamepad/binding-default.hpp>
+#include <gamepad/hook-linux.hpp>
+#include <gamepad/log.hpp>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace gamepad {
+
+void linux_hook_thread(hook_linux* h)
+{
+    epoll_event events[LGP_LINUX_MAX_EVENTS];
+    uint64_t next_query = 0;
+
+    while (h->running()) {
+        int timeout = -1;
+        bool rescan = h->m_plug_and_play && h->m_inotify_fd < 0;
+        h->m_mutex.lock();
+        if (rescan) {
+            auto interval = uint64_t(std::chrono::duration_cast<ms>(h->m_plug_and_play_interval).count());
+            auto now = hook::ms_ticks();
+            if (next_query == 0)
+                next_query = now + interval;
+            timeout = next_query > now ? int(next_query - now) : 0;
+        }
+        h->m_mutex.unlock();
+
+        int count = epoll_wait(h->m_epoll_fd, events, LGP_LINUX_MAX_EVENTS, timeout);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            gerr("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(h->m_mutex);
+        event_batch* batch = h->m_batch.enabled() ? &h->m_batch : nullptr;
+        bool removed = false;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == &h->m_inotify_fd) {
+                removed |= h->handle_hotplug();
+                continue;
+            }
+
+            auto* dev = static_cast<device_linux*>(events[i].data.ptr);
+            if (!dev) {
+                /* Woken by stop() */
+                uint64_t val;
+                while (read(h->m_wake_fd, &val, sizeof(val)) > 0) { }
+                continue;
+            }
+
+            /* Whatever is still queued is read before a hangup is handled */
+            dev->set_batch(batch);
+            auto result = dev->update();
+            if (events[i].events & (EPOLLHUP | EPOLLERR))
+                dev->invalidate();
+            if (!dev->is_valid()) {
+                removed = true;
+                continue;
+            }
+
+            if (result & update_result::AXIS && h->m_axis_handler)
+                h->m_axis_handler(dev->shared_from_this());
+            if (result & update_result::BUTTON && h->m_button_handler)
+                h->m_button_handler(dev->shared_from_this());
+        }
+
+        if (batch)
+            batch->flush();
+        if (removed)
+            h->remove_invalid_devices();
+
+        if (rescan && hook::ms_ticks() >= next_query) {
+            h->query_devices();
+            next_query = 0;
+        }
+    }
+}
+
+hook_linux::hook_linux(uint16_t flags)
+{
+    m_use_by_id = (flags & hook_type::BY_ID) != 0;
+
+    /* In by-id mode only the joydev links are used, the -event-joystick
+     * links point to the evdev nodes of the same devices */
+    m_dir = m_use_by_id ? "/dev/input/by-id" : "/dev/input";
+}
+
+bool hook_linux::is_device_node(const std::string& name) const
+{
+    if (m_use_by_id) {
+        if (name.size() < 9 || name.compare(name.size() - 9, 9, "-joystick") != 0)
+            return false;
+        return name.find("-event-joystick") == std::string::npos;
+    }
+    return name.compare(0, 2, "js") == 0;
+}
+
+bool hook_linux::watch_device(const std::shared_ptr<device_linux>& dev)
+{
+    if (m_epoll_fd < 0)
+        return true;
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = dev.get();
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, dev->get_fd(), &ev) < 0) {
+        gerr("Couldn't watch %s: %s", dev->get_cache_id().c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void hook_linux::unwatch_device(const std::shared_ptr<device>& dev)
+{
+    auto ldev = std::static_pointer_cast<device_linux>(dev);
+    if (m_epoll_fd >= 0 && ldev->get_fd() >= 0)
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, ldev->get_fd(), nullptr);
+    ldev->deinit();
+}
+
+void hook_linux::add_device(const std::string& path)
+{
+    for (const auto& dev : m_devices) {
+        if (dev->get_cache_id() == path)
+            return;
+    }
+
+    /* Reuse the instance of a previously connected device so that
+     * references held by the user stay valid */
+    auto cached = m_device_cache.find(path);
+    if (cached != m_device_cache.end()) {
+        auto dev = std::static_pointer_cast<device_linux>(cached->second);
+        dev->init();
+        if (!dev->is_valid())
+            return;
+        if (!watch_device(dev)) {
+            dev->deinit();
+            return;
+        }
+
+        dev->set_index(int(m_devices.size()));
+        m_devices.emplace_back(dev);
+        if (m_reconnect_handler)
+            m_reconnect_handler(dev);
+        return;
+    }
+
+    auto dev = std::make_shared<device_linux>(path);
+    if (m_use_by_id)
+        dev->set_id(path.substr(path.rfind('/') + 1));
+    dev->init();
+    if (!dev->is_valid())
+        return;
+    if (!watch_device(dev)) {
+        dev->deinit();
+        return;
+    }
+
+    auto b = get_binding_for_device(dev->get_id());
+    dev->set_binding(b ? b : make_default_binding());
+    apply_calibration(dev);
+    dev->set_index(int(m_devices.size()));
+    m_device_cache[path] = dev;
+    m_devices.emplace_back(dev);
+    if (m_connect_handler)
+        m_connect_handler(dev);
+}
+
+void hook_linux::remove_invalid_devices()
+{
+    for (auto& dev : m_devices) {
+        if (!dev->is_valid())
+            unwatch_device(dev);
+    }
+    hook::remove_invalid_devices();
+}
+
+void hook_linux::query_devices()
+{
+    remove_invalid_devices();
+
+    DIR* d = opendir(m_dir.c_str());
+    if (!d) {
+        gdebug("Couldn't open %s", m_dir.c_str());
+        return;
+    }
+
+    while (auto* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (is_device_node(name))
+            add_device(m_dir + "/" + name);
+    }
+    closedir(d);
+}
+
+bool hook_linux::start_hotplug()
+{
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd < 0) {
+        gerr("Couldn't create inotify descriptor: %s", strerror(errno));
+        return false;
+    }
+
+    /* The node is created before udev gives it its permissions, so a
+     * device that can't be opened yet is tried again on IN_ATTRIB. The
+     * by-id links are created by udev once the device is ready */
+    uint32_t mask = IN_CREATE | IN_ATTRIB | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &m_inotify_fd;
+    if (inotify_add_watch(m_inotify_fd, m_dir.c_str(), mask) < 0
+        || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_inotify_fd, &ev) < 0) {
+        gdebug("Couldn't watch %s: %s", m_dir.c_str(), strerror(errno));
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool hook_linux::handle_hotplug()
+{
+    /* Only the device named in each notification is probed. A device
+     * seen before is taken from the cache by add_device */
+    bool removed = false;
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        ssize_t n = read(m_inotify_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (char* p = buf; p < buf + n;) {
+            auto* e = reinterpret_cast<inotify_event*>(p);
+            p += sizeof(inotify_event) + e->len;
+            if (!e->len || !is_device_node(e->name))
+                continue;
+
+            std::string path = m_dir + "/" + e->name;
+            if (e->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                for (auto& dev : m_devices) {
+                    if (dev->get_cache_id() == path) {
+                        dev->invalidate();
+                        removed = true;
+                    }
+                }
+            } else {
+                add_device(path);
+            }
+        }
+    }
+    return removed;
+}
+
+bool hook_linux::start()
+{
+    if (m_running)
+        return true;
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd < 0 || m_wake_fd < 0) {
+        gerr("Couldn't create hook descriptors: %s", strerror(errno));
+        stop();
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &ev);
+
+    /* The watch is set up before the first scan so that nothing plugged
+     * in between the two is missed */
+    if (m_hotplug && !start_hotplug() && m_plug_and_play)
+        gdebug("Falling back to plug and play rescans");
+
+    m_mutex.lock();
+    /* Devices found before start() was called still need to be watched */
+    for (auto& dev : m_devices)
+        watch_device(std::static_pointer_cast<device_linux>(dev));
+    query_devices();
+    m_mutex.unlock();
+
+    m_running = true;
+    m_hook_thread = std::thread(linux_hook_thread, this);
+    return true;
+}
+
+void hook_linux::stop()
+{
+    if (m_running) {
+        m_running = false;
+        uint64_t one = 1;
+        if (write(m_wake_fd, &one, sizeof(one)) < 0)
+            gerr("Couldn't wake hook thread: %s", strerror(errno));
+    }
+    hook::stop();
+
+    if (m_wake_fd >= 0) {
+        close(m_wake_fd);
+        m_wake_fd = -1;
+    }
+    if (m_inotify_fd >= 0) {
+        close(m_inotify_fd);
+        m_inotify_fd = -1;
+    }
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+}
+
+std::shared_ptr<cfg::binding> hook_linux::make_empty_binding()
+{
+    return std::make_shared<cfg::binding_linux>();
+}
+
+std::shared_ptr<cfg::binding> hook_linux::make_default_binding()
+{
+    return std::make_shared<cfg::binding_linux>(defaults::linux_binding);
+}
+
+#ifdef LGP_ENABLE_JSON
+std::shared_ptr<cfg::binding> hook_linux::make_native_binding(const json11::Json& j)
+{
+    return std::make_shared<cfg::binding_linux>(j);
+}
+
+const json11::Json& hook_linux::get_default_binding()
+{
+    if (cfg::linux_default_binding.is_null())
+        cfg::linux_default_binding = json11::Json::parse(defaults::linux_bind_json, cfg::default_error);
+    return cfg::linux_default_binding;
+}
+#endif
+}
@@ -0,0 +1,81 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <cstdio>
+#include <gamepad/config.h>
+#include <gamepad/log.hpp>
+
+namespace gamepad {
+
+void def_log_handler(int lvl, const char* msg, va_list args, void* param)
+{
+    LGP_UNUSED(param);
+    char out[4096];
+    vsnprintf(out, sizeof(out), msg, args);
+
+    switch (lvl) {
+    case LOG_DEBUG:
+        fprintf(stdout, "debug: %s\n", out);
+        fflush(stdout);
+        break;
+    case LOG_INFO:
+        fprintf(stdout, "info: %s\n", out);
+        fflush(stdout);
+        break;
+    case LOG_WARNING:
+        fprintf(stdout, "warning: %s\n", out);
+        fflush(stdout);
+        break;
+    case LOG_ERROR:
+        fprintf(stderr, "error: %s\n", out);
+        fflush(stderr);
+        break;
+    }
+}
+
+log_handler logger = def_log_handler;
+void* log_param = nullptr;
+
+void get_logger(log_handler* handler, void** param)
+{
+    if (handler)
+        *handler = logger;
+    if (param)
+        *param = log_param;
+}
+
+void set_logger(log_handler handler, void* param)
+{
+    logger = handler;
+    log_param = param;
+}
+
+void logva(int log_level, const char* format, va_list args)
+{
+    if (logger)
+        logger(log_level, format, args, log_param);
+}
+
+void log(int log_level, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logva(log_level, format, args);
+    va_end(args);
+}
+}
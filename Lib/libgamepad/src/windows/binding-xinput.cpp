@@ -0,0 +1,41 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <gamepad/binding-xinput.hpp>
+
+namespace gamepad {
+namespace cfg {
+#ifdef LGP_ENABLE_JSON
+    json11::Json xinput_default_binding;
+#endif
+
+#if LGP_WINDOWS
+    binding_xinput::binding_xinput(const std::string& json)
+        : binding(json)
+    {
+    }
+
+#ifdef LGP_ENABLE_JSON
+    binding_xinput::binding_xinput(const json11::Json& j)
+        : binding(j)
+    {
+    }
+#endif
+#endif
+}
+}
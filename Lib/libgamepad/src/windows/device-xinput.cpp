@@ -0,0 +1,119 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "device-xinput.hpp"
+#include <cstddef>
+#include <cstring>
+#include <gamepad/log.hpp>
+
+namespace gamepad {
+
+device_xinput::device_xinput(uint8_t id, const xinput_refresh_t& refresh)
+    : m_id(id)
+    , m_refresh(refresh)
+{
+    m_name = "Generic Xinput gamepad " + std::to_string(int(id) + 1);
+    m_cache_id = "xinput" + std::to_string(int(id));
+    m_index = id;
+}
+
+void device_xinput::configure_axes()
+{
+    for (int lane = 0; lane < axis_lanes; lane++)
+        m_axis_filter.configure(lane, lane < axis::COUNT ? m_axis_deadzones[lane] : -1);
+    m_axes_configured = true;
+}
+
+int device_xinput::update()
+{
+    int result = update_result::NONE;
+    if (!m_refresh || m_refresh(m_id, &m_pad) != ERROR_SUCCESS) {
+        invalidate();
+        return result;
+    }
+
+    if (!m_native_binding)
+        return result;
+
+    /* Fast path for idle pads. XInput only bumps the packet number when
+     * the state changes, and if it did change the rest of the packet is
+     * compared in one go before anything is decoded. A new packet number
+     * with the same state means input came and went between polls, unless
+     * a stick drifts, which changes the packet number by itself */
+    if (m_decoded_valid) {
+        if (m_pad.eventCount == m_decoded_pad.eventCount)
+            return result;
+        const size_t state_offset = offsetof(xinput_pad, wButtons);
+        if (memcmp(reinterpret_cast<const char*>(&m_pad) + state_offset,
+                reinterpret_cast<const char*>(&m_decoded_pad) + state_offset, sizeof(xinput_pad) - state_offset)
+            == 0) {
+            m_decoded_pad.eventCount = m_pad.eventCount;
+            return m_axis_filter.has_drift(axis_lanes) ? update_result::NONE : update_result::PACKET;
+        }
+    }
+    m_decoded_pad = m_pad;
+    m_decoded_valid = true;
+
+    for (const auto& map : m_native_binding->get_button_mappings()) {
+        bool pressed = (m_pad.wButtons & map.first) != 0;
+        if (pressed != is_button_pressed(map.second)) {
+            button_event(map.first, map.second, pressed, pressed ? 1.f : 0.f);
+            result |= update_result::BUTTON;
+        }
+    }
+
+    /* Triggers are scaled up to the stick range so the same deadzone
+     * values make sense for both. Every axis goes through the filter in
+     * one pass, so a resting or drifting stick doesn't generate events */
+    if (!m_axes_configured)
+        configure_axes();
+    int16_t values[axis_lanes] = {};
+    values[axis::LEFT_STICK_X - axis::LEFT_STICK_X] = m_pad.sThumbLX;
+    values[axis::LEFT_STICK_Y - axis::LEFT_STICK_X] = m_pad.sThumbLY;
+    values[axis::LEFT_TRIGGER - axis::LEFT_STICK_X] = int16_t(m_pad.bLeftTrigger * 128);
+    values[axis::RIGHT_STICK_X - axis::LEFT_STICK_X] = m_pad.sThumbRX;
+    values[axis::RIGHT_STICK_Y - axis::LEFT_STICK_X] = m_pad.sThumbRY;
+    values[axis::RIGHT_TRIGGER - axis::LEFT_STICK_X] = int16_t(m_pad.bRightTrigger * 128);
+
+    uint64_t report = m_axis_filter.filter(values, axis_lanes);
+    for (int lane = 0; lane < axis::COUNT; lane++) {
+        if (!((report >> lane) & 1))
+            continue;
+
+        uint16_t vc = uint16_t(axis::LEFT_STICK_X + lane);
+        bool trigger = vc == axis::LEFT_TRIGGER || vc == axis::RIGHT_TRIGGER;
+        float vv = trigger ? values[lane] / (255.f * 128.f) : clamp(values[lane] / 32767.f, -1.f, 1.f);
+        axis_event(vc, vc, values[lane], vv);
+        result |= update_result::AXIS;
+    }
+    return result;
+}
+
+void device_xinput::set_binding(std::shared_ptr<cfg::binding> b)
+{
+    auto native = std::dynamic_pointer_cast<cfg::binding_xinput>(b);
+    if (!native) {
+        gerr("Couldn't set binding.");
+        return;
+    }
+
+    device::set_binding(b);
+    m_native_binding = native;
+    m_decoded_valid = false;
+}
+}
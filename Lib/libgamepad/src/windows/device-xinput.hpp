@@ -0,0 +1,52 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+#include <gamepad/binding-xinput.hpp>
+#include <gamepad/hook-xinput.hpp>
+
+#ifdef LGP_WINDOWS
+namespace gamepad {
+class device_xinput : public device {
+    uint8_t m_id;
+    xinput_refresh_t m_refresh = nullptr;
+    xinput_pad m_pad = {};
+
+    /* The packet that was last decoded. Invalidated when the binding
+     * changes so the next poll decodes everything against it */
+    xinput_pad m_decoded_pad = {};
+    bool m_decoded_valid = false;
+    std::string m_cache_id;
+    std::shared_ptr<cfg::binding_xinput> m_native_binding;
+
+    /* The axes are filtered in the order of gamepad::axis, in one block
+     * of eight lanes */
+    static constexpr int axis_lanes = 8;
+    static_assert(axis::COUNT <= axis_lanes, "Every XInput axis needs a filter lane");
+
+    void configure_axes();
+
+public:
+    device_xinput(uint8_t id, const xinput_refresh_t& refresh);
+
+    int update() override;
+    void set_binding(std::shared_ptr<cfg::binding> b) override;
+    const std::string& get_cache_id() override { return m_cache_id; }
+};
+}
+#endif
@@ -0,0 +1,123 @@
+/**
+ ** This file is part of the libgamepad project.
+ ** Copyright 2020 univrsal <universailp@web.de>.
+ **
+ ** This program is free software: you can redistribute it and/or modify
+ ** it under the terms of the GNU Lesser General Public License as
+ ** published by the Free Software Foundation, either version 3 of the
+ ** License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ ** GNU Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public License
+ ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "device-xinput.hpp"
+#include <gamepad/binding-default.hpp>
+#include <cstdio>
+#include <gamepad/log.hpp>
+
+namespace gamepad {
+
+bool hook_xinput::start()
+{
+    if (m_running)
+        return true;
+
+    if (!m_xinput) {
+        wchar_t path[MAX_PATH];
+        UINT len = GetSystemDirectoryW(path, MAX_PATH);
+        if (len == 0 || len + 16 >= MAX_PATH)
+            return false;
+        wcscat_s(path, L"\\xinput1_4.dll");
+        m_xinput = LoadLibraryW(path);
+        if (!m_xinput) {
+            gerr("Couldn't load xinput1_4.dll");
+            return false;
+        }
+    }
+
+    /* Ordinal 100 is the undocumented XInputGetStateEx, which also reports
+     * the guide button. Fall back to the regular one if it's missing */
+    m_xinput_refresh = reinterpret_cast<xinput_refresh_t>(GetProcAddress(m_xinput, reinterpret_cast<LPCSTR>(100)));
+    if (!m_xinput_refresh)
+        m_xinput_refresh = reinterpret_cast<xinput_refresh_t>(GetProcAddress(m_xinput, "XInputGetState"));
+    if (!m_xinput_refresh) {
+        gerr("Couldn't find XInputGetState");
+        return false;
+    }
+
+    return hook::start();
+}
+
+void hook_xinput::query_devices()
+{
+    remove_invalid_devices();
+
+    for (uint8_t i = 0; i < LGP_XINPUT_DEVICES; i++) {
+        xinput_pad pad;
+        if (m_xinput_refresh(i, &pad) != ERROR_SUCCESS)
+            continue;
+
+        /* This runs every plug and play interval for every connected pad,
+         * so the id is formatted without allocating */
+        char cache_id[16];
+        snprintf(cache_id, sizeof(cache_id), "xinput%d", int(i));
+        bool connected = false;
+        for (auto& dev : m_devices) {
+            if (dev->get_cache_id() == cache_id)
+                connected = true;
+        }
+        if (connected)
+            continue;
+
+        auto cached = m_device_cache.find(cache_id);
+        if (cached != m_device_cache.end()) {
+            auto dev = cached->second;
+            dev->set_valid();
+            m_devices.emplace_back(dev);
+            if (m_reconnect_handler)
+                m_reconnect_handler(dev);
+            continue;
+        }
+
+        auto dev = std::make_shared<device_xinput>(i, m_xinput_refresh);
+        auto b = get_binding_for_device(dev->get_id());
+        dev->set_binding(b ? b : make_default_binding());
+        apply_calibration(dev);
+        dev->set_valid();
+        m_device_cache[cache_id] = dev;
+        m_devices.emplace_back(dev);
+        if (m_connect_handler)
+            m_connect_handler(dev);
+    }
+}
+
+std::shared_ptr<cfg::binding> hook_xinput::make_empty_binding()
+{
+    return std::make_shared<cfg::binding_xinput>();
+}
+
+std::shared_ptr<cfg::binding> hook_xinput::make_default_binding()
+{
+    return std::make_shared<cfg::binding_xinput>(defaults::xinput_binding);
+}
+
+#ifdef LGP_ENABLE_JSON
+std::shared_ptr<cfg::binding> hook_xinput::make_native_binding(const json11::Json& j)
+{
+    return std::make_shared<cfg::binding_xinput>(j);
+}
+
+const json11::Json& hook_xinput::get_default_binding()
+{
+    if (cfg::xinput_default_binding.is_null())
+        cfg::xinput_default_binding = json11::Json::parse(defaults::xinput_bind_json, cfg::default_error);
+    return cfg::xinput_default_binding;
+}
+#endif
+}
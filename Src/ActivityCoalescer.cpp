@@ -0,0 +1,128 @@
+// ActivityCoalescer.cpp
+//
+// Per-source activity coalescing in front of the idle engine.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <limits>
+#include "ActivityCoalescer.h"
+
+
+const char* Lockdown::GetSourceName(ActivitySource source)
+{
+	static const char* names[ActivitySource_NumSources] =
+	{
+		"keyboard",
+		"mouse_move",
+		"mouse_button",
+		"pad_button",
+		"pad_axis"
+	};
+
+	if ((source < 0) || (source >= ActivitySource_NumSources))
+		return "unknown";
+	return names[source];
+}
+
+
+Lockdown::ActivityCoalescer::ActivityCoalescer(IdleEngine& engine, int64_t windowMs) :
+	Engine(engine),
+	TimeoutMs(engine.GetTimeout()),
+	LimitMs(GetMaxWindow(engine.GetTimeout())),
+	KeysDown()
+{
+	for (Source& src : Sources)
+	{
+		src.WindowEndMs.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+		src.NumAccepted.store(0, std::memory_order_relaxed);
+		src.NumCoalesced.store(0, std::memory_order_relaxed);
+		src.ConfiguredMs = windowMs;
+	}
+	UpdateWindows();
+}
+
+
+void Lockdown::ActivityCoalescer::SetWindow(ActivitySource source, int64_t windowMs)
+{
+	Sources[source].ConfiguredMs = windowMs;
+	UpdateWindows();
+}
+
+
+void Lockdown::ActivityCoalescer::SetWindows(int64_t windowMs)
+{
+	for (Source& src : Sources)
+		src.ConfiguredMs = windowMs;
+	UpdateWindows();
+}
+
+
+void Lockdown::ActivityCoalescer::SetTimeout(int64_t timeoutMs)
+{
+	TimeoutMs = timeoutMs;
+	LimitMs = GetMaxWindow(timeoutMs);
+	UpdateWindows();
+}
+
+
+void Lockdown::ActivityCoalescer::UpdateWindows()
+{
+	for (Source& src : Sources)
+	{
+		int64_t windowMs = (src.ConfiguredMs < LimitMs) ? src.ConfiguredMs : LimitMs;
+		src.WindowMs.store((windowMs > 0) ? windowMs : 0, std::memory_order_relaxed);
+	}
+}
+
+
+bool Lockdown::ActivityCoalescer::ReportKey(int key, bool down, int64_t nowMs)
+{
+	// Keys out of range cannot be tracked so every press of one is treated as a new press.
+	if ((key < 0) || (key >= MaxKeys))
+		return down ? Report(ActivitySource_Keyboard, nowMs) : false;
+
+	uint64_t& word = KeysDown[key / 64];
+	uint64_t bit = uint64_t(1) << (key % 64);
+	if (!down)
+	{
+		word &= ~bit;
+		return false;
+	}
+
+	// A press of a key that is already down is auto-repeat.
+	if (word & bit)
+	{
+		Increment(Sources[ActivitySource_Keyboard].NumCoalesced);
+		return false;
+	}
+
+	word |= bit;
+	return Report(ActivitySource_Keyboard, nowMs);
+}
+
+
+void Lockdown::ActivityCoalescer::Reset(int64_t countdownMs)
+{
+	// Windows that were limited by an earlier short countdown go back to the timeout's limit.
+	int64_t limitMs = GetMaxWindow(((countdownMs > 0) && (countdownMs < TimeoutMs)) ? countdownMs : TimeoutMs);
+	if (limitMs != LimitMs)
+	{
+		LimitMs = limitMs;
+		UpdateWindows();
+	}
+
+	for (Source& src : Sources)
+		src.WindowEndMs.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+
+	for (uint64_t& word : KeysDown)
+		word = 0;
+}
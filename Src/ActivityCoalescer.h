@@ -0,0 +1,141 @@
+// ActivityCoalescer.h
+//
+// Coalesces activity reports before they reach the idle engine. Once a source has reported activity, anything else it
+// reports within its window carries no new information as far as a timeout measured in minutes is concerned. Those
+// events are dropped with a single compare and never touch the engine. Keyboard auto-repeat is suppressed entirely: a
+// key that is already down does not count again until it has been released. Every source keeps counts of accepted and
+// coalesced events so the saving can be measured.
+//
+// Coalescing means the engine may see the last activity up to one window earlier than it really happened, so a lock can
+// come at most one window early. Windows are therefore limited to a tenth of the countdown they apply to, whatever they
+// are configured to, which bounds the error to 10%. A window of zero passes everything through.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "IdleEngine.h"
+
+
+namespace Lockdown
+{
+	enum ActivitySource
+	{
+		ActivitySource_Keyboard,
+		ActivitySource_MouseMove,
+		ActivitySource_MouseButton,												// Includes the mouse wheel.
+		ActivitySource_PadButton,
+		ActivitySource_PadAxis,
+		ActivitySource_NumSources
+	};
+
+	// Returns a short lowercase name for the source, for example "mouse_move".
+	const char* GetSourceName(ActivitySource);
+
+	class ActivityCoalescer
+	{
+	public:
+		ActivityCoalescer(IdleEngine&, int64_t windowMs = 1000);
+
+		// The longest window allowed for a countdown of the given length.
+		static int64_t GetMaxWindow(int64_t countdownMs)																{ return (countdownMs > 0) ? countdownMs / 10 : 0; }
+
+		// Window configuration. These are only expected to be called by the engine thread. The timeout limits every
+		// window and must be set again whenever the engine timeout changes. Changing a window does not affect a window
+		// that is already open. GetWindow returns the window in use, after limiting.
+		void SetWindow(ActivitySource source, int64_t windowMs);
+		void SetWindows(int64_t windowMs);
+		void SetTimeout(int64_t timeoutMs);
+		int64_t GetWindow(ActivitySource source) const																	{ return Sources[source].WindowMs.load(std::memory_order_relaxed); }
+
+		// Producer interface. Each source is expected to be reported from a single thread (the hook or input thread that
+		// owns it). Different sources may be reported from different threads. Report returns true if the event was
+		// passed on to the engine and false if it was coalesced.
+		bool Report(ActivitySource source)																				{ return Report(source, GetTimeMs()); }
+		inline bool Report(ActivitySource, int64_t nowMs);
+
+		// Returns true and counts the event as coalesced if the source's window is open. Use this in front of filters
+		// that cost more than a compare, like the mouse distance check, and call Report afterwards if the event passes.
+		inline bool TryCoalesce(ActivitySource, int64_t nowMs);
+
+		// Keyboard events with auto-repeat suppression. Key is a platform key code (virtual-key code on Windows, evdev
+		// code on Linux). Only a press of a key that is not already down counts as activity. Releases are tracked but
+		// never count.
+		bool ReportKey(int key, bool down, int64_t nowMs);
+
+		// Closes all open windows so the next event from every source reaches the engine, and forgets which keys are
+		// down. Call after anything that moves the countdown backwards, like forcing a lock in a few seconds, so input
+		// right after it is not lost. Also call after locking since key releases on the lock screen are never seen.
+		// A countdown shorter than the timeout, like the few seconds of a forced lock, limits the windows further until
+		// the next reset. Must be called from the thread that reports keyboard events, which must also be the engine
+		// thread if a countdown is given.
+		void Reset(int64_t countdownMs = 0);
+
+		uint64_t GetNumAccepted(ActivitySource source) const															{ return Sources[source].NumAccepted.load(std::memory_order_relaxed); }
+		uint64_t GetNumCoalesced(ActivitySource source) const															{ return Sources[source].NumCoalesced.load(std::memory_order_relaxed); }
+
+	private:
+		// Counters have a single writer so a relaxed load and store is enough and avoids a locked add.
+		static void Increment(std::atomic<uint64_t>& count)															{ count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+		// Stores every window limited to LimitMs.
+		void UpdateWindows();
+
+		// Each source is written by its own producer thread so they live on separate cache lines. ConfiguredMs is only
+		// touched by the engine thread.
+		struct alignas(64) Source
+		{
+			std::atomic<int64_t> WindowEndMs;
+			std::atomic<int64_t> WindowMs;
+			std::atomic<uint64_t> NumAccepted;
+			std::atomic<uint64_t> NumCoalesced;
+			int64_t ConfiguredMs;
+		};
+
+		IdleEngine& Engine;
+		Source Sources[ActivitySource_NumSources];
+		int64_t TimeoutMs;
+		int64_t LimitMs;																// The largest window allowed now.
+
+		// Keys currently down. Large enough for both virtual-key codes and evdev key codes (KEY_MAX is 0x2FF).
+		static const int MaxKeys = 1024;
+		uint64_t KeysDown[MaxKeys / 64];
+	};
+}
+
+
+// Implementation below this line.
+
+
+inline bool Lockdown::ActivityCoalescer::TryCoalesce(ActivitySource source, int64_t nowMs)
+{
+	Source& src = Sources[source];
+	if (nowMs >= src.WindowEndMs.load(std::memory_order_relaxed))
+		return false;
+
+	Increment(src.NumCoalesced);
+	return true;
+}
+
+
+inline bool Lockdown::ActivityCoalescer::Report(ActivitySource source, int64_t nowMs)
+{
+	if (TryCoalesce(source, nowMs))
+		return false;
+
+	Source& src = Sources[source];
+	src.WindowEndMs.store(nowMs + src.WindowMs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	Increment(src.NumAccepted);
+	Engine.ReportActivity(nowMs);
+	return true;
+}
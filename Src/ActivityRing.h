@@ -0,0 +1,107 @@
+// ActivityRing.h
+//
+// A wait-free single-producer single-consumer ring of compact activity records. An input thread other than the engine
+// thread (the gamepad hook thread) pushes a record per event and the engine thread drains them in batches. This keeps
+// console output, tracing, and reporting to the coalescer off the input thread. A full ring never blocks the producer.
+// The record is dropped and counted, and its source is remembered so the activity itself is never lost. The producer
+// only asks for the consumer to be woken when the consumer has drained since the last wake.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "ActivityCoalescer.h"
+
+
+namespace Lockdown
+{
+	// 32 bytes so two fit in a cache line.
+	struct ActivityRecord
+	{
+		uint64_t EventTime;															// Device timestamp, as traced.
+		int64_t TimeMs;																// GetTimeMs when pushed.
+		int32_t Value;
+		uint16_t NativeID;
+		uint16_t VC;
+		uint8_t Source;																// An ActivitySource.
+		uint8_t Type;																// A TraceType.
+		uint8_t Device;
+		uint8_t Pad;
+	};
+
+	class ActivityRing
+	{
+	public:
+		static const uint32_t Capacity = 1024;										// Must be a power of two.
+
+		ActivityRing()																									: Head(0), Tail(0), NumOverflows(0), OverflowSources(0), Signalled(false) { }
+
+		// Producer side. Returns false if the ring was full and the record was dropped.
+		inline bool Push(const ActivityRecord&);
+
+		// Producer side. Call after pushing a batch. Returns true if the consumer needs to be woken to drain.
+		bool Publish()																									{ return !Signalled.exchange(true, std::memory_order_seq_cst); }
+
+		// Consumer side. Calls fn for every record in the order pushed and returns how many there were. Re-arms the
+		// wake before reading so a record pushed during the drain causes another wake.
+		template<typename Fn> inline int Drain(Fn&& fn);
+
+		// Consumer side. Returns a bit per ActivitySource that had records dropped since the last call.
+		uint32_t TakeOverflowSources()																					{ return OverflowSources.exchange(0, std::memory_order_relaxed); }
+
+		uint64_t GetNumOverflows() const																				{ return NumOverflows.load(std::memory_order_relaxed); }
+
+	private:
+		alignas(64) std::atomic<uint32_t> Head;										// Written by the producer only.
+		alignas(64) std::atomic<uint32_t> Tail;										// Written by the consumer only.
+		alignas(64) std::atomic<uint64_t> NumOverflows;
+		std::atomic<uint32_t> OverflowSources;
+		std::atomic<bool> Signalled;
+		alignas(64) ActivityRecord Records[Capacity];
+	};
+}
+
+
+// Implementation below this line.
+
+
+inline bool Lockdown::ActivityRing::Push(const ActivityRecord& record)
+{
+	uint32_t head = Head.load(std::memory_order_relaxed);
+	if (head - Tail.load(std::memory_order_acquire) >= Capacity)
+	{
+		// Only the producer writes the overflow count so a load and store is enough.
+		NumOverflows.store(NumOverflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		OverflowSources.fetch_or(1u << record.Source, std::memory_order_relaxed);
+		return false;
+	}
+
+	Records[head & (Capacity - 1)] = record;
+	Head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+
+template<typename Fn> inline int Lockdown::ActivityRing::Drain(Fn&& fn)
+{
+	// The store to Signalled and the load of Head must not be reordered or a record pushed in between could be left
+	// without a wake, hence sequentially consistent.
+	Signalled.store(false, std::memory_order_seq_cst);
+	uint32_t head = Head.load(std::memory_order_seq_cst);
+	uint32_t tail = Tail.load(std::memory_order_relaxed);
+	int count = int(head - tail);
+	for (; tail != head; tail++)
+		fn(Records[tail & (Capacity - 1)]);
+	Tail.store(tail, std::memory_order_release);
+	return count;
+}
@@ -0,0 +1,432 @@
+// ActivityTrace.cpp
+//
+// Binary activity trace recording and memory-mapped playback.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include <ctime>
+#include "IdleEngine.h"
+#include "ActivityTrace.h"
+
+
+namespace Lockdown
+{
+	const char TraceMagic[7]				= { 'L', 'D', 'T', 'R', 'A', 'C', 'E' };
+	const uint8_t TraceVersion				= 2;
+	const int TraceHeaderSize				= 8;
+
+	// Buffered records are written out at least this often so a trace from a process that is killed is still useful.
+	const int64_t TraceFlushIntervalMs		= 10*1000;
+}
+
+
+bool Lockdown::ActivityTraceWriter::Open(const char* path, const TraceConfig& config)
+{
+	Close();
+	std::lock_guard<std::mutex> lock(Mutex);
+	File = fopen(path, "a+b");
+	if (!File)
+		return false;
+
+	// Writes always go to the end in append mode, so the header can be read first. An empty file is a new one. Sessions
+	// of a different version in one file couldn't be told apart, so another version's trace is left alone.
+	uint8_t header[TraceHeaderSize];
+	size_t headerSize = fread(header, 1, sizeof(header), File);
+	if (headerSize == 0)
+	{
+		memcpy(header, TraceMagic, sizeof(TraceMagic));
+		header[7] = TraceVersion;
+		fwrite(header, 1, sizeof(header), File);
+	}
+	else if ((headerSize != sizeof(header)) || (memcmp(header, TraceMagic, sizeof(TraceMagic)) != 0) || (header[7] != TraceVersion))
+	{
+		fclose(File);
+		File = nullptr;
+		return false;
+	}
+
+	// The sync record carries absolute values so everything after it can be delta encoded from scratch.
+	int64_t nowMs = GetTimeMs();
+	PrevTimeMs = nowMs;
+	PrevX = PrevY = 0;
+	PrevPadTimeMs = 0;
+	LastFlushMs = nowMs;
+
+	PutVarint(uint64_t(TraceType_Sync));
+	PutVarint(uint64_t(nowMs));
+	PutSigned(int64_t(time(nullptr)));
+	PutVarint(uint64_t(config.TimeoutMs));
+	PutVarint(uint64_t(config.MaxSuspendMs));
+	PutVarint(uint64_t(config.WindowMs));
+	PutVarint(uint64_t(config.DistanceThreshold));
+	PutVarint(uint64_t(PolicyStage_NumStages));
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		PutVarint(config.StageEnabled[s] ? 1 : 0);
+		PutSigned(config.StageOffsetMs[s]);
+	}
+	FlushLocked();
+	return true;
+}
+
+
+void Lockdown::ActivityTraceWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	BeginRecord(TraceType_Command);
+	PutVarint(uint32_t(TraceCommand_Exit));
+	PutSigned(0);
+	FlushLocked();
+	fclose(File);
+	File = nullptr;
+}
+
+
+void Lockdown::ActivityTraceWriter::Flush()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (File)
+		FlushLocked();
+}
+
+
+void Lockdown::ActivityTraceWriter::FlushLocked()
+{
+	if (BufferUsed > 0)
+		fwrite(Buffer, 1, BufferUsed, File);
+	fflush(File);
+	BufferUsed = 0;
+	LastFlushMs = PrevTimeMs;
+}
+
+
+void Lockdown::ActivityTraceWriter::BeginRecord(TraceType type)
+{
+	// Time can only go backwards here if two threads raced to the mutex. Clamping keeps the delta unsigned.
+	int64_t nowMs = GetTimeMs();
+	int64_t deltaMs = (nowMs > PrevTimeMs) ? nowMs - PrevTimeMs : 0;
+	PrevTimeMs += deltaMs;
+
+	if ((BufferUsed + MaxRecordSize > BufferSize) || (PrevTimeMs - LastFlushMs >= TraceFlushIntervalMs))
+		FlushLocked();
+
+	PutVarint((uint64_t(deltaMs) << 3) | uint64_t(type));
+}
+
+
+void Lockdown::ActivityTraceWriter::PutVarint(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		Buffer[BufferUsed++] = uint8_t(value) | 0x80;
+		value >>= 7;
+	}
+	Buffer[BufferUsed++] = uint8_t(value);
+}
+
+
+void Lockdown::ActivityTraceWriter::WriteKeyInternal(int key, bool down)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	BeginRecord(TraceType_Key);
+	PutVarint((uint64_t(uint32_t(key)) << 1) | (down ? 1 : 0));
+}
+
+
+void Lockdown::ActivityTraceWriter::WriteCodeInternal(TraceType type, int code)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	BeginRecord(type);
+	PutVarint(uint32_t(code));
+}
+
+
+void Lockdown::ActivityTraceWriter::WriteMouseInternal(TraceType type, int x, int y)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	// Absolute positions are delta encoded against the previous position. Relative motion is already small.
+	BeginRecord(type);
+	if (type == TraceType_MousePos)
+	{
+		PutSigned(int64_t(x) - PrevX);
+		PutSigned(int64_t(y) - PrevY);
+		PrevX = x;
+		PrevY = y;
+	}
+	else
+	{
+		PutSigned(x);
+		PutSigned(y);
+	}
+}
+
+
+void Lockdown::ActivityTraceWriter::WritePadInternal(TraceType type, int device, int nativeID, int vc, int32_t value, uint64_t padTimeMs)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	BeginRecord(type);
+	PutVarint(uint32_t(device));
+	PutVarint(uint32_t(nativeID));
+	PutVarint(uint32_t(vc));
+	PutSigned(value);
+	PutSigned(int64_t(padTimeMs) - PrevPadTimeMs);
+	PrevPadTimeMs = int64_t(padTimeMs);
+}
+
+
+void Lockdown::ActivityTraceWriter::WriteCommandInternal(TraceCommand command, int64_t value)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	if (!File)
+		return;
+
+	// Commands are rare and are usually what a bug report is about, so they go straight to the file.
+	BeginRecord(TraceType_Command);
+	PutVarint(uint32_t(command));
+	PutSigned(value);
+	FlushLocked();
+}
+
+
+bool Lockdown::ActivityTraceReader::Open(const char* path)
+{
+	Close();
+
+	#if defined(PLATFORM_WINDOWS)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (size.QuadPart < TraceHeaderSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view)
+	{
+		if (map)
+			CloseHandle(map);
+		CloseHandle(file);
+		return false;
+	}
+	FileHandle = file;
+	MapHandle = map;
+	Mapping = (const uint8_t*)view;
+	MappingSize = int64_t(size.QuadPart);
+
+	#else
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if ((fstat(fd, &st) != 0) || (st.st_size < TraceHeaderSize))
+	{
+		close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file alive so the descriptor is not needed afterwards. Records are read front to back.
+	void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	madvise(view, size_t(st.st_size), MADV_SEQUENTIAL);
+	Mapping = (const uint8_t*)view;
+	MappingSize = int64_t(st.st_size);
+	#endif
+
+	if ((memcmp(Mapping, TraceMagic, sizeof(TraceMagic)) != 0) || (Mapping[7] < 1) || (Mapping[7] > TraceVersion))
+	{
+		Close();
+		return false;
+	}
+
+	Version = Mapping[7];
+	Begin = Mapping + TraceHeaderSize;
+	End = Mapping + MappingSize;
+	Cursor = Begin;
+	Corrupt = false;
+	return true;
+}
+
+
+void Lockdown::ActivityTraceReader::Close()
+{
+	if (Mapping)
+	{
+		#if defined(PLATFORM_WINDOWS)
+		UnmapViewOfFile(Mapping);
+		CloseHandle(MapHandle);
+		CloseHandle(FileHandle);
+		MapHandle = FileHandle = nullptr;
+		#else
+		munmap((void*)Mapping, size_t(MappingSize));
+		#endif
+	}
+
+	Mapping = Begin = End = Cursor = nullptr;
+	MappingSize = 0;
+}
+
+
+bool Lockdown::ActivityTraceReader::GetVarint(uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (Cursor >= End)
+			return false;
+
+		uint8_t byte = *Cursor++;
+		value |= uint64_t(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+
+	// More than 10 bytes cannot be a varint we wrote.
+	Corrupt = true;
+	return false;
+}
+
+
+bool Lockdown::ActivityTraceReader::Next(TraceRecord& rec)
+{
+	if (Corrupt || (Cursor >= End))
+		return false;
+
+	// Decode into locals and only commit the delta bases once the whole record is present. A partial record at the
+	// end of the file is the normal result of a process being killed and is not treated as corruption.
+	uint64_t head;
+	if (!GetVarint(head))
+		return false;
+
+	TraceRecord r;
+	r.Type = TraceType(head & 7);
+	r.TimeMs = PrevTimeMs + int64_t(head >> 3);
+	int prevX = PrevX;
+	int prevY = PrevY;
+	int64_t prevPadTimeMs = PrevPadTimeMs;
+
+	uint64_t u[5];
+	int64_t s[2];
+	switch (r.Type)
+	{
+		case TraceType_Sync:
+			if (!GetVarint(u[0]) || !GetSigned(s[0]) || !GetVarint(u[1]) || !GetVarint(u[2]) || !GetVarint(u[3]) || !GetVarint(u[4]))
+				return false;
+			r.TimeMs			= int64_t(u[0]);
+			r.WallTime			= s[0];
+			r.TimeoutMs			= int64_t(u[1]);
+			r.MaxSuspendMs		= int64_t(u[2]);
+			r.WindowMs			= int64_t(u[3]);
+			r.DistanceThreshold	= int(u[4]);
+			prevX = prevY = 0;
+			prevPadTimeMs = 0;
+
+			// Stages a later version added beyond the ones known here are skipped.
+			if (Version >= 2)
+			{
+				uint64_t numStages;
+				if (!GetVarint(numStages))
+					return false;
+				for (uint64_t stage = 0; stage < numStages; stage++)
+				{
+					if (!GetVarint(u[0]) || !GetSigned(s[0]))
+						return false;
+					if (stage < PolicyStage_NumStages)
+					{
+						r.StageEnabled[stage] = (u[0] != 0);
+						r.StageOffsetMs[stage] = s[0];
+					}
+				}
+			}
+			break;
+
+		case TraceType_Key:
+			if (!GetVarint(u[0]))
+				return false;
+			r.Code = int(u[0] >> 1);
+			r.Down = (u[0] & 1) != 0;
+			break;
+
+		case TraceType_MouseButton:
+			if (!GetVarint(u[0]))
+				return false;
+			r.Code = int(u[0]);
+			break;
+
+		case TraceType_MousePos:
+			if (!GetSigned(s[0]) || !GetSigned(s[1]))
+				return false;
+			r.X = prevX = int(prevX + s[0]);
+			r.Y = prevY = int(prevY + s[1]);
+			break;
+
+		case TraceType_MouseRel:
+			if (!GetSigned(s[0]) || !GetSigned(s[1]))
+				return false;
+			r.X = int(s[0]);
+			r.Y = int(s[1]);
+			break;
+
+		case TraceType_PadButton:
+		case TraceType_PadAxis:
+			if (!GetVarint(u[0]) || !GetVarint(u[1]) || !GetVarint(u[2]) || !GetSigned(s[0]) || !GetSigned(s[1]))
+				return false;
+			r.Device	= int(u[0]);
+			r.NativeID	= int(u[1]);
+			r.VC		= int(u[2]);
+			r.Value		= s[0];
+			r.PadTimeMs	= prevPadTimeMs = prevPadTimeMs + s[1];
+			break;
+
+		case TraceType_Command:
+			if (!GetVarint(u[0]) || !GetSigned(s[0]))
+				return false;
+			r.Code = int(u[0]);
+			r.Value = s[0];
+			break;
+	}
+
+	PrevTimeMs = r.TimeMs;
+	PrevX = prevX;
+	PrevY = prevY;
+	PrevPadTimeMs = prevPadTimeMs;
+	rec = r;
+	return true;
+}
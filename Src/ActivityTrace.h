@@ -0,0 +1,201 @@
+// ActivityTrace.h
+//
+// A compact binary trace of everything that reaches the input hooks, for reproducing field reports like "it didn't lock"
+// or "it locked while I was gaming". The recorder appends to a file. The replayer memory-maps a trace and hands back
+// one record at a time so it can be driven through the countdown logic on a virtual clock.
+//
+// The file starts with an 8 byte header, "LDTRACE" followed by the format version. After that it is a stream of
+// records. Every record starts with a varint holding (deltaMs << 3) | type, where deltaMs is the time since the
+// previous record. Payload fields follow as varints, with signed values zigzag encoded and positions delta encoded
+// against the previous position. A key press costs 2 or 3 bytes and a small mouse move 3. Each recording session starts
+// with a sync record holding the absolute time and the configuration, so appending to an existing trace just starts a
+// new session. All times are GetTimeMs times. Version 2 added the policy stages to the sync record. Version 1 traces
+// still read, as lock-only sessions, but a trace is only ever appended to by the version that started it.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include "PolicyScheduler.h"
+
+
+namespace Lockdown
+{
+	// The type lives in the low 3 bits of the first varint of a record so there can be at most 8.
+	enum TraceType
+	{
+		TraceType_Sync,															// Session start. Absolute time and configuration.
+		TraceType_Key,															// Key code and whether it went down or up.
+		TraceType_MouseButton,													// Platform button code (window message or evdev code).
+		TraceType_MousePos,														// Absolute pointer position.
+		TraceType_MouseRel,														// Relative pointer motion.
+		TraceType_PadButton,													// Gamepad input_event fields.
+		TraceType_PadAxis,
+		TraceType_Command														// Something that moved the countdown.
+	};
+
+	enum TraceCommand
+	{
+		TraceCommand_Lock,														// The scheduler locked the session.
+		TraceCommand_Suspend,
+		TraceCommand_Resume,
+		TraceCommand_SetRemaining,												// Value is the remaining time in ms.
+		TraceCommand_LockNow,
+		TraceCommand_Exit,														// Written on close so a replay knows how long the session ran.
+		TraceCommand_Warn,														// The scheduler performed a stage other than the lock.
+		TraceCommand_Blank,
+		TraceCommand_Logout
+	};
+
+	// A decoded record. Only the fields for the record's type are meaningful.
+	struct TraceRecord
+	{
+		TraceType Type							= TraceType_Sync;
+		int64_t TimeMs							= 0;
+
+		// Key, MouseButton, and Command.
+		int Code								= 0;
+		bool Down								= false;
+
+		// MousePos and MouseRel.
+		int X									= 0;
+		int Y									= 0;
+
+		// PadButton and PadAxis. These are the gamepad input_event fields plus the device index.
+		int Device								= 0;
+		int NativeID							= 0;
+		int VC									= 0;
+		int64_t Value							= 0;					// Also the SetRemaining time for commands.
+		int64_t PadTimeMs						= 0;
+
+		// Sync. WallTime is seconds since the unix epoch, for humans reading the trace. Stages are as given to
+		// PolicyScheduler::SetStage. A version 1 sync has only the lock stage.
+		int64_t WallTime						= 0;
+		int64_t TimeoutMs						= 0;
+		int64_t MaxSuspendMs					= 0;
+		int64_t WindowMs						= 0;
+		int DistanceThreshold					= 0;
+		bool StageEnabled[PolicyStage_NumStages]	= { false, false, true, false };
+		int64_t StageOffsetMs[PolicyStage_NumStages]	= { };
+	};
+
+	// The configuration in effect while recording. Written in each sync record so a replay uses the same settings.
+	struct TraceConfig
+	{
+		int64_t TimeoutMs						= 0;
+		int64_t MaxSuspendMs					= 0;
+		int64_t WindowMs						= 0;
+		int DistanceThreshold					= 0;
+		bool StageEnabled[PolicyStage_NumStages]	= { false, false, true, false };
+		int64_t StageOffsetMs[PolicyStage_NumStages]	= { };
+	};
+
+	// Records may come from several threads (the gamepad hook thread and the main thread) so writes are serialized with
+	// a mutex. When not recording every Write call is a single inline test.
+	class ActivityTraceWriter
+	{
+	public:
+		ActivityTraceWriter()																							{ }
+		~ActivityTraceWriter()																							{ Close(); }
+
+		// Opens the file for appending, writing the header if it is new, and starts a session with a sync record. Fails
+		// if the file is a trace of another version.
+		bool Open(const char* path, const TraceConfig&);
+		void Close();
+		bool IsRecording() const																						{ return File != nullptr; }
+
+		// Writes buffered records to the file. Called automatically for commands and when the buffer fills.
+		void Flush();
+
+		void WriteKey(int key, bool down)																				{ if (File) WriteKeyInternal(key, down); }
+		void WriteMouseButton(int code)																					{ if (File) WriteCodeInternal(TraceType_MouseButton, code); }
+		void WriteMousePos(int x, int y)																				{ if (File) WriteMouseInternal(TraceType_MousePos, x, y); }
+		void WriteMouseRel(int dx, int dy)																				{ if (File) WriteMouseInternal(TraceType_MouseRel, dx, dy); }
+		void WritePad(TraceType type, int device, int nativeID, int vc, int32_t value, uint64_t padTimeMs)				{ if (File) WritePadInternal(type, device, nativeID, vc, value, padTimeMs); }
+		void WriteCommand(TraceCommand command, int64_t value = 0)														{ if (File) WriteCommandInternal(command, value); }
+
+	private:
+		void WriteKeyInternal(int key, bool down);
+		void WriteCodeInternal(TraceType, int code);
+		void WriteMouseInternal(TraceType, int x, int y);
+		void WritePadInternal(TraceType, int device, int nativeID, int vc, int32_t value, uint64_t padTimeMs);
+		void WriteCommandInternal(TraceCommand, int64_t value);
+
+		// These must be called with the mutex held.
+		void BeginRecord(TraceType);
+		void PutVarint(uint64_t);
+		void PutSigned(int64_t value)																					{ PutVarint((uint64_t(value) << 1) ^ uint64_t(value >> 63)); }
+		void FlushLocked();
+
+		std::mutex Mutex;
+		FILE* File								= nullptr;
+
+		// Delta bases.
+		int64_t PrevTimeMs						= 0;
+		int PrevX								= 0;
+		int PrevY								= 0;
+		int64_t PrevPadTimeMs					= 0;
+		int64_t LastFlushMs						= 0;
+
+		// Enough for any single record, plus room to batch many.
+		static const int BufferSize				= 64*1024;
+		static const int MaxRecordSize			= 80;
+		uint8_t Buffer[BufferSize];
+		int BufferUsed							= 0;
+	};
+
+	// Memory-maps a trace and decodes records in order. The whole file is mapped read-only so reading is just pointer
+	// arithmetic. A truncated final record (from a process that was killed mid-write) ends the trace cleanly.
+	class ActivityTraceReader
+	{
+	public:
+		ActivityTraceReader()																							{ }
+		~ActivityTraceReader()																							{ Close(); }
+
+		bool Open(const char* path);
+		void Close();
+
+		// Fills in the next record. Returns false at the end of the trace or if the data is corrupt.
+		bool Next(TraceRecord&);
+
+		// Starts reading from the first record again. The first record is always a sync so the delta bases reset there.
+		void Rewind()																									{ Cursor = Begin; Corrupt = false; }
+
+		int64_t GetSize() const																							{ return int64_t(End - Begin); }
+		bool IsCorrupt() const																							{ return Corrupt; }
+
+	private:
+		bool GetVarint(uint64_t&);
+		bool GetSigned(int64_t& value)																					{ uint64_t u; if (!GetVarint(u)) return false; value = int64_t(u >> 1) ^ -int64_t(u & 1); return true; }
+
+		const uint8_t* Mapping					= nullptr;
+		int64_t MappingSize						= 0;
+		const uint8_t* Begin					= nullptr;
+		const uint8_t* End						= nullptr;
+		const uint8_t* Cursor					= nullptr;
+		bool Corrupt							= false;
+		int Version								= 0;
+
+		// Delta bases, mirroring the writer's.
+		int64_t PrevTimeMs						= 0;
+		int PrevX								= 0;
+		int PrevY								= 0;
+		int64_t PrevPadTimeMs					= 0;
+
+		#ifdef PLATFORM_WINDOWS
+		void* FileHandle						= nullptr;
+		void* MapHandle							= nullptr;
+		#endif
+	};
+}
@@ -0,0 +1,209 @@
+// AllocationCounter.cpp
+//
+// Steady-state allocation counting. See AllocationCounter.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "AllocationCounter.h"
+#ifdef LOCKDOWN_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+
+// glibc's own entry points. Defining malloc and friends here interposes them for the whole process, including calls
+// the C library makes for itself such as strdup, and these are what the replacements hand on to.
+#ifdef __GLIBC__
+extern "C"
+{
+	void* __libc_malloc(std::size_t);
+	void* __libc_calloc(std::size_t, std::size_t);
+	void* __libc_realloc(void*, std::size_t);
+	void* __libc_memalign(std::size_t, std::size_t);
+}
+#endif
+
+
+namespace Lockdown
+{
+	// Plain data so it is usable from operator new and malloc before any constructor has run.
+	thread_local bool InSteadyState			= false;
+	std::atomic<uint64_t> NumSteadyStateAllocations(0);
+	std::atomic<bool> AbortOnSteadyStateAllocation(true);
+
+	void CountAllocation(std::size_t size);
+
+	// The allocator underneath operator new, which mustn't count again when malloc is replaced as well.
+	inline void* AllocateUncounted(std::size_t size)
+	{
+		#ifdef __GLIBC__
+		return __libc_malloc(size);
+		#else
+		return std::malloc(size);
+		#endif
+	}
+}
+
+
+Lockdown::SteadyStateScope::SteadyStateScope(bool steady) :
+	Previous(InSteadyState)
+{
+	InSteadyState = steady;
+}
+
+
+Lockdown::SteadyStateScope::~SteadyStateScope()
+{
+	InSteadyState = Previous;
+}
+
+
+bool Lockdown::IsCountingAllocations()
+{
+	return true;
+}
+
+
+uint64_t Lockdown::GetNumSteadyStateAllocations()
+{
+	return NumSteadyStateAllocations.load(std::memory_order_relaxed);
+}
+
+
+void Lockdown::SetAbortOnSteadyStateAllocation(bool abortOnAllocation)
+{
+	AbortOnSteadyStateAllocation.store(abortOnAllocation, std::memory_order_relaxed);
+}
+
+
+void Lockdown::CountAllocation(std::size_t size)
+{
+	if (!InSteadyState)
+		return;
+
+	NumSteadyStateAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (!AbortOnSteadyStateAllocation.load(std::memory_order_relaxed))
+		return;
+
+	// Leaving steady state first lets the report allocate if it has to. stderr is unbuffered so it normally won't.
+	InSteadyState = false;
+	std::fprintf(stderr, "Heap allocation of %zu bytes in steady state.\n", size);
+	std::abort();
+}
+
+
+// The array and nothrow forms call these by default, so replacing the two is enough to see every allocation that
+// doesn't ask for extended alignment.
+void* operator new(std::size_t size)
+{
+	Lockdown::CountAllocation(size);
+	for (;;)
+	{
+		if (void* ptr = Lockdown::AllocateUncounted(size ? size : 1))
+			return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+
+#ifdef __GLIBC__
+// C allocations count too, whether lockdown makes them or a library does on its behalf. free and everything else that
+// only releases memory is left to glibc, which owns the blocks either way.
+extern "C" void* malloc(std::size_t size) noexcept
+{
+	Lockdown::CountAllocation(size);
+	return __libc_malloc(size);
+}
+
+
+extern "C" void* calloc(std::size_t num, std::size_t size) noexcept
+{
+	Lockdown::CountAllocation(num * size);
+	return __libc_calloc(num, size);
+}
+
+
+extern "C" void* realloc(void* ptr, std::size_t size) noexcept
+{
+	// Zero frees the block.
+	if (size)
+		Lockdown::CountAllocation(size);
+	return __libc_realloc(ptr, size);
+}
+
+
+extern "C" void* memalign(std::size_t alignment, std::size_t size) noexcept
+{
+	Lockdown::CountAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+
+extern "C" void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+	Lockdown::CountAllocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+
+extern "C" int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) noexcept
+{
+	if ((alignment % sizeof(void*)) || (alignment & (alignment - 1)))
+		return EINVAL;
+	Lockdown::CountAllocation(size);
+	void* block = __libc_memalign(alignment, size);
+	if (!block)
+		return ENOMEM;
+	*ptr = block;
+	return 0;
+}
+#endif
+
+
+#else
+
+
+bool Lockdown::IsCountingAllocations()
+{
+	return false;
+}
+
+
+uint64_t Lockdown::GetNumSteadyStateAllocations()
+{
+	return 0;
+}
+
+
+void Lockdown::SetAbortOnSteadyStateAllocation(bool)
+{
+}
+
+
+#endif
@@ -0,0 +1,54 @@
+// AllocationCounter.h
+//
+// Checks that lockdown's steady state doesn't touch the heap. Once startup is done the input, timer, and lock paths run
+// on fixed buffers and preallocated state, since anything allocated per event or per tick becomes heap churn in a
+// process that runs for weeks. A thread marks the work it does in steady state with a SteadyStateScope. In a build with
+// LOCKDOWN_COUNT_ALLOCATIONS defined, global operator new is replaced and every allocation made inside a scope is
+// counted, and by default aborts the process so the allocation is found with its call stack. Without the define the
+// scope is empty and compiles away. With glibc the malloc family is replaced too, so C allocations like strdup and
+// those libraries make internally are counted as well. Elsewhere, including Windows, only C++ allocations are seen.
+// Memory the OS maps directly, such as thread stacks, is never counted.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+
+
+namespace Lockdown
+{
+	// Puts the calling thread in steady state, or with false takes it out, until the scope ends. Scopes nest, so work
+	// that is allowed to allocate, such as opening a hotplugged device or reloading the config, lifts it for its own
+	// duration from inside a steady-state loop.
+	class SteadyStateScope
+	{
+	public:
+		#ifdef LOCKDOWN_COUNT_ALLOCATIONS
+		SteadyStateScope(bool steady = true);
+		~SteadyStateScope();
+
+	private:
+		bool Previous;
+		#else
+		SteadyStateScope(bool = true)																					{ }
+		#endif
+	};
+
+	// True if this is a counting build.
+	bool IsCountingAllocations();
+
+	// Allocations made in steady state by any thread since startup. Always zero unless counting.
+	uint64_t GetNumSteadyStateAllocations();
+
+	// Whether a steady-state allocation aborts. On by default. The bench turns it off to report a count instead.
+	void SetAbortOnSteadyStateAllocation(bool);
+}
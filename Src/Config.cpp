@@ -0,0 +1,385 @@
+// Config.cpp
+//
+// Config file parsing, the snapshot store, and the file watcher. See Config.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#elif defined(PLATFORM_LINUX)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include "Config.h"
+
+
+Lockdown::ConfigSnapshot::ConfigSnapshot()
+{
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		StageEnabled[s] = (s == PolicyStage_Lock);
+		StageOffsetMs[s] = 0;
+	}
+}
+
+
+namespace Lockdown
+{
+	// Parses a number that isn't negative. Returns false on anything else, including trailing junk.
+	bool ParseNumber(const std::string& value, double& number);
+	void TrimSpace(std::string&);
+}
+
+
+bool Lockdown::ParseNumber(const std::string& value, double& number)
+{
+	if (value.empty())
+		return false;
+	char* end = nullptr;
+	number = strtod(value.c_str(), &end);
+	return (*end == '\0') && (number >= 0.0) && (number < 1.0e12);
+}
+
+
+void Lockdown::TrimSpace(std::string& str)
+{
+	size_t first = str.find_first_not_of(" \t\r");
+	size_t last = str.find_last_not_of(" \t\r");
+	str = (first == std::string::npos) ? std::string() : str.substr(first, last - first + 1);
+}
+
+
+bool Lockdown::ParseConfig(const std::string& text, ConfigSnapshot& config, std::string& error)
+{
+	double timeoutMinutes = -1.0;
+	double timeoutSeconds = -1.0;
+	bool windowGiven = false;
+	int lineNum = 0;
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		size_t end = text.find('\n', pos);
+		if (end == std::string::npos)
+			end = text.size();
+		std::string line = text.substr(pos, end - pos);
+		pos = end + 1;
+		lineNum++;
+
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+		TrimSpace(line);
+		if (line.empty())
+			continue;
+
+		size_t equals = line.find('=');
+		if (equals == std::string::npos)
+		{
+			error = "line " + std::to_string(lineNum) + ": expected key = value";
+			return false;
+		}
+		std::string key = line.substr(0, equals);
+		std::string value = line.substr(equals + 1);
+		TrimSpace(key);
+		TrimSpace(value);
+
+		if (key == "inputs")
+		{
+			uint32_t sources = 0;
+			for (char& c : value)
+				if (c == ',')
+					c = ' ';
+			size_t namePos = 0;
+			while ((namePos = value.find_first_not_of(' ', namePos)) != std::string::npos)
+			{
+				size_t nameEnd = value.find(' ', namePos);
+				std::string name = value.substr(namePos, nameEnd - namePos);
+				namePos = nameEnd;
+
+				int s = 0;
+				while ((s < ActivitySource_NumSources) && (name != GetSourceName(ActivitySource(s))))
+					s++;
+				if (s == ActivitySource_NumSources)
+				{
+					error = "line " + std::to_string(lineNum) + ": unknown input " + name;
+					return false;
+				}
+				sources |= 1u << s;
+			}
+			config.Sources = sources;
+			continue;
+		}
+
+		double number = 0.0;
+		if (!ParseNumber(value, number))
+		{
+			error = "line " + std::to_string(lineNum) + ": " + key + " needs a number that isn't negative";
+			return false;
+		}
+
+		if (key == "timeout_minutes")
+			timeoutMinutes = number;
+		else if (key == "timeout_seconds")
+			timeoutSeconds = number;
+		else if (key == "max_suspend_minutes")
+			config.MaxSuspendMs = int64_t(number * 60000.0);
+		else if (key == "window_ms")
+		{
+			config.WindowMs = int64_t(number);
+			windowGiven = true;
+		}
+		else if (key == "mouse_threshold")
+			config.DistanceThreshold = int(number);
+		else if (key == "warn_seconds")
+		{
+			config.StageEnabled[PolicyStage_Warn] = (number > 0.0);
+			config.StageOffsetMs[PolicyStage_Warn] = -int64_t(number * 1000.0);
+		}
+		else if (key == "blank_seconds")
+		{
+			config.StageEnabled[PolicyStage_Blank] = (number > 0.0);
+			config.StageOffsetMs[PolicyStage_Blank] = -int64_t(number * 1000.0);
+		}
+		else if (key == "logout_minutes")
+		{
+			config.StageEnabled[PolicyStage_Logout] = (number > 0.0);
+			config.StageOffsetMs[PolicyStage_Logout] = int64_t(number * 60000.0);
+		}
+		else
+		{
+			error = "line " + std::to_string(lineNum) + ": unknown key " + key;
+			return false;
+		}
+	}
+
+	// Either timeout key replaces the whole timeout, the same as on the command line.
+	if ((timeoutMinutes >= 0.0) || (timeoutSeconds >= 0.0))
+	{
+		int64_t timeoutMs = 0;
+		if (timeoutMinutes > 0.0)
+			timeoutMs += int64_t(timeoutMinutes * 60000.0);
+		if (timeoutSeconds > 0.0)
+			timeoutMs += int64_t(timeoutSeconds * 1000.0);
+		if (timeoutMs <= 0)
+		{
+			error = "the timeout must be more than zero";
+			return false;
+		}
+		config.TimeoutMs = timeoutMs;
+	}
+
+	// A window as long as the timeout would swallow the input that should put the lock off. One given in the file is
+	// checked against the timeout it ends up with. One from the command line is cut down to fit a shorter timeout.
+	int64_t maxWindowMs = ActivityCoalescer::GetMaxWindow(config.TimeoutMs);
+	if (config.WindowMs > maxWindowMs)
+	{
+		if (windowGiven)
+		{
+			error = "window_ms can't be more than a tenth of the timeout, " + std::to_string(maxWindowMs) + " ms";
+			return false;
+		}
+		config.WindowMs = maxWindowMs;
+	}
+	return true;
+}
+
+
+Lockdown::ConfigStore::ConfigStore() :
+	Current(new ConfigSnapshot),
+	Epoch(1),
+	NumSlots(0)
+{
+	for (ReaderSlot& slot : Slots)
+		slot.Epoch.store(0, std::memory_order_relaxed);
+}
+
+
+Lockdown::ConfigStore::~ConfigStore()
+{
+	// There must be no readers left by now.
+	delete Current.load();
+	for (RetiredSnapshot& retired : Retired)
+		delete retired.Snapshot;
+}
+
+
+uint64_t Lockdown::ConfigStore::Publish(const ConfigSnapshot& config)
+{
+	// The copy is made and filled in before it is visible. After the swap, readers that start in the new epoch can only
+	// see the new snapshot, so the old one is tagged with that epoch.
+	ConfigSnapshot* snapshot = new ConfigSnapshot(config);
+	snapshot->Generation = ++Generation;
+	const ConfigSnapshot* old = Current.exchange(snapshot);
+	uint64_t epoch = Epoch.fetch_add(1) + 1;
+	Retired.push_back({ old, epoch });
+	Reclaim();
+	return snapshot->Generation;
+}
+
+
+int Lockdown::ConfigStore::Reclaim()
+{
+	if (Retired.empty())
+		return 0;
+
+	// The oldest epoch any reader is in. A snapshot retired in a later epoch than that may still be in use. Unclaimed
+	// slots are zero so there is no need to know how many were claimed.
+	uint64_t oldest = std::numeric_limits<uint64_t>::max();
+	for (int s = 0; s < MaxReaders; s++)
+	{
+		uint64_t epoch = Slots[s].Epoch.load();
+		if (s == SharedSlot)
+		{
+			if (epoch != 0)
+				return int(Retired.size());
+			continue;
+		}
+		if ((epoch != 0) && (epoch < oldest))
+			oldest = epoch;
+	}
+
+	// Retired in epoch order, so everything that can go is at the front.
+	size_t numFreed = 0;
+	while ((numFreed < Retired.size()) && (Retired[numFreed].Epoch <= oldest))
+		delete Retired[numFreed++].Snapshot;
+	Retired.erase(Retired.begin(), Retired.begin() + numFreed);
+	return int(Retired.size());
+}
+
+
+Lockdown::ConfigStore::ReaderSlot& Lockdown::ConfigStore::ClaimSlot() const
+{
+	int index = NumSlots.fetch_add(1, std::memory_order_relaxed);
+	return Slots[(index < SharedSlot) ? index : SharedSlot];
+}
+
+
+bool Lockdown::ConfigWatcher::Start(const char* path)
+{
+	Stop();
+	Path = path;
+	size_t slash = Path.find_last_of("/\\");
+	std::string dir = (slash == std::string::npos) ? std::string(".") : Path.substr(0, slash);
+	Name = (slash == std::string::npos) ? Path : Path.substr(slash + 1);
+	if (dir.empty())
+		dir = "/";
+
+	#if defined(PLATFORM_WINDOWS)
+	HANDLE handle = FindFirstChangeNotificationA
+	(
+		dir.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE
+	);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	WaitHandle = intptr_t(handle);
+
+	// Changes to other files in the directory signal too, so the file's own time and size are compared.
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (GetFileAttributesExA(Path.c_str(), GetFileExInfoStandard, &data))
+	{
+		LastWriteTime = (int64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		LastSize = (int64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	}
+	return true;
+
+	#elif defined(PLATFORM_LINUX)
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close(fd);
+		return false;
+	}
+	WaitHandle = fd;
+	return true;
+
+	#else
+	return false;
+	#endif
+}
+
+
+void Lockdown::ConfigWatcher::Stop()
+{
+	if (WaitHandle == -1)
+		return;
+
+	#if defined(PLATFORM_WINDOWS)
+	FindCloseChangeNotification(HANDLE(WaitHandle));
+	#elif defined(PLATFORM_LINUX)
+	close(int(WaitHandle));
+	#endif
+	WaitHandle = -1;
+}
+
+
+bool Lockdown::ConfigWatcher::Acknowledge()
+{
+	if (WaitHandle == -1)
+		return false;
+
+	#if defined(PLATFORM_WINDOWS)
+	FindNextChangeNotification(HANDLE(WaitHandle));
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(Path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	int64_t writeTime = (int64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	int64_t size = (int64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	if ((writeTime == LastWriteTime) && (size == LastSize))
+		return false;
+	LastWriteTime = writeTime;
+	LastSize = size;
+	return true;
+
+	#elif defined(PLATFORM_LINUX)
+	// Only a finished write or a rename into place counts. A file being created is still empty.
+	alignas(inotify_event) char buf[4096];
+	bool changed = false;
+	ssize_t numRead;
+	while ((numRead = read(int(WaitHandle), buf, sizeof(buf))) > 0)
+	{
+		for (char* ptr = buf; ptr < buf + numRead; )
+		{
+			inotify_event* ev = (inotify_event*)ptr;
+			if (ev->len && (Name == ev->name))
+				changed = true;
+			ptr += sizeof(inotify_event) + ev->len;
+		}
+	}
+	return changed;
+
+	#else
+	return false;
+	#endif
+}
+
+
+bool Lockdown::ConfigWatcher::Read(const char* path, std::string& text)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	text.clear();
+	char buf[4096];
+	size_t numRead;
+	while ((numRead = fread(buf, 1, sizeof(buf), file)) > 0)
+		text.append(buf, numRead);
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
@@ -0,0 +1,198 @@
+// Config.h
+//
+// Settings from a config file that is reloaded while running. The file is parsed into an immutable ConfigSnapshot and
+// published by swapping a single atomic pointer. Readers on any thread, including the input hooks, take no locks. A
+// ConfigReader marks its thread as reading, loads the pointer, and clears the mark when it goes out of scope. A
+// replaced snapshot is retired, and the writer deletes it once every thread that might still be reading it has been
+// seen outside a read. A reload never waits on a reader and a reader never waits on a reload. This file has no
+// dependencies on windows.h or Tacent.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ActivityCoalescer.h"
+#include "PolicyScheduler.h"
+
+
+namespace Lockdown
+{
+	// Everything that can be changed without a restart. The defaults match the command line defaults.
+	struct ConfigSnapshot
+	{
+		ConfigSnapshot();
+
+		int64_t TimeoutMs						= 20*60*1000;
+		int64_t MaxSuspendMs					= 3*60*60*1000;
+		int64_t WindowMs						= 1000;
+		int DistanceThreshold					= 20;
+		uint32_t Sources						= (1u << ActivitySource_NumSources) - 1;	// A bit per ActivitySource.
+		bool StageEnabled[PolicyStage_NumStages];
+		int64_t StageOffsetMs[PolicyStage_NumStages];
+		uint64_t Generation						= 0;										// Set when published.
+
+		bool IsSourceEnabled(ActivitySource source) const																{ return Sources & (1u << source); }
+	};
+
+	// Parses the file contents over the values already in config, so keys that are left out keep them. Lines are
+	// key = value and # starts a comment. Returns false and describes the first problem in error if anything is wrong,
+	// in which case config is left partly updated and should be thrown away. The keys are:
+	//
+	// timeout_minutes, timeout_seconds	Added together like -m and -s.
+	// max_suspend_minutes				Like -x.
+	// window_ms						Like -w. At most a tenth of the timeout.
+	// mouse_threshold					How far the mouse must move to count, in pixels or device units.
+	// inputs							Source names separated by spaces or commas: keyboard mouse_move mouse_button
+	//									pad_button pad_axis.
+	// warn_seconds, blank_seconds		Like -r and -l. Zero turns the stage off.
+	// logout_minutes					Like -o. Zero turns the stage off.
+	bool ParseConfig(const std::string& text, ConfigSnapshot& config, std::string& error);
+
+	class ConfigStore
+	{
+	public:
+		// Starts out with a default snapshot published.
+		ConfigStore();
+		~ConfigStore();
+
+		// Writer interface. Only one thread may publish. The snapshot is copied and given the next generation, which
+		// is returned. Retired snapshots that can no longer be seen are deleted here too.
+		uint64_t Publish(const ConfigSnapshot&);
+
+		// Deletes what it can of the retired snapshots and returns how many are left. Call on the writer thread now
+		// and then, for example each time the deadline timer fires, so the last retired snapshot doesn't linger.
+		int Reclaim();
+		int GetNumRetired() const																						{ return int(Retired.size()); }
+
+	private:
+		friend class ConfigReader;
+
+		// A reader's slot holds the epoch it started reading in, or zero when it isn't reading.
+		struct alignas(64) ReaderSlot
+		{
+			std::atomic<uint64_t> Epoch;
+		};
+
+		// As with the metrics shards, threads beyond the first MaxReaders-1 share the last slot. It counts them instead
+		// and nothing is reclaimed while the count is above zero.
+		static const int MaxReaders = 16;
+		static const int SharedSlot = MaxReaders - 1;
+
+		inline ReaderSlot& GetSlot() const;
+		ReaderSlot& ClaimSlot() const;
+
+		struct RetiredSnapshot
+		{
+			const ConfigSnapshot* Snapshot;
+			uint64_t Epoch;
+		};
+
+		std::atomic<const ConfigSnapshot*> Current;
+		std::atomic<uint64_t> Epoch;
+		mutable ReaderSlot Slots[MaxReaders];
+		mutable std::atomic<int> NumSlots;
+		std::vector<RetiredSnapshot> Retired;
+		uint64_t Generation						= 0;
+	};
+
+	// Holds the current snapshot for as long as it is in scope. Readers may nest.
+	class ConfigReader
+	{
+	public:
+		inline ConfigReader(const ConfigStore&);
+		inline ~ConfigReader();
+
+		const ConfigSnapshot* operator->() const																		{ return Snapshot; }
+		const ConfigSnapshot& operator*() const																			{ return *Snapshot; }
+
+	private:
+		ConfigStore::ReaderSlot& Slot;
+		bool Shared;
+		bool Outer;
+		const ConfigSnapshot* Snapshot;
+	};
+
+	// Watches a config file for changes. Editors often save by writing a new file and renaming it over the old one, so
+	// the directory is watched rather than the file. The wait handle is an inotify descriptor on Linux, to go in the
+	// main loop's epoll set, and a change notification handle on Windows, for MsgWaitForMultipleObjects.
+	class ConfigWatcher
+	{
+	public:
+		~ConfigWatcher()																								{ Stop(); }
+
+		bool Start(const char* path);
+		void Stop();
+		intptr_t GetWaitHandle() const																					{ return WaitHandle; }
+		const std::string& GetPath() const																				{ return Path; }
+
+		// Call when the wait handle is signalled. Returns true if the file may have changed.
+		bool Acknowledge();
+
+		// Reads the whole file. Doesn't need Start.
+		static bool Read(const char* path, std::string& text);
+
+	private:
+		std::string Path;
+		std::string Name;																			// Without the directory.
+		intptr_t WaitHandle						= -1;
+		int64_t LastWriteTime					= 0;
+		int64_t LastSize						= -1;
+	};
+}
+
+
+// Implementation below this line.
+
+
+inline Lockdown::ConfigStore::ReaderSlot& Lockdown::ConfigStore::GetSlot() const
+{
+	thread_local const ConfigStore* owner = nullptr;
+	thread_local ReaderSlot* slot = nullptr;
+	if (owner != this)
+	{
+		slot = &ClaimSlot();
+		owner = this;
+	}
+	return *slot;
+}
+
+
+inline Lockdown::ConfigReader::ConfigReader(const ConfigStore& store) :
+	Slot(store.GetSlot()),
+	Shared(&Slot == &store.Slots[ConfigStore::SharedSlot]),
+	Outer(false)
+{
+	// The slot is written before the pointer is read, and both are sequentially consistent, so a writer that sees the
+	// slot clear knows any read still to come will get the new snapshot.
+	if (Shared)
+	{
+		Slot.Epoch.fetch_add(1);
+	}
+	else if (Slot.Epoch.load(std::memory_order_relaxed) == 0)
+	{
+		Slot.Epoch.store(store.Epoch.load());
+		Outer = true;
+	}
+	Snapshot = store.Current.load();
+}
+
+
+inline Lockdown::ConfigReader::~ConfigReader()
+{
+	if (Shared)
+		Slot.Epoch.fetch_sub(1, std::memory_order_release);
+	else if (Outer)
+		Slot.Epoch.store(0, std::memory_order_release);
+}
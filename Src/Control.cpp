@@ -0,0 +1,388 @@
+// Control.cpp
+//
+// Local control channel. See Control.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifdef PLATFORM_LINUX
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Control.h"
+
+
+namespace Lockdown
+{
+	// Fills in an abstract address from a name beginning with @. Returns the address length, or zero if the name is
+	// invalid.
+	socklen_t MakeAbstractAddress(const char* name, sockaddr_un&);
+
+	// Anyone on the machine can bind or reach an abstract name, so at both ends only messages whose kernel supplied
+	// credentials are the owner's or root's are believed. The socket needs SO_PASSCRED for them to be attached.
+	bool IsFromOwner(msghdr&);
+
+	// Receives one datagram on a client socket. Fails with EPERM if it came from anyone but the owner or root, which
+	// means another user is holding the name.
+	ssize_t ReceiveFromOwner(int fd, char* buf, size_t size);
+
+	inline bool IsSpace(char c)																						{ return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'); }
+}
+
+
+const char* Lockdown::GetControlCommandName(ControlCommand command)
+{
+	static const char* names[ControlCommand_NumCommands] =
+	{
+		"status", "lock", "suspend", "resume", "remaining", "timeout", "watch"
+	};
+	return ((command >= 0) && (command < ControlCommand_NumCommands)) ? names[command] : "unknown";
+}
+
+
+bool Lockdown::ParseControlRequest(const char* text, int length, ControlRequest& request)
+{
+	// Copied so the value can be parsed with strtod, which needs a terminator.
+	char buf[MaxControlMessage];
+	if ((length <= 0) || (length >= MaxControlMessage))
+		return false;
+	memcpy(buf, text, length);
+	buf[length] = 0;
+
+	char* word = buf;
+	while (IsSpace(*word))
+		word++;
+	char* wordEnd = word;
+	while (*wordEnd && !IsSpace(*wordEnd))
+		wordEnd++;
+	int wordLen = int(wordEnd - word);
+
+	int command = 0;
+	for (; command < ControlCommand_NumCommands; command++)
+	{
+		const char* name = GetControlCommandName(ControlCommand(command));
+		if ((int(strlen(name)) == wordLen) && (strncmp(name, word, wordLen) == 0))
+			break;
+	}
+	if (command == ControlCommand_NumCommands)
+		return false;
+
+	request.Command = ControlCommand(command);
+	request.ValueMs = 0;
+	bool takesValue = (request.Command == ControlCommand_Remaining) || (request.Command == ControlCommand_Timeout);
+	char* end = wordEnd;
+	if (takesValue)
+	{
+		double seconds = strtod(wordEnd, &end);
+		if ((end == wordEnd) || !(seconds >= 0.0) || (seconds > 1.0e9))
+			return false;
+		request.ValueMs = int64_t(seconds * 1000.0);
+		if ((request.Command == ControlCommand_Timeout) && (request.ValueMs <= 0))
+			return false;
+	}
+
+	while (IsSpace(*end))
+		end++;
+	return *end == 0;
+}
+
+
+std::string Lockdown::GetControlName()
+{
+	char name[96];
+	const char* session = std::getenv("XDG_SESSION_ID");
+	if (session && *session && (strlen(session) < 32))
+		snprintf(name, sizeof(name), "@lockdown-%u-%s", unsigned(getuid()), session);
+	else
+		snprintf(name, sizeof(name), "@lockdown-%u", unsigned(getuid()));
+	return name;
+}
+
+
+socklen_t Lockdown::MakeAbstractAddress(const char* name, sockaddr_un& addr)
+{
+	// The leading @ becomes the nul that puts the name in the abstract namespace. The rest is not nul terminated.
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	size_t nameLen = name ? strlen(name) : 0;
+	if ((nameLen < 2) || (name[0] != '@') || (nameLen > sizeof(addr.sun_path)))
+		return 0;
+	memcpy(addr.sun_path + 1, name + 1, nameLen - 1);
+	return socklen_t(offsetof(sockaddr_un, sun_path) + nameLen);
+}
+
+
+bool Lockdown::IsFromOwner(msghdr& msg)
+{
+	const ucred* cred = nullptr;
+	for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_CREDENTIALS))
+			cred = (const ucred*)CMSG_DATA(cmsg);
+	}
+	return cred && ((cred->uid == getuid()) || (cred->uid == 0));
+}
+
+
+ssize_t Lockdown::ReceiveFromOwner(int fd, char* buf, size_t size)
+{
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(ucred))];
+	iovec iov = { buf, size };
+	msghdr msg = { };
+	msg.msg_iov			= &iov;
+	msg.msg_iovlen		= 1;
+	msg.msg_control		= control;
+	msg.msg_controllen	= sizeof(control);
+
+	ssize_t numRead = recvmsg(fd, &msg, 0);
+	if ((numRead >= 0) && !IsFromOwner(msg))
+	{
+		errno = EPERM;
+		return -1;
+	}
+	return numRead;
+}
+
+
+Lockdown::ControlServer::StartResult Lockdown::ControlServer::Start(const char* name)
+{
+	Stop();
+	sockaddr_un addr;
+	socklen_t addrLen = MakeAbstractAddress(name, addr);
+	if (!addrLen)
+		return StartResult_Failed;
+
+	FD = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (FD < 0)
+		return StartResult_Failed;
+
+	// Every request arrives with the sender's credentials, filled in by the kernel.
+	int on = 1;
+	setsockopt(FD, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+	if (bind(FD, (const sockaddr*)&addr, addrLen) == 0)
+		return StartResult_Started;
+
+	bool inUse = (errno == EADDRINUSE);
+	Stop();
+	if (!inUse)
+		return StartResult_Failed;
+
+	// The name being taken only means lockdown is running if the holder answers as the owner. Anyone can bind any
+	// abstract name, and one that stays quiet or answers as another user mustn't stop the session being locked.
+	std::string reply;
+	const char* request = GetControlCommandName(ControlCommand_Status);
+	return SendControlRequest(name, request, reply) ? StartResult_AlreadyRunning : StartResult_Taken;
+}
+
+
+void Lockdown::ControlServer::Stop()
+{
+	if (FD >= 0)
+		close(FD);
+	FD = -1;
+}
+
+
+bool Lockdown::ControlServer::Receive(ControlRequest& request)
+{
+	while (FD >= 0)
+	{
+		char buf[MaxControlMessage];
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(ucred))];
+		iovec iov = { buf, sizeof(buf) };
+		msghdr msg = { };
+		msg.msg_name		= &Sender;
+		msg.msg_namelen		= sizeof(Sender);
+		msg.msg_iov			= &iov;
+		msg.msg_iovlen		= 1;
+		msg.msg_control		= control;
+		msg.msg_controllen	= sizeof(control);
+
+		ssize_t numRead = recvmsg(FD, &msg, MSG_DONTWAIT);
+		if (numRead < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			SenderLen = 0;
+			return false;
+		}
+		SenderLen = msg.msg_namelen;
+		if (!IsFromOwner(msg))
+		{
+			NumRejected++;
+			continue;
+		}
+
+		if ((msg.msg_flags & MSG_TRUNC) || !ParseControlRequest(buf, int(numRead), request))
+		{
+			Reply("error unknown request\n");
+			continue;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+void Lockdown::ControlServer::Reply(const char* text)
+{
+	// A sender without an address can't be answered. It still gets what it asked for. A client that has gone away or
+	// isn't reading is not waited on.
+	if ((FD < 0) || (SenderLen <= socklen_t(sizeof(sa_family_t))))
+		return;
+	sendto(FD, text, strlen(text), MSG_DONTWAIT | MSG_NOSIGNAL, (const sockaddr*)&Sender, SenderLen);
+}
+
+
+bool Lockdown::ControlServer::Watch()
+{
+	// A watcher is answered at the address it sent from, so one without an address can't watch.
+	if ((FD < 0) || (SenderLen <= socklen_t(sizeof(sa_family_t))))
+		return false;
+
+	for (int w = 0; w < NumWatchers; w++)
+	{
+		Watcher& watcher = Watchers[w];
+		if ((watcher.AddrLen == SenderLen) && (memcmp(&watcher.Addr, &Sender, SenderLen) == 0))
+			return true;
+	}
+	if (NumWatchers >= MaxControlWatchers)
+		return false;
+
+	Watchers[NumWatchers].Addr = Sender;
+	Watchers[NumWatchers].AddrLen = SenderLen;
+	NumWatchers++;
+	return true;
+}
+
+
+void Lockdown::ControlServer::Notify(const char* text)
+{
+	// A refused send means nothing is bound at the address any more. A watcher that is only slow to read misses this
+	// text and is kept.
+	size_t length = strlen(text);
+	for (int w = 0; w < NumWatchers; )
+	{
+		Watcher& watcher = Watchers[w];
+		ssize_t numSent = sendto
+		(
+			FD, text, length, MSG_DONTWAIT | MSG_NOSIGNAL, (const sockaddr*)&watcher.Addr, watcher.AddrLen
+		);
+		if ((numSent < 0) && ((errno == ECONNREFUSED) || (errno == ENOENT)))
+			watcher = Watchers[--NumWatchers];
+		else
+			w++;
+	}
+}
+
+
+bool Lockdown::SendControlRequest(const char* name, const char* request, std::string& reply, int timeoutMs)
+{
+	sockaddr_un addr;
+	socklen_t addrLen = MakeAbstractAddress(name, addr);
+	if (!addrLen)
+		return false;
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	// Binding just the family autobinds a unique abstract address for the reply to come back to. Connecting means
+	// only the server's datagrams are received, and the server's credentials come with them.
+	sockaddr_un self;
+	memset(&self, 0, sizeof(self));
+	self.sun_family = AF_UNIX;
+	int on = 1;
+	bool ok =
+		(setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) == 0) &&
+		(bind(fd, (const sockaddr*)&self, sizeof(sa_family_t)) == 0) &&
+		(connect(fd, (const sockaddr*)&addr, addrLen) == 0) &&
+		(send(fd, request, strlen(request), MSG_NOSIGNAL) == ssize_t(strlen(request)));
+
+	pollfd pfd = { fd, POLLIN, 0 };
+	ok = ok && (poll(&pfd, 1, timeoutMs) == 1);
+
+	char buf[MaxControlMessage];
+	ssize_t numRead = ok ? ReceiveFromOwner(fd, buf, sizeof(buf)) : -1;
+	close(fd);
+	if (numRead < 0)
+		return false;
+
+	reply.assign(buf, size_t(numRead));
+	return true;
+}
+
+
+bool Lockdown::WatchControl(const char* name, bool (*handler)(const char* text), int timeoutMs, int renewMs)
+{
+	sockaddr_un addr;
+	socklen_t addrLen = MakeAbstractAddress(name, addr);
+	if (!addrLen)
+		return false;
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	// The same autobound and connected socket as a single request, kept open so the server can keep sending to it.
+	sockaddr_un self;
+	memset(&self, 0, sizeof(self));
+	self.sun_family = AF_UNIX;
+	int on = 1;
+	bool ok =
+		(setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) == 0) &&
+		(bind(fd, (const sockaddr*)&self, sizeof(sa_family_t)) == 0) &&
+		(connect(fd, (const sockaddr*)&addr, addrLen) == 0);
+
+	const char* request = GetControlCommandName(ControlCommand_Watch);
+	ok = ok && (send(fd, request, strlen(request), MSG_NOSIGNAL) == ssize_t(strlen(request)));
+
+	// A datagram socket hears nothing when the server goes away, so quiet is only trusted until the next renewal, and
+	// a renewal that goes unanswered ends the watch.
+	bool awaiting = true;
+	while (ok)
+	{
+		pollfd pfd = { fd, POLLIN, 0 };
+		int numReady = poll(&pfd, 1, awaiting ? timeoutMs : renewMs);
+		if ((numReady < 0) && (errno == EINTR))
+			continue;
+		if (numReady == 0)
+		{
+			ok = !awaiting && (send(fd, request, strlen(request), MSG_NOSIGNAL) == ssize_t(strlen(request)));
+			awaiting = true;
+			continue;
+		}
+		if (numReady < 0)
+			break;
+
+		char buf[MaxControlMessage];
+		ssize_t numRead = ReceiveFromOwner(fd, buf, sizeof(buf) - 1);
+		ok = (numRead >= 0);
+		if (!ok)
+			break;
+		buf[numRead] = 0;
+		awaiting = false;
+		if (!handler(buf))
+		{
+			close(fd);
+			return true;
+		}
+	}
+
+	close(fd);
+	return false;
+}
+
+#endif
@@ -0,0 +1,131 @@
+// Control.h
+//
+// Local control channel for the Linux front end. A running lockdown binds a datagram socket in the abstract namespace
+// under a name made from the user and the login session. Since an abstract name can only be bound once and goes away
+// with the process, the socket is also the single-instance guard, with nothing left behind to clean up after a crash.
+// Any user can bind any abstract name though, so a name already taken only counts as lockdown running if the holder
+// answers a status request with the owner's credentials. Clients check the credentials on replies the same way.
+// Each request is one datagram holding a command line such as "lock" or "remaining 30", and the reply is one datagram
+// back to the sender. There is no connection to accept, so a request costs a send and a receive on each side and is
+// handled on the engine thread from the same epoll set as everything else. The kernel attaches the sender's
+// credentials, and requests from any user other than the owner or root are dropped. A client that sends "watch" is
+// remembered and sent the status text, and sent it again each time it changes, which is how a status bar shows the
+// countdown without polling. A watcher that has gone away is forgotten the next time a send to it is refused.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#ifdef PLATFORM_LINUX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstdint>
+#include <string>
+
+
+namespace Lockdown
+{
+	// The same commands as the tray menu, plus status, a timeout change, and watching the status.
+	enum ControlCommand
+	{
+		ControlCommand_Status,
+		ControlCommand_Lock,														// Lock now.
+		ControlCommand_Suspend,														// For the max suspend time.
+		ControlCommand_Resume,
+		ControlCommand_Remaining,													// Lock in Value ms.
+		ControlCommand_Timeout,														// Set the timeout to Value ms.
+		ControlCommand_Watch,														// Send the status as it changes.
+		ControlCommand_NumCommands
+	};
+	const char* GetControlCommandName(ControlCommand);
+
+	struct ControlRequest
+	{
+		ControlCommand Command					= ControlCommand_Status;
+		int64_t ValueMs							= 0;
+	};
+
+	// Requests are the command name, followed by seconds for remaining and timeout, for example "remaining 10".
+	// Fractional seconds are allowed. Returns false if the text isn't a valid request.
+	bool ParseControlRequest(const char* text, int length, ControlRequest&);
+
+	// The name for this user and login session, beginning with @ for the abstract namespace. The session comes from
+	// XDG_SESSION_ID and is left out if that isn't set.
+	std::string GetControlName();
+
+	// Largest request or reply. Replies are a single line.
+	const int MaxControlMessage					= 512;
+
+	// Most clients watching at once. A status bar or two is the expected number.
+	const int MaxControlWatchers				= 8;
+
+	class ControlServer
+	{
+	public:
+		~ControlServer()																								{ Stop(); }
+
+		enum StartResult
+		{
+			StartResult_Started,
+			StartResult_AlreadyRunning,													// The owner answered.
+			StartResult_Taken,															// Held by something else.
+			StartResult_Failed
+		};
+
+		// The name must begin with @. The socket is non-blocking and meant to go in an epoll set.
+		StartResult Start(const char* name);
+		void Stop();
+		int GetFD() const																								{ return FD; }
+
+		// Call until it returns false when the socket is readable. Each call receives one request and must be followed
+		// by a Reply before the next. Requests that don't parse or come from another user are answered or dropped here
+		// and never returned.
+		bool Receive(ControlRequest&);
+		void Reply(const char* text);
+
+		// Adds the sender of the request just received to the watchers. Watching again is not an error and adds
+		// nothing. Returns false if there are already MaxControlWatchers.
+		bool Watch();
+		int GetNumWatchers() const																						{ return NumWatchers; }
+
+		// Sends the text to every watcher, forgetting those that have gone away.
+		void Notify(const char* text);
+
+		// Requests dropped because they came from another user.
+		uint64_t GetNumRejected() const																					{ return NumRejected; }
+
+	private:
+		int FD									= -1;
+		sockaddr_un Sender;
+		socklen_t SenderLen						= 0;
+		uint64_t NumRejected					= 0;
+
+		struct Watcher
+		{
+			sockaddr_un Addr;
+			socklen_t AddrLen;
+		};
+		Watcher Watchers[MaxControlWatchers];
+		int NumWatchers							= 0;
+	};
+
+	// Client side. Sends one request to the named server and waits up to timeoutMs for the reply. Returns false if
+	// nothing is running under the name, no reply came, or the reply came from a user other than the owner or root.
+	bool SendControlRequest(const char* name, const char* request, std::string& reply, int timeoutMs = 1000);
+
+	// Client side. Watches the named server, calling the handler with each reply it sends until the handler returns
+	// false. The first is the answer to the watch request. The watch is renewed every renewMs, which is how a server
+	// that has gone away is noticed, and each renewal is answered with the current text again. Returns false once the
+	// server doesn't answer within timeoutMs or answers as another user, and true if the handler stopped it.
+	bool WatchControl(const char* name, bool (*handler)(const char* text), int timeoutMs = 1000, int renewMs = 60000);
+}
+
+#endif
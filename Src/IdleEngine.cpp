@@ -0,0 +1,154 @@
+// IdleEngine.cpp
+//
+// Platform-neutral idle tracking. Remaining times are derived on demand from the last published activity timestamp.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#elif defined(PLATFORM_LINUX)
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#else
+#include <chrono>
+#endif
+#include <limits>
+#include "IdleEngine.h"
+
+
+int64_t Lockdown::GetTimeMs()
+{
+	#if defined(PLATFORM_WINDOWS)
+	// Based on interrupt time, which includes time spent asleep. Resolution is the system tick (10 to 16ms).
+	return int64_t(GetTickCount64());
+
+	#elif defined(PLATFORM_LINUX)
+	// Unlike CLOCK_MONOTONIC, CLOCK_BOOTTIME includes time spent suspended. This is also the clock the deadline
+	// timerfd uses so absolute deadlines can be handed straight to the kernel.
+	timespec ts;
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return int64_t(ts.tv_sec)*1000 + int64_t(ts.tv_nsec)/1000000;
+
+	#else
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+	#endif
+}
+
+
+int64_t Lockdown::GetTimeUs()
+{
+	#if defined(PLATFORM_WINDOWS)
+	// The same tick as GetTimeMs. Finer interrupt time needs Windows 10 and mincore.lib, and the deadlines being
+	// measured against are only as fine as the tick anyway.
+	return int64_t(GetTickCount64()) * 1000;
+
+	#elif defined(PLATFORM_LINUX)
+	timespec ts;
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return int64_t(ts.tv_sec)*1000000 + int64_t(ts.tv_nsec)/1000;
+
+	#else
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	#endif
+}
+
+
+int64_t Lockdown::GetProcessAgeUs()
+{
+	#if defined(PLATFORM_WINDOWS)
+	FILETIME creation, exit, kernel, user, now;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return -1;
+	GetSystemTimePreciseAsFileTime(&now);
+	uint64_t creation100ns = (uint64_t(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+	uint64_t now100ns = (uint64_t(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+	return int64_t(now100ns - creation100ns) / 10;
+
+	#elif defined(PLATFORM_LINUX)
+	// The start time is field 22 of the stat line, in ticks since boot. The command name before it may contain spaces
+	// so fields are counted from the closing parenthesis, which is followed by field 3.
+	char line[1024];
+	FILE* file = fopen("/proc/self/stat", "r");
+	if (!file)
+		return -1;
+	size_t numRead = fread(line, 1, sizeof(line) - 1, file);
+	fclose(file);
+	line[numRead] = '\0';
+
+	const char* field = strrchr(line, ')');
+	for (int f = 2; field && (f < 22); f++)
+		field = strchr(field + 1, ' ');
+	if (!field)
+		return -1;
+
+	long long startTicks = 0;
+	if (sscanf(field + 1, "%lld", &startTicks) != 1)
+		return -1;
+	timespec ts;
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	int64_t nowUs = int64_t(ts.tv_sec)*1000000 + int64_t(ts.tv_nsec)/1000;
+	return nowUs - int64_t(startTicks)*1000000 / int64_t(sysconf(_SC_CLK_TCK));
+
+	#else
+	return -1;
+	#endif
+}
+
+
+Lockdown::IdleEngine::IdleEngine(int64_t timeoutMs, int64_t maxSuspendMs) :
+	TimeoutMs(timeoutMs),
+	MaxSuspendMs(maxSuspendMs),
+	LastActivityMs(GetTimeMs()),
+	SuspendUntilMs(std::numeric_limits<int64_t>::min())
+{
+}
+
+
+int64_t Lockdown::IdleEngine::GetLockDeadline() const
+{
+	// A suspend that has ended counts as activity at the moment it ended.
+	int64_t lastActivity = LastActivityMs.load(std::memory_order_relaxed);
+	int64_t suspendUntil = SuspendUntilMs.load(std::memory_order_relaxed);
+	int64_t countdownStart = (suspendUntil > lastActivity) ? suspendUntil : lastActivity;
+	return countdownStart + TimeoutMs;
+}
+
+
+int64_t Lockdown::IdleEngine::GetRemaining(int64_t nowMs) const
+{
+	return GetLockDeadline() - nowMs;
+}
+
+
+int64_t Lockdown::IdleEngine::GetSuspendRemaining(int64_t nowMs) const
+{
+	int64_t suspendUntil = SuspendUntilMs.load(std::memory_order_relaxed);
+	return (suspendUntil > nowMs) ? suspendUntil - nowMs : 0;
+}
+
+
+void Lockdown::IdleEngine::Resume(int64_t nowMs)
+{
+	if (!IsEnabled(nowMs))
+		SuspendUntilMs.store(nowMs, std::memory_order_relaxed);
+}
+
+
+void Lockdown::IdleEngine::SetRemaining(int64_t nowMs, int64_t remainingMs)
+{
+	SuspendUntilMs.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+	LastActivityMs.store(nowMs + remainingMs - TimeoutMs, std::memory_order_relaxed);
+}
@@ -0,0 +1,94 @@
+// IdleEngine.h
+//
+// Platform-neutral idle tracking. Input producers (the low-level hooks, the gamepad thread, etc) only ever publish the
+// time of their most recent activity, and they do it with a single atomic store. The engine works out the time
+// remaining before a lock, and the time remaining on a suspend, on demand from that timestamp. There are no locks and
+// no read-modify-writes on the producer side, so any number of input threads may report activity concurrently. This
+// file has no dependencies on windows.h or Tacent so it may be built and benchmarked on any platform.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+
+namespace Lockdown
+{
+	// Returns a monotonic timestamp in milliseconds. The epoch is unspecified so only differences are meaningful. The
+	// clock keeps counting while the system is asleep (CLOCK_BOOTTIME on Linux, the interrupt-time based tick count on
+	// Windows) so a deadline computed before a sleep is still correct after it.
+	int64_t GetTimeMs();
+
+	// The same clock in microseconds, for measuring latencies. A deadline in milliseconds times 1000 is comparable.
+	int64_t GetTimeUs();
+
+	// Returns microseconds since the process was created, or -1 if that can't be found. Used to measure how long
+	// startup takes to arm the first deadline. Linux only records the start time to the scheduler tick.
+	int64_t GetProcessAgeUs();
+
+	class IdleEngine
+	{
+	public:
+		IdleEngine(int64_t timeoutMs = 20*60*1000, int64_t maxSuspendMs = 3*60*60*1000);
+
+		// Configuration. These are only expected to be called by the engine thread.
+		void SetTimeout(int64_t timeoutMs)																				{ TimeoutMs = timeoutMs; }
+		int64_t GetTimeout() const																						{ return TimeoutMs; }
+		void SetMaxSuspend(int64_t maxSuspendMs)																		{ MaxSuspendMs = maxSuspendMs; }
+		int64_t GetMaxSuspend() const																					{ return MaxSuspendMs; }
+
+		// Producer interface. Safe to call from any thread. Concurrent producers may race to publish slightly
+		// different times. Whichever store lands last wins, which is at most the width of the race out and is of no
+		// consequence for a timeout measured in seconds.
+		void ReportActivity()																							{ ReportActivity(GetTimeMs()); }
+		void ReportActivity(int64_t timeMs)																				{ LastActivityMs.store(timeMs, std::memory_order_relaxed); }
+		int64_t GetLastActivity() const																					{ return LastActivityMs.load(std::memory_order_relaxed); }
+
+		// Engine interface. The remaining times are computed from the timestamps. The end of a suspend is treated the
+		// same as activity so the full timeout is always available after resuming.
+		bool IsEnabled(int64_t nowMs) const																				{ return nowMs >= SuspendUntilMs.load(std::memory_order_relaxed); }
+
+		// Returns the number of milliseconds before the machine should lock. Zero or negative means a lock is due. The
+		// value is meaningless while suspended.
+		int64_t GetRemaining(int64_t nowMs) const;
+
+		// Returns the number of milliseconds before a suspend expires. Zero if not suspended.
+		int64_t GetSuspendRemaining(int64_t nowMs) const;
+
+		// Absolute deadlines in GetTimeMs time. The lock deadline only ever moves later as a result of activity, so a
+		// timer armed for it never needs reprogramming when input arrives. It just fires early and gets re-armed.
+		int64_t GetLockDeadline() const;
+		int64_t GetSuspendDeadline() const																				{ return SuspendUntilMs.load(std::memory_order_relaxed); }
+
+		// Returns the earlier of the suspend-expiry deadline (if suspended) and the lock deadline (if not).
+		int64_t GetNextDeadline(int64_t nowMs) const																	{ return IsEnabled(nowMs) ? GetLockDeadline() : GetSuspendDeadline(); }
+
+		// Suspends auto-locking for the max suspend time. Resume ends a suspend early.
+		void Suspend(int64_t nowMs)																						{ SuspendUntilMs.store(nowMs + MaxSuspendMs, std::memory_order_relaxed); }
+		void Resume(int64_t nowMs);
+
+		// Forces the lock to occur in remainingMs (if no activity happens first). Cancels any suspend.
+		void SetRemaining(int64_t nowMs, int64_t remainingMs);
+
+		// Call after locking to start a fresh countdown.
+		void Restart(int64_t nowMs)																						{ ReportActivity(nowMs); }
+
+	private:
+		int64_t TimeoutMs;
+		int64_t MaxSuspendMs;
+
+		// The only state shared with producers. Each is an independent 64-bit value so there is never a torn read.
+		std::atomic<int64_t> LastActivityMs;
+		std::atomic<int64_t> SuspendUntilMs;
+	};
+}
@@ -0,0 +1,470 @@
+// InputEvdev.cpp
+//
+// Linux keyboard and mouse activity backend using evdev, epoll, and kernel-side event masks.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifdef PLATFORM_LINUX
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include "InputEvdev.h"
+
+
+namespace Lockdown
+{
+	constexpr int NumLongBits = int(sizeof(unsigned long) * 8);
+	inline bool TestBit(const unsigned long* bits, int bit)															{ return (bits[bit / NumLongBits] >> (bit % NumLongBits)) & 1; }
+	inline void SetBit(unsigned long* bits, int bit)																{ bits[bit / NumLongBits] |= 1ul << (bit % NumLongBits); }
+	constexpr int NumLongs(int numBits)																				{ return (numBits + NumLongBits - 1) / NumLongBits; }
+
+	// Keyboard keys are everything below BTN_MISC plus the extended range starting at KEY_OK. The block in between is
+	// mouse, joystick, gamepad, and digitizer buttons.
+	inline bool IsKeyboardKey(int code)																				{ return (code < BTN_MISC) || (code >= KEY_OK); }
+	inline bool IsMouseButton(int code)																				{ return ((code >= BTN_MOUSE) && (code <= BTN_TASK)) || (code == BTN_TOUCH); }
+	inline bool IsWheel(int code)
+	{
+		#ifdef REL_WHEEL_HI_RES
+		if ((code == REL_WHEEL_HI_RES) || (code == REL_HWHEEL_HI_RES))
+			return true;
+		#endif
+		return (code == REL_WHEEL) || (code == REL_HWHEEL);
+	}
+
+	// A mask setter that tolerates kernels without EVIOCSMASK (pre 4.4). In that case we still filter in user space.
+	bool SetEventMask(int fd, unsigned int type, const unsigned long* bits, unsigned int numBits)
+	{
+		input_mask mask;
+		mask.type = type;
+		mask.codes_size = NumLongs(numBits) * sizeof(unsigned long);
+		mask.codes_ptr = uint64_t(uintptr_t(bits));
+		return ioctl(fd, EVIOCSMASK, &mask) == 0;
+	}
+}
+
+
+Lockdown::EvdevInput::EvdevInput(ActivityCoalescer& coalescer, uint32_t flags, int distanceThreshold) :
+	Coalescer(coalescer),
+	Flags(flags),
+	DistanceThreshold(distanceThreshold)
+{
+}
+
+
+Lockdown::EvdevInput::~EvdevInput()
+{
+	Close();
+}
+
+
+bool Lockdown::EvdevInput::Open(const char* dir)
+{
+	Close();
+	Dir = dir;
+	EpollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (EpollFD < 0)
+		return false;
+
+	// Watch for new nodes. udev creates the node and then fixes up its permissions, so IN_ATTRIB is needed as well as
+	// IN_CREATE to catch the moment we are allowed to open it.
+	WatchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (WatchFD >= 0)
+	{
+		if (inotify_add_watch(WatchFD, dir, IN_CREATE | IN_ATTRIB) >= 0)
+		{
+			epoll_event ev = { };
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr;
+			epoll_ctl(EpollFD, EPOLL_CTL_ADD, WatchFD, &ev);
+		}
+		else
+		{
+			close(WatchFD);
+			WatchFD = -1;
+		}
+	}
+
+	ScanDir();
+	return true;
+}
+
+
+void Lockdown::EvdevInput::Configure(uint32_t flags, int distanceThreshold)
+{
+	DistanceThreshold = distanceThreshold;
+	if (flags == Flags)
+		return;
+
+	Flags = flags;
+	if (EpollFD < 0)
+		return;
+	while (NumDevices > 0)
+		CloseDevice(Devices[NumDevices - 1]);
+	ScanDir();
+}
+
+
+void Lockdown::EvdevInput::ScanDir()
+{
+	DIR* d = opendir(Dir.c_str());
+	if (!d)
+		return;
+
+	while (dirent* entry = readdir(d))
+	{
+		if (strncmp(entry->d_name, "event", 5) == 0)
+			OpenDevice(entry->d_name);
+	}
+	closedir(d);
+}
+
+
+void Lockdown::EvdevInput::Close()
+{
+	while (NumDevices > 0)
+		CloseDevice(Devices[NumDevices - 1]);
+
+	if (WatchFD >= 0)
+		close(WatchFD);
+	WatchFD = -1;
+
+	if (EpollFD >= 0)
+		close(EpollFD);
+	EpollFD = -1;
+}
+
+
+bool Lockdown::EvdevInput::OpenDevice(const char* name)
+{
+	if ((NumDevices == MaxDevices) || (strlen(name) >= sizeof(Device::Name)))
+		return false;
+	for (int d = 0; d < NumDevices; d++)
+		if (strcmp(Devices[d]->Name, name) == 0)
+			return false;
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", Dir.c_str(), name);
+	int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	unsigned long typeBits[NumLongs(EV_CNT)]	= { };
+	unsigned long keyBits[NumLongs(KEY_CNT)]	= { };
+	unsigned long relBits[NumLongs(REL_CNT)]	= { };
+	unsigned long absBits[NumLongs(ABS_CNT)]	= { };
+	ioctl(fd, EVIOCGBIT(0, sizeof(typeBits)), typeBits);
+	if (TestBit(typeBits, EV_KEY))
+		ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits);
+	if (TestBit(typeBits, EV_REL))
+		ioctl(fd, EVIOCGBIT(EV_REL, sizeof(relBits)), relBits);
+	if (TestBit(typeBits, EV_ABS))
+		ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits);
+
+	// Gamepads and joysticks belong to the gamepad hook. Anything with an alphanumeric block is a keyboard. Devices
+	// with just a power or volume key are not.
+	bool isGamepad		= TestBit(keyBits, BTN_GAMEPAD) || TestBit(keyBits, BTN_JOYSTICK);
+	bool isKeyboard		= TestBit(keyBits, KEY_A) || TestBit(keyBits, KEY_SPACE) || TestBit(keyBits, KEY_KPENTER);
+	bool hasButtons		= TestBit(keyBits, BTN_LEFT) || TestBit(keyBits, BTN_TOUCH);
+	bool hasRelMotion	= TestBit(relBits, REL_X) && TestBit(relBits, REL_Y);
+	bool hasWheel		= TestBit(relBits, REL_WHEEL) || TestBit(relBits, REL_HWHEEL);
+	bool hasAbsMotion	= TestBit(absBits, ABS_X) && TestBit(absBits, ABS_Y) && TestBit(keyBits, BTN_TOUCH);
+
+	bool wantKeys		= !isGamepad && isKeyboard && (Flags & EvdevFlag_Keyboard);
+	bool wantButtons	= !isGamepad && hasButtons && (Flags & EvdevFlag_MouseButton);
+	bool wantRel		= !isGamepad && ((hasRelMotion && (Flags & EvdevFlag_MouseMovement)) || (hasWheel && (Flags & EvdevFlag_MouseButton)));
+	bool wantAbs		= !isGamepad && hasAbsMotion && (Flags & EvdevFlag_MouseMovement);
+	if (!wantKeys && !wantButtons && !wantRel && !wantAbs)
+	{
+		close(fd);
+		return false;
+	}
+
+	ApplyMasks(fd, wantKeys, wantButtons, wantRel, wantAbs);
+
+	// There is always a free slot since fewer than MaxDevices are open.
+	Device* dev = Pool;
+	while (dev->FD >= 0)
+		dev++;
+
+	epoll_event ev = { };
+	ev.events = EPOLLIN;
+	ev.data.ptr = dev;
+	if (epoll_ctl(EpollFD, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	*dev = Device();
+	dev->FD = fd;
+	strcpy(dev->Name, name);
+	Devices[NumDevices++] = dev;
+	return true;
+}
+
+
+bool Lockdown::EvdevInput::ApplyMasks(int fd, bool wantKeys, bool wantButtons, bool wantRel, bool wantAbs)
+{
+	// The type mask goes in slot 0. EV_SYN is never filtered by the kernel but SYN_REPORTs that would close an empty
+	// frame are dropped, so a frame containing only masked events does not wake us at all. Notably EV_MSC is left out,
+	// which removes the MSC_SCAN that precedes every key press, and mouse motion is left out when only buttons matter.
+	unsigned long typeMask[NumLongs(EV_CNT)] = { };
+	if (wantKeys || wantButtons || wantAbs)
+		SetBit(typeMask, EV_KEY);
+	if (wantRel)
+		SetBit(typeMask, EV_REL);
+	if (wantAbs)
+		SetBit(typeMask, EV_ABS);
+	if (!SetEventMask(fd, 0, typeMask, EV_CNT))
+		return false;
+
+	unsigned long keyMask[NumLongs(KEY_CNT)] = { };
+	for (int code = 0; code < KEY_CNT; code++)
+	{
+		if ((wantKeys && IsKeyboardKey(code)) || (wantButtons && IsMouseButton(code)))
+			SetBit(keyMask, code);
+	}
+
+	// Touch up/down is needed to re-anchor absolute motion when a finger is lifted.
+	if (wantAbs)
+		SetBit(keyMask, BTN_TOUCH);
+	SetEventMask(fd, EV_KEY, keyMask, KEY_CNT);
+
+	unsigned long relMask[NumLongs(REL_CNT)] = { };
+	for (int code = 0; code < REL_CNT; code++)
+	{
+		bool motion = (code == REL_X) || (code == REL_Y);
+		if ((motion && (Flags & EvdevFlag_MouseMovement)) || (IsWheel(code) && (Flags & EvdevFlag_MouseButton)))
+			SetBit(relMask, code);
+	}
+	SetEventMask(fd, EV_REL, relMask, REL_CNT);
+
+	// Only the single-touch position. The multitouch slots duplicate it several times over.
+	unsigned long absMask[NumLongs(ABS_CNT)] = { };
+	SetBit(absMask, ABS_X);
+	SetBit(absMask, ABS_Y);
+	SetEventMask(fd, EV_ABS, absMask, ABS_CNT);
+	return true;
+}
+
+
+void Lockdown::EvdevInput::CloseDevice(Device* dev)
+{
+	for (int d = 0; d < NumDevices; d++)
+	{
+		if (Devices[d] != dev)
+			continue;
+
+		Devices[d] = Devices[--NumDevices];
+		break;
+	}
+
+	// Closing the descriptor removes it from the epoll set. The slot is free again once the descriptor is -1.
+	if (dev->FD >= 0)
+		close(dev->FD);
+	dev->FD = -1;
+}
+
+
+void Lockdown::EvdevInput::Process()
+{
+	if (EpollFD < 0)
+		return;
+
+	epoll_event events[32];
+	int numEvents = epoll_wait(EpollFD, events, 32, 0);
+	if (numEvents > 0)
+		NumWakeups++;
+
+	for (int e = 0; e < numEvents; e++)
+	{
+		// A device closed earlier in this batch may still have an event in it.
+		Device* dev = (Device*)events[e].data.ptr;
+		if (!dev)
+			ProcessWatch();
+		else if (dev->FD >= 0)
+			ProcessDevice(dev);
+	}
+}
+
+
+void Lockdown::EvdevInput::ProcessDevice(Device* dev)
+{
+	bool buttonActive = false;
+	bool moveActive = false;
+	int64_t nowMs = GetTimeMs();
+	input_event buf[64];
+	while (true)
+	{
+		ssize_t numRead = read(dev->FD, buf, sizeof(buf));
+		if (numRead < 0)
+		{
+			// ENODEV means the device was unplugged. Anything else other than EAGAIN is unexpected and also fatal for
+			// the device.
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN)
+			{
+				CloseDevice(dev);
+				return;
+			}
+			break;
+		}
+
+		int num = int(numRead / sizeof(input_event));
+		for (int i = 0; i < num; i++)
+		{
+			const input_event& ev = buf[i];
+
+			// The same filtering the event masks do, for kernels that do not support them. Anything that passes is traced
+			// before it is filtered further.
+			switch (ev.type)
+			{
+				case EV_KEY:
+					if (IsKeyboardKey(ev.code))
+					{
+						// Value 1 is a press, 2 an auto-repeat, and 0 a release. The coalescer suppresses the repeats.
+						if (Flags & EvdevFlag_Keyboard)
+						{
+							if (Trace)
+								Trace->WriteKey(ev.code, ev.value != 0);
+							Coalescer.ReportKey(ev.code, ev.value != 0, nowMs);
+						}
+					}
+					else if (IsMouseButton(ev.code))
+					{
+						if (Flags & EvdevFlag_MouseButton)
+						{
+							if (Trace)
+								Trace->WriteMouseButton(ev.code);
+							buttonActive = true;
+						}
+						if ((ev.code == BTN_TOUCH) && (ev.value == 0))
+							dev->AnchorValid = false;
+					}
+					break;
+
+				case EV_REL:
+					if (IsWheel(ev.code))
+					{
+						if (Flags & EvdevFlag_MouseButton)
+						{
+							if (Trace)
+								Trace->WriteMouseButton(ev.code);
+							buttonActive = true;
+						}
+					}
+					else if (Flags & EvdevFlag_MouseMovement)
+					{
+						if (Trace)
+							Trace->WriteMouseRel((ev.code == REL_X) ? ev.value : 0, (ev.code == REL_Y) ? ev.value : 0);
+						if (UpdateMotion(dev, ev.type, ev.code, ev.value))
+							moveActive = true;
+					}
+					break;
+
+				case EV_ABS:
+					if (Flags & EvdevFlag_MouseMovement)
+					{
+						if (Trace)
+							Trace->WriteMousePos((ev.code == ABS_X) ? ev.value : dev->AbsX, (ev.code == ABS_Y) ? ev.value : dev->AbsY);
+						if (UpdateMotion(dev, ev.type, ev.code, ev.value))
+							moveActive = true;
+					}
+					break;
+			}
+		}
+	}
+
+	// Buttons and motion are reported once per read batch. Keys are reported individually for repeat tracking.
+	if (buttonActive)
+		Coalescer.Report(ActivitySource_MouseButton, nowMs);
+	if (moveActive)
+		Coalescer.Report(ActivitySource_MouseMove, nowMs);
+}
+
+
+bool Lockdown::EvdevInput::UpdateMotion(Device* dev, int type, int code, int value)
+{
+	int dx = 0;
+	int dy = 0;
+	if (type == EV_REL)
+	{
+		if (code == REL_X)
+			dev->AccumX += value;
+		else if (code == REL_Y)
+			dev->AccumY += value;
+		else
+			return false;
+
+		dx = dev->AccumX;
+		dy = dev->AccumY;
+	}
+	else
+	{
+		if (code == ABS_X)
+			dev->AbsX = value;
+		else if (code == ABS_Y)
+			dev->AbsY = value;
+		else
+			return false;
+
+		if (!dev->AnchorValid)
+		{
+			dev->AnchorX = dev->AbsX;
+			dev->AnchorY = dev->AbsY;
+			dev->AnchorValid = true;
+			return false;
+		}
+		dx = dev->AbsX - dev->AnchorX;
+		dy = dev->AbsY - dev->AnchorY;
+	}
+
+	// Same test as the Windows mouse hook, without the square root.
+	if ((int64_t(dx)*dx + int64_t(dy)*dy) <= int64_t(DistanceThreshold)*DistanceThreshold)
+		return false;
+
+	dev->AccumX = dev->AccumY = 0;
+	dev->AnchorX = dev->AbsX;
+	dev->AnchorY = dev->AbsY;
+	return true;
+}
+
+
+void Lockdown::EvdevInput::ProcessWatch()
+{
+	alignas(inotify_event) char buf[4096];
+	while (true)
+	{
+		ssize_t numRead = read(WatchFD, buf, sizeof(buf));
+		if (numRead <= 0)
+			break;
+
+		for (char* ptr = buf; ptr < buf + numRead; )
+		{
+			inotify_event* ev = (inotify_event*)ptr;
+			if (ev->len && (strncmp(ev->name, "event", 5) == 0))
+				OpenDevice(ev->name);
+			ptr += sizeof(inotify_event) + ev->len;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,121 @@
+// InputEvdev.h
+//
+// Linux keyboard and mouse activity backend. This is the Linux equivalent of the WH_KEYBOARD_LL and WH_MOUSE_LL hooks
+// on Windows. It opens the /dev/input/event* nodes of keyboards and mice and waits on them with a single epoll set.
+// Each device gets an EVIOCSMASK event mask so the kernel only queues the event types and codes the selected inputs
+// care about. Frames that end up empty (a mouse move when only buttons are monitored, or the EV_MSC scan codes that
+// accompany every key) are dropped by the kernel without waking us. Devices that show up later are picked up by an
+// inotify watch on the input directory. The calling user must be able to read the event nodes (usually by being in the
+// 'input' group). For local testing, uinput virtual devices are treated exactly like real ones.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#ifdef PLATFORM_LINUX
+#include <cstdint>
+#include <string>
+#include "ActivityCoalescer.h"
+#include "ActivityTrace.h"
+
+
+namespace Lockdown
+{
+	// Which inputs count as activity. These correspond to the -k, -v, and -b command line options.
+	enum EvdevFlag : uint32_t
+	{
+		EvdevFlag_Keyboard				= 1 << 0,
+		EvdevFlag_MouseMovement			= 1 << 1,
+		EvdevFlag_MouseButton			= 1 << 2
+	};
+
+	class EvdevInput
+	{
+	public:
+		// The distance threshold is in device units (pixels before acceleration for a mouse). Activity is reported to
+		// the coalescer, which must only be fed keyboard and mouse events from the thread calling Process.
+		EvdevInput(ActivityCoalescer&, uint32_t flags, int distanceThreshold);
+		~EvdevInput();
+
+		// Opens every suitable device in dir and starts watching dir for new ones. Returns false if the epoll set could
+		// not be created. Having no devices is not an error since they may be plugged in later.
+		bool Open(const char* dir = "/dev/input");
+		void Close();
+
+		// Changes which inputs count and the distance threshold. Call from the thread calling Process. If the inputs
+		// changed, every device is closed and the directory scanned again so the event masks match.
+		void Configure(uint32_t flags, int distanceThreshold);
+
+		// An epoll descriptor that polls readable whenever Process has work to do. Add it to the main loop's epoll set.
+		int GetFD() const																								{ return EpollFD; }
+
+		// Reads everything pending on all ready devices without blocking and reports activity to the coalescer.
+		void Process();
+
+		// Every key, button, and motion event read is also written to the trace if one is set, before any filtering.
+		void SetTrace(ActivityTraceWriter* trace)																		{ Trace = trace; }
+
+		int GetNumDevices() const																						{ return NumDevices; }
+
+		// Number of times Process found something to read. With event masks in place this is roughly the number of
+		// input frames that carried something we were interested in.
+		int64_t GetNumWakeups() const																					{ return NumWakeups; }
+
+		// Devices come from a fixed pool so plugging and unplugging them never allocates. Past this many the rest are
+		// ignored. Only devices with keys or motion of interest are kept, so it is far more than any machine has.
+		static const int MaxDevices			= 64;
+
+	private:
+		struct Device
+		{
+			int FD							= -1;								// -1 while the pool slot is free.
+			char Name[32]					= { };								// The node name, such as event3.
+
+			// Relative motion accumulated since the last time motion counted as activity.
+			int AccumX						= 0;
+			int AccumY						= 0;
+
+			// Absolute position (touchpads, tablets) at the last time motion counted as activity.
+			bool AnchorValid				= false;
+			int AbsX						= 0;
+			int AbsY						= 0;
+			int AnchorX						= 0;
+			int AnchorY						= 0;
+		};
+
+		// Returns true if the device was opened and added. Devices with nothing of interest are closed again. The name
+		// is the node's name in the directory.
+		bool OpenDevice(const char* name);
+		void CloseDevice(Device*);
+		void ScanDir();
+		bool ApplyMasks(int fd, bool wantKeys, bool wantButtons, bool wantRel, bool wantAbs);
+		void ProcessDevice(Device*);
+		void ProcessWatch();
+
+		// Returns true if the motion has moved far enough from the anchor to count as activity.
+		bool UpdateMotion(Device*, int type, int code, int value);
+
+		ActivityCoalescer& Coalescer;
+		ActivityTraceWriter* Trace			= nullptr;
+		uint32_t Flags;
+		int DistanceThreshold;
+		std::string Dir;
+
+		int EpollFD							= -1;
+		int WatchFD							= -1;
+		Device Pool[MaxDevices];
+		Device* Devices[MaxDevices];												// The open ones, in no order.
+		int NumDevices						= 0;
+		int64_t NumWakeups					= 0;
+	};
+}
+
+#endif
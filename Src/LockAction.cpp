@@ -0,0 +1,187 @@
+// LockAction.cpp
+//
+// Asynchronous lock backends. See LockAction.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#elif defined(PLATFORM_LINUX)
+#include <sys/wait.h>
+#include <spawn.h>
+#endif
+#include <cstdio>
+#include "LockAction.h"
+#include "IdleEngine.h"
+
+
+#if defined(PLATFORM_LINUX)
+extern char** environ;
+#endif
+
+
+const char* Lockdown::GetLockBackendName(LockBackend backend)
+{
+	static const char* names[LockBackend_NumBackends] = { "session", "command", "simulated" };
+	return ((backend >= 0) && (backend < LockBackend_NumBackends)) ? names[backend] : "unknown";
+}
+
+
+int64_t Lockdown::SpawnChild(const char* const* argv)
+{
+	#if defined(PLATFORM_LINUX)
+	pid_t pid = 0;
+	if (posix_spawnp(&pid, argv[0], nullptr, nullptr, (char* const*)argv, environ) != 0)
+		return -1;
+	return int64_t(pid);
+	#else
+	return -1;
+	#endif
+}
+
+
+bool Lockdown::ReapChild(int64_t& child, bool& success)
+{
+	#if defined(PLATFORM_LINUX)
+	if (child < 0)
+		return false;
+
+	int status = 0;
+	pid_t pid = waitpid(pid_t(child), &status, WNOHANG);
+	if (pid == 0)
+		return false;
+	success = (pid > 0) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+	child = -1;
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+
+void Lockdown::LockAction::SetBackend(LockBackend backend, const char* command)
+{
+	Backend = backend;
+	Command = command ? command : "";
+}
+
+
+Lockdown::LockResult Lockdown::LockAction::Issue(int64_t dueUs)
+{
+	if (Pending)
+	{
+		// Asking again is harmless for LockWorkStation and covers a lock that was dismissed before it took.
+		#if defined(PLATFORM_WINDOWS)
+		if (Backend == LockBackend_Session)
+			LockWorkStation();
+		#endif
+		return LockResult_None;
+	}
+
+	int64_t nowUs = GetTimeUs();
+	IssuedUs = nowUs;
+	IssueLatencyUs = (nowUs > dueUs) ? (nowUs - dueUs) : 0;
+	ConfirmLatencyUs = -1;
+	Pending = true;
+
+	#if defined(PLATFORM_WINDOWS)
+	switch (Backend)
+	{
+		case LockBackend_Session:
+			return LockWorkStation() ? LockResult_None : Complete(false);
+
+		case LockBackend_Simulated:
+			return Complete(true);
+
+		default:
+			return Complete(false);
+	}
+
+	#elif defined(PLATFORM_LINUX)
+	// Spawned rather than run with system() so the engine thread carries on while the locker does its work. The
+	// simulated backend runs true, which costs the same process start as a real locker and does nothing.
+	const char* sessionArgv[]	= { "loginctl", "lock-session", nullptr };
+	const char* commandArgv[]	= { "/bin/sh", "-c", Command.c_str(), nullptr };
+	const char* simulatedArgv[]	= { "true", nullptr };
+	const char** argv = sessionArgv;
+	if (Backend == LockBackend_Command)
+		argv = commandArgv;
+	else if (Backend == LockBackend_Simulated)
+		argv = simulatedArgv;
+
+	Child = SpawnChild(argv);
+	return (Child >= 0) ? LockResult_None : Complete(false);
+
+	#else
+	return Complete(Backend == LockBackend_Simulated);
+	#endif
+}
+
+
+Lockdown::LockResult Lockdown::LockAction::Update()
+{
+	bool success = false;
+	if (!Pending || !ReapChild(Child, success))
+		return LockResult_None;
+	if (!success || WatchingHint || (Backend != LockBackend_Session))
+		return Complete(success);
+
+	// loginctl only passed the request on. The session is locked once its screen locker says so, which is polled
+	// from a shell so the engine thread still only hears about it on SIGCHLD. XDG_SESSION_ID is the session
+	// lock-session locked, and auto is logind's choice of the caller's session when it isn't set.
+	char script[320];
+	snprintf
+	(
+		script, sizeof(script),
+		"i=0; while [ $i -lt %d ]; do "
+		"[ \"$(loginctl show-session \"${XDG_SESSION_ID:-auto}\" -p LockedHint --value)\" = yes ] && exit 0; "
+		"sleep 0.05; i=$((i+1)); done; exit 1",
+		int(LockConfirmTimeoutMs / 50)
+	);
+	const char* watchArgv[] = { "/bin/sh", "-c", script, nullptr };
+	Child = SpawnChild(watchArgv);
+	WatchingHint = (Child >= 0);
+	return WatchingHint ? LockResult_None : Complete(false);
+}
+
+
+Lockdown::LockResult Lockdown::LockAction::Confirm()
+{
+	// A locker process is confirmed by its exit, which also reaps it.
+	if (!Pending || (Child >= 0))
+		return LockResult_None;
+	return Complete(true);
+}
+
+
+Lockdown::LockResult Lockdown::LockAction::Expire()
+{
+	if (!Pending || (Child >= 0))
+		return LockResult_None;
+	return Complete(false);
+}
+
+
+Lockdown::LockResult Lockdown::LockAction::Complete(bool success)
+{
+	Pending = false;
+	Child = -1;
+	WatchingHint = false;
+	if (!success)
+	{
+		NumFailures++;
+		return LockResult_Failed;
+	}
+
+	ConfirmLatencyUs = GetTimeUs() - IssuedUs;
+	return LockResult_Confirmed;
+}
@@ -0,0 +1,106 @@
+// LockAction.h
+//
+// Locks the session without blocking the engine thread, and measures how long it took. A lock is issued and then
+// completes later. The issue latency is from when the lock became due to when it was issued, which covers timer drift
+// and anything the engine thread was busy with. The confirm latency is from issuing to the platform reporting the lock
+// done. On Windows LockWorkStation only starts the lock, which is confirmed by the WTS_SESSION_LOCK session change. On
+// Linux the locker runs as a child process, logind's through loginctl or a command of the user's choosing. loginctl
+// lock-session only asks the session's screen locker to lock, so it is followed by a second child that watches the
+// session's LockedHint, which the screen locker sets once the screen is actually locked, and the lock is confirmed
+// when that goes to yes. A command of the user's own is confirmed by exiting successfully since that is all there is
+// to go on. Children are reaped from SIGCHLD so nothing ever waits on them. A lock not confirmed within
+// LockConfirmTimeoutMs has failed. The simulated backend locks nothing and is for testing the path and measuring its
+// overhead. This file has no dependencies on windows.h or Tacent.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+
+namespace Lockdown
+{
+	enum LockBackend
+	{
+		LockBackend_Session,														// LockWorkStation, or logind via loginctl.
+		LockBackend_Command,														// A locker command run by the shell. Linux only.
+		LockBackend_Simulated,														// Locks nothing.
+		LockBackend_NumBackends
+	};
+	const char* GetLockBackendName(LockBackend);
+
+	// Linux. Starts a program as a child process and returns its process id without waiting for it, or -1 if it
+	// couldn't be started. The program is looked up on the path. ReapChild returns false while the child is running.
+	// Once it has exited, child is set to -1 and true is returned with success set if it exited with status zero. Call
+	// it for every child still running on SIGCHLD. Other commands the app runs, like blanking, go through these too so
+	// nothing ever waits on a process.
+	int64_t SpawnChild(const char* const* argv);
+	bool ReapChild(int64_t& child, bool& success);
+
+	// How long a lock has to be confirmed before it counts as failed.
+	const int64_t LockConfirmTimeoutMs			= 10000;
+
+	enum LockResult
+	{
+		LockResult_None,															// Nothing has completed.
+		LockResult_Confirmed,
+		LockResult_Failed
+	};
+
+	class LockAction
+	{
+	public:
+		// The command is only used by LockBackend_Command.
+		LockAction(LockBackend backend = LockBackend_Session, const char* command = nullptr)							{ SetBackend(backend, command); }
+
+		void SetBackend(LockBackend, const char* command = nullptr);
+		LockBackend GetBackend() const																					{ return Backend; }
+
+		// Starts a lock and returns without waiting for it. dueUs is when the lock became due, in GetTimeUs time. Returns
+		// LockResult_None if the lock is pending, LockResult_Failed if it couldn't be started, and LockResult_Confirmed
+		// if the backend finished it straight away. A lock issued while one is pending is folded into it and keeps the
+		// first one's times.
+		LockResult Issue(int64_t dueUs);
+		bool IsPending() const																							{ return Pending; }
+
+		// Call on SIGCHLD on Linux. Reaps the locker or the LockedHint watch if it has exited and returns how it went.
+		LockResult Update();
+
+		// Call when the platform reports the session locked, WTS_SESSION_LOCK on Windows. A session locked by other
+		// means while nothing is pending is not ours to measure and is ignored.
+		LockResult Confirm();
+
+		// Call on Windows once LockConfirmTimeoutMs has passed since a lock was issued. A lock still pending has
+		// failed, so one the session never reports doesn't stay pending for good. The Linux LockedHint watch times
+		// itself out.
+		LockResult Expire();
+
+		// For the most recent lock. The confirm latency is -1 until it is confirmed.
+		int64_t GetIssueLatencyUs() const																				{ return IssueLatencyUs; }
+		int64_t GetConfirmLatencyUs() const																				{ return ConfirmLatencyUs; }
+		int64_t GetNumFailures() const																					{ return NumFailures; }
+
+	private:
+		LockResult Complete(bool success);
+
+		LockBackend Backend						= LockBackend_Session;
+		std::string Command;
+		bool Pending							= false;
+		int64_t Child							= -1;									// The Linux locker's process id.
+		bool WatchingHint						= false;								// Child is watching LockedHint.
+		int64_t IssuedUs						= 0;
+		int64_t IssueLatencyUs					= -1;
+		int64_t ConfirmLatencyUs				= -1;
+		int64_t NumFailures						= 0;
+	};
+}
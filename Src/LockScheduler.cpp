@@ -0,0 +1,77 @@
+// LockScheduler.cpp
+//
+// Deadline-driven lock scheduling.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#ifdef PLATFORM_LINUX
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+#include "LockScheduler.h"
+
+
+Lockdown::LockScheduler::Action Lockdown::LockScheduler::Update(int64_t nowMs, int64_t& nextDeadlineMs)
+{
+	NumUpdates++;
+	Action action = Action::None;
+
+	// While suspended the only deadline of interest is the suspend expiry. Once it passes the engine treats the expiry
+	// as activity so the lock deadline is a full timeout after it.
+	if (Engine.IsEnabled(nowMs) && (Engine.GetLockDeadline() <= nowMs))
+	{
+		Engine.Restart(nowMs);
+		action = Action::Lock;
+	}
+
+	nextDeadlineMs = Engine.GetNextDeadline(nowMs);
+	return action;
+}
+
+
+#ifdef PLATFORM_LINUX
+Lockdown::DeadlineTimer::DeadlineTimer()
+{
+	FD = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+
+Lockdown::DeadlineTimer::~DeadlineTimer()
+{
+	if (FD >= 0)
+		close(FD);
+}
+
+
+bool Lockdown::DeadlineTimer::Arm(int64_t deadlineMs)
+{
+	if (FD < 0)
+		return false;
+
+	// An all-zero it_value would disarm the timer. Clamp so a deadline at or before the epoch still fires.
+	if (deadlineMs < 1)
+		deadlineMs = 1;
+
+	itimerspec spec = { };
+	spec.it_value.tv_sec = time_t(deadlineMs / 1000);
+	spec.it_value.tv_nsec = long(deadlineMs % 1000) * 1000000;
+	return timerfd_settime(FD, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+
+bool Lockdown::DeadlineTimer::Acknowledge()
+{
+	uint64_t expirations = 0;
+	ssize_t numRead = read(FD, &expirations, sizeof(expirations));
+	return (numRead == sizeof(expirations)) && (expirations > 0);
+}
+#endif
@@ -0,0 +1,78 @@
+// LockScheduler.h
+//
+// Deadline-driven lock scheduling. Rather than waking every second to decrement a countdown, the scheduler computes
+// the absolute lock deadline and suspend-expiry deadline from the idle engine and the platform sleeps until the earlier
+// of the two. Activity never touches the timer. When the timer fires early because activity moved the deadline later,
+// the scheduler simply hands back the new deadline to re-arm for. With no activity there is exactly one wakeup per
+// timeout period.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include "IdleEngine.h"
+
+
+namespace Lockdown
+{
+	class LockScheduler
+	{
+	public:
+		LockScheduler(IdleEngine& engine)																				: Engine(engine) { }
+
+		enum class Action
+		{
+			None,						// Woke early (activity moved the deadline) or a suspend expired. Just re-arm.
+			Lock						// The lock deadline has passed with no activity. Lock the workstation.
+		};
+
+		// Call whenever the platform timer fires, or after anything that may have moved a deadline earlier (menu
+		// commands, resuming from sleep, a configuration change). Returns what to do now and fills in the absolute
+		// deadline (GetTimeMs time) the timer should next be armed for. If the action is Lock, the engine countdown has
+		// already been restarted.
+		Action Update(int64_t nowMs, int64_t& nextDeadlineMs);
+
+		// Converts an absolute deadline into a relative delay suitable for a relative platform timer. Never negative.
+		static int64_t GetDelay(int64_t nowMs, int64_t deadlineMs)														{ return (deadlineMs > nowMs) ? deadlineMs - nowMs : 0; }
+
+		// Number of times Update has been called. Useful for measuring wakeups.
+		int64_t GetNumUpdates() const																					{ return NumUpdates; }
+
+	private:
+		IdleEngine& Engine;
+		int64_t NumUpdates = 0;
+	};
+
+	#ifdef PLATFORM_LINUX
+	// A one-shot timerfd on CLOCK_BOOTTIME armed with absolute deadlines. Because the clock includes suspended time and
+	// the deadline is absolute, the timer neither drifts nor accumulates error across a system sleep. The file
+	// descriptor may be added to an epoll set.
+	class DeadlineTimer
+	{
+	public:
+		DeadlineTimer();
+		~DeadlineTimer();
+
+		bool IsValid() const																							{ return FD >= 0; }
+		int GetFD() const																								{ return FD; }
+
+		// Arms (or re-arms) the timer for an absolute GetTimeMs deadline. A deadline in the past fires immediately.
+		bool Arm(int64_t deadlineMs);
+
+		// Reads the expiry count so the descriptor stops polling readable. Returns true if the timer had expired.
+		bool Acknowledge();
+
+	private:
+		int FD = -1;
+	};
+	#endif
+}
@@ -18,15 +18,28 @@
 #include <windows.h>
 #include <System/tPrint.h>
 #include <System/tCmdLine.h>
-#include <Math/tVector2.h>
 #include <tchar.h>
-#include <commctrl.h>
+#include <dbt.h>
+#include <wtsapi32.h>
+#include <vector>
 #include "resource.h"
 #include <libgamepad.hpp>
 #include "Version.cmake.h"
+#include "IdleEngine.h"
+#include "LockScheduler.h"
+#include "PolicyScheduler.h"
+#include "Config.h"
+#include "LockAction.h"
+#include "ActivityCoalescer.h"
+#include "ActivityTrace.h"
+#include "ActivityRing.h"
+#include "Metrics.h"
+#include "MouseFilter.h"
+#include "AllocationCounter.h"
+#include "StatusText.h"
 #pragma warning(disable: 4996)
-using namespace tMath;
 #define	WM_USER_TRAYICON (WM_USER+1)
+#define	WM_USER_PADACTIVITY (WM_USER+2)
 
 
 // Command-line options.
@@ -40,46 +53,241 @@ tCmdLine::tOption OptionMouseMovement		("Detect any mouse movement.",		"movement
 tCmdLine::tOption OptionMouseButton			("Detect any mouse button presses.","button",	'b'			);
 tCmdLine::tOption OptionPadButtons			("Detect any gamepad button input.","pad",		'p'			);
 tCmdLine::tOption OptionAxis				("Detect any gamepad axis changes.","axis",		'a'			);
+tCmdLine::tOption OptionWindow				("Coalescing window in ms.",		"window",	'w',	1	);
+tCmdLine::tOption OptionTrace				("Record input to a trace file.",	"trace",	't',	1	);
+tCmdLine::tOption OptionMetrics				("Serve metrics on a unix socket.",	"metrics",	'e',	1	);
+tCmdLine::tOption OptionWarn				("Warn seconds before locking.",	"warn",		'r',	1	);
+tCmdLine::tOption OptionBlank				("Blank display seconds before lock.","blank",	'l',	1	);
+tCmdLine::tOption OptionLogout				("Log out minutes after locking.",	"logout",	'o',	1	);
+tCmdLine::tOption OptionConfig				("Config file. Reloaded on change.","config",	'c',	1	);
+tCmdLine::tOption OptionDeadzones			("Keep learned pad deadzones here.","deadzone",	'g',	1	);
 
 
 namespace Lockdown
 {
 	HINSTANCE hInst;
+	HWND hMainWindow						= NULL;					// Where the gamepad hook thread posts to wake the engine.
+	HMENU hTrayMenu							= NULL;					// Loaded once. Clicking the icon only shows it.
 	NOTIFYICONDATA NotifyIconData;
+	StatusText Status;												// What the tooltip was last set to.
 	HHOOK hKeyboardHook						= NULL;
 	HHOOK hMouseHook						= NULL;
 	BOOL NotifyIconAdded					= 0;
 
-	bool Enabled							= true;
-	int SecondsToLock						= 20 * 60;				// 20 minutes unless overridden by command line.
-	int MaxSuspendSeconds					= 3 * 60 * 60;			// 3 hour max suspend time unless overridden by command line.
-	int CountdownSeconds					= SecondsToLock;
-	int CountdownSuspendSeconds				= MaxSuspendSeconds;
-	int MouseX								= 0;					// This may be negative for multiple monitors.
-	int MouseY								= 0;					// This may be negative for multiple monitors.
-	const int MouseDistanceThreshold		= 20;					// How far mouse must move to count as activity.
+	IdleEngine Engine;												// 20 minute timeout and 3 hour max suspend unless overridden by command line.
+	PolicyScheduler Scheduler(Engine);								// Only locks unless stages are given on the command line.
+	ActivityCoalescer Coalescer(Engine);							// All hooks report activity through the coalescer.
+	const UINT_PTR DeadlineTimerID			= 42;
+	const UINT_PTR LockConfirmTimerID		= 43;					// Fails a lock the session never reports.
+	MouseFilter MouseMoveFilter(20);								// Positions may be negative for multiple monitors.
+	ActivityTraceWriter Trace;										// Records everything reaching the hooks if -t is given.
+	ConfigSnapshot BaseConfig;										// From the command line. The config file goes over it.
+	ConfigStore Config;												// What is in use. Read by the gamepad hook thread too.
+	ConfigWatcher Watcher;											// Only watches if -c is given.
+	ActivityRing PadRing;											// Gamepad hook thread to engine thread.
+	uint64_t NumPadRecordsDropped			= 0;					// As of the last drain.
+	MetricsRegistry Metrics;
+	MetricsExporter Exporter(Metrics, Engine, Coalescer);			// Only serves if -e is given.
+	LockAction Locker;												// LockWorkStation, confirmed by the session change.
+	int64_t ArmedDeadlineMs					= 0;					// When the deadline timer was last set to fire.
+	std::shared_ptr<gamepad::hook> PadHook;							// Not started until a pad is present.
+	HDEVNOTIFY hPadNotify					= NULL;					// Device arrivals while there is no hook.
+
+	// Evaluates the deadlines, performs any policy stages that are due, and re-arms the one-shot deadline timer. Call
+	// after anything that may move a deadline earlier. Activity only ever moves deadlines later so input never calls
+	// this.
+	void UpdateSchedule(HWND);
+
+	// Reads the config file over the command line settings. On failure the config is left alone.
+	bool LoadConfig(const char* path, ConfigSnapshot&);
+
+	// Applies the published config. Settings are the engine, coalescer, scheduler, and mouse filter values, which must
+	// be in place before the first deadline is armed. Inputs installs or removes the low-level hooks the config turns
+	// on or off and starts gamepads if needed.
+	void ApplySettings();
+	bool ApplyInputs(HWND);
+	void ReloadConfig(HWND);
+	int GetPadEventTypes(const ConfigSnapshot&);
+
+	// Starts locking the workstation and returns without waiting. dueUs is when the lock became due. LockWorkStation
+	// only starts the lock, so it is confirmed when WTS_SESSION_LOCK arrives and the result goes to HandleLockResult.
+	// If that hasn't happened by the time the confirm timer fires the lock has failed.
+	void LockSession(HWND, int64_t dueUs);
+	void HandleLockResult(LockResult);
+
+	// Shows or removes the tray balloon that warns of an upcoming lock.
+	void ShowWarning(int64_t nowMs);
+	void HideWarning();
+
+	// Formats the tray tooltip from the current engine state and returns true if the text changed. UpdateTooltip also
+	// pushes a change to the shell. An unchanged tooltip costs the shell nothing.
+	bool FormatTooltip();
+	void UpdateTooltip();
 
 	LRESULT CALLBACK MainWinProc(HWND hwnd, UINT message, WPARAM, LPARAM);
 	LRESULT CALLBACK Hook_Keyboard(int code, WPARAM, LPARAM);
 	LRESULT CALLBACK Hook_Mouse(int code, WPARAM, LPARAM);
 
-	void Hook_GamepadButton(std::shared_ptr<gamepad::device>);
-	void Hook_GamepadAxis(std::shared_ptr<gamepad::device>);
+	void Hook_GamepadEvents(const gamepad::device_event*, size_t count, void*);
+
+	// Called on the engine thread to process everything the gamepad hook thread has pushed.
+	void DrainPadRing();
 	void Hook_GamepadConnect(std::shared_ptr<gamepad::device>);
 	void Hook_GamepadDisconnect(std::shared_ptr<gamepad::device>);
 
+	// Most machines never see a gamepad, so the hook thread and the XInput DLL are only loaded once one is present.
+	// Until then HID device arrivals are watched for. XInput pads show up as HID game controllers too.
+	bool IsGamepadPresent();
+	bool EnableGamepads(HWND);
+	bool StartGamepadHook();
+
 	enum ExitCode
 	{
 		ExitCode_Success,
 		ExitCode_AlreadyRunning,
-		ExitCode_CommonControlsInitFailure,
+		ExitCode_CommonControlsInitFailure,									// No longer used. Kept so codes don't change.
 		ExitCode_RegisterClassFailure,
 		ExitCode_CreateWindowFailure,
-		ExitCode_XInputGamepadHookFailure
+		ExitCode_XInputGamepadHookFailure,
+		ExitCode_TraceFailure,
+		ExitCode_MetricsFailure
 	};
 }
 
 
+void Lockdown::UpdateSchedule(HWND hwnd)
+{
+	int64_t nowMs = GetTimeMs();
+	int64_t deadlineMs = nowMs;
+	uint32_t actions = Scheduler.Update(nowMs, deadlineMs);
+
+	// Activity after a warning or blank means the user is back. The display wakes by itself.
+	if (actions & PolicyAction_Cancel)
+	{
+		Metrics.Increment(Counter_StagesCancelled);
+		HideWarning();
+	}
+
+	if (actions & PolicyAction_Warn)
+	{
+		Metrics.Increment(Counter_Warnings);
+		Trace.WriteCommand(TraceCommand_Warn);
+		ShowWarning(nowMs);
+	}
+
+	if (actions & PolicyAction_Blank)
+	{
+		Metrics.Increment(Counter_Blanks);
+		Trace.WriteCommand(TraceCommand_Blank);
+		SendMessage(hwnd, WM_SYSCOMMAND, SC_MONITORPOWER, 2);
+	}
+
+	if (actions & PolicyAction_Lock)
+	{
+		Metrics.Increment(Counter_Locks);
+		Trace.WriteCommand(TraceCommand_Lock);
+		HideWarning();
+		LockSession(hwnd, Scheduler.GetDueTime(PolicyStage_Lock) * 1000);
+		Coalescer.Reset();
+	}
+
+	if (actions & PolicyAction_Logout)
+	{
+		Metrics.Increment(Counter_Logouts);
+		Trace.WriteCommand(TraceCommand_Logout);
+		ExitWindowsEx(EWX_LOGOFF, SHTDN_REASON_MAJOR_OTHER | SHTDN_REASON_FLAG_PLANNED);
+	}
+
+	// SetTimer is relative and limited to USER_TIMER_MAXIMUM. A clamped timer just wakes early and re-arms. The tick
+	// count it uses includes time asleep, and we also re-evaluate on resume, so sleeping does not push the lock out.
+	int64_t delayMs = LockScheduler::GetDelay(nowMs, deadlineMs);
+	if (delayMs > USER_TIMER_MAXIMUM)
+		delayMs = USER_TIMER_MAXIMUM;
+	SetTimer(hwnd, DeadlineTimerID, UINT(delayMs), NULL);
+	ArmedDeadlineMs = nowMs + delayMs;
+}
+
+
+void Lockdown::LockSession(HWND hwnd, int64_t dueUs)
+{
+	// A lock folded into one already pending keeps that one's times, so nothing new is recorded for it, and its
+	// confirm timer keeps running.
+	bool pending = Locker.IsPending();
+	LockResult result = Locker.Issue(dueUs);
+	if (!pending && (result != LockResult_Failed))
+		Metrics.RecordLockIssued(Locker.GetIssueLatencyUs());
+	if (!pending && Locker.IsPending())
+		SetTimer(hwnd, LockConfirmTimerID, UINT(LockConfirmTimeoutMs), NULL);
+	HandleLockResult(result);
+}
+
+
+void Lockdown::HandleLockResult(LockResult result)
+{
+	if (result == LockResult_Confirmed)
+	{
+		Metrics.RecordLockConfirmed(Locker.GetConfirmLatencyUs());
+		tdPrintf("Locked %lld us after issuing.\n", (long long)Locker.GetConfirmLatencyUs());
+	}
+	else if (result == LockResult_Failed)
+	{
+		Metrics.Increment(Counter_LockFailures);
+		tdPrintf("Lock failed using the %s backend.\n", GetLockBackendName(Locker.GetBackend()));
+	}
+}
+
+
+void Lockdown::ShowWarning(int64_t nowMs)
+{
+	if (!NotifyIconAdded)
+		return;
+
+	// The remaining time rather than the configured warning time, since lock in 10 seconds can bring the lock closer.
+	int64_t remainingMs = Engine.GetRemaining(nowMs);
+	int secondsLeft = (remainingMs > 0) ? int((remainingMs + 999) / 1000) : 0;
+	NotifyIconData.uFlags |= NIF_INFO;
+	NotifyIconData.dwInfoFlags = NIIF_WARNING;
+	tsPrintf(NotifyIconData.szInfoTitle, sizeof(NotifyIconData.szInfoTitle), "Lockdown");
+	tsPrintf(NotifyIconData.szInfo, sizeof(NotifyIconData.szInfo), "Locking in %d seconds.", secondsLeft);
+	Shell_NotifyIcon(NIM_MODIFY, &NotifyIconData);
+	NotifyIconData.uFlags &= ~NIF_INFO;
+}
+
+
+void Lockdown::HideWarning()
+{
+	if (!NotifyIconAdded)
+		return;
+
+	// An empty message removes the balloon.
+	NotifyIconData.uFlags |= NIF_INFO;
+	NotifyIconData.szInfo[0] = '\0';
+	Shell_NotifyIcon(NIM_MODIFY, &NotifyIconData);
+	NotifyIconData.uFlags &= ~NIF_INFO;
+}
+
+
+bool Lockdown::FormatTooltip()
+{
+	if (!Status.Update(Engine, GetTimeMs()))
+		return false;
+
+	tsPrintf(NotifyIconData.szTip, sizeof(NotifyIconData.szTip), "%s", Status.Get());
+	return true;
+}
+
+
+void Lockdown::UpdateTooltip()
+{
+	// Minutes are shown until the last one, so most deadlines and hovers leave the text as it was.
+	if (!NotifyIconAdded || !FormatTooltip())
+		return;
+
+	Shell_NotifyIcon(NIM_MODIFY, &NotifyIconData);
+	Metrics.Increment(Counter_StatusUpdates);
+}
+
+
 LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 {
 	static UINT taskbarRestart = 0;
@@ -93,73 +301,99 @@ LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, L
 		case WM_DESTROY:
 			if (NotifyIconAdded)
 				Shell_NotifyIcon(NIM_DELETE, &NotifyIconData);
+			if (hTrayMenu)
+				DestroyMenu(hTrayMenu);
+			hTrayMenu = NULL;
+			WTSUnRegisterSessionNotification(hwnd);
 			PostQuitMessage(0);
 			break;
 
-		case WM_TIMER:
-		{
-			if (!NotifyIconAdded)
-				NotifyIconAdded = Shell_NotifyIcon(NIM_ADD, &NotifyIconData);
-
-			if (Enabled)
+		case WM_WTSSESSION_CHANGE:
+			if (wparam == WTS_SESSION_LOCK)
 			{
-				CountdownSeconds--;
-			}
-			else
-			{
-				CountdownSuspendSeconds--;
-				if (CountdownSuspendSeconds <= 0)
-					Enabled = true;
+				KillTimer(hwnd, LockConfirmTimerID);
+				HandleLockResult(Locker.Confirm());
 			}
+			break;
 
-			int secondsLeft = Lockdown::CountdownSeconds + 1;
-			int mins = secondsLeft / 60;
-			int secs = secondsLeft % 60;
-			if (NotifyIconAdded)
+		case WM_TIMER:
+			if (wparam == LockConfirmTimerID)
 			{
-				if (Enabled)
-					tsPrintf(NotifyIconData.szTip, sizeof(NotifyIconData.szTip), "Lock in %02d:%02d", mins, secs);
-				else
-					tsPrintf(NotifyIconData.szTip, sizeof(NotifyIconData.szTip), "Lockdown Disabled");
-				Shell_NotifyIcon(NIM_MODIFY, &NotifyIconData);
+				KillTimer(hwnd, LockConfirmTimerID);
+				HandleLockResult(Locker.Expire());
+				break;
 			}
 
-			if (CountdownSeconds <= 0)
+			// This only fires at a deadline (or early if activity moved the deadline later). There is no periodic tick.
+			if (wparam != DeadlineTimerID)
+				break;
+
+			Metrics.RecordTimerWakeup(GetTimeMs() - ArmedDeadlineMs);
+
+			// Pad input that hasn't been drained yet must count before deciding whether to lock.
+			DrainPadRing();
+
+			if (!NotifyIconAdded)
+				NotifyIconAdded = Shell_NotifyIcon(NIM_ADD, &NotifyIconData);
+			UpdateSchedule(hwnd);
+			UpdateTooltip();
+			if (Config.GetNumRetired())
+				Config.Reclaim();
+			break;
+
+		case WM_POWERBROADCAST:
+			// The deadline may have passed while asleep. Evaluate now rather than waiting on the timer.
+			if (wparam == PBT_APMRESUMEAUTOMATIC)
+				UpdateSchedule(hwnd);
+			break;
+
+		case WM_USER_PADACTIVITY:
+			DrainPadRing();
+			break;
+
+		case WM_DEVICECHANGE:
+		{
+			// Listing devices and starting the hook allocate. Neither happens once a pad has been seen.
+			SteadyStateScope arrival(false);
+			if ((wparam != DBT_DEVICEARRIVAL) || PadHook || !hPadNotify || !IsGamepadPresent())
+				break;
+
+			// Failing to start here isn't fatal. Keyboard and mouse still count.
+			if (StartGamepadHook())
 			{
-				CountdownSeconds = SecondsToLock;
-				LockWorkStation();
+				UnregisterDeviceNotification(hPadNotify);
+				hPadNotify = NULL;
 			}
+			break;
 		}
 
 		case WM_USER_TRAYICON:
 			switch (LOWORD(lparam))
 			{
+				// Hovering the icon is the only time anyone sees the remaining time, so that is when it is computed. The
+				// shell only hears about it when the text has changed since it was last shown.
+				case WM_MOUSEMOVE:
+					UpdateTooltip();
+					break;
+
 				case WM_RBUTTONDOWN:
 				case WM_LBUTTONDOWN:
 				{
 					POINT cursorPos;
 					GetCursorPos(&cursorPos);
 
-					HMENU hmenu = LoadMenu(hInst, MAKEINTRESOURCE(IDR_TRAY_MENU));
-					if (!hmenu)
-						return -1;
-
-					HMENU hsubMenu = GetSubMenu(hmenu, 0);
+					HMENU hsubMenu = hTrayMenu ? GetSubMenu(hTrayMenu, 0) : NULL;
 					if (!hsubMenu)
-					{
-						DestroyMenu(hmenu);
 						return -1;
-					}
 
-					if (Enabled)
-						CheckMenuItem(hmenu, ID_MENU_ENABLED, MF_BYCOMMAND | MF_CHECKED);
+					if (Engine.IsEnabled(GetTimeMs()))
+						CheckMenuItem(hTrayMenu, ID_MENU_ENABLED, MF_BYCOMMAND | MF_CHECKED);
 					else
-						CheckMenuItem(hmenu, ID_MENU_ENABLED, MF_BYCOMMAND | MF_UNCHECKED);
+						CheckMenuItem(hTrayMenu, ID_MENU_ENABLED, MF_BYCOMMAND | MF_UNCHECKED);
 
 					SetForegroundWindow(hwnd);
 					TrackPopupMenu(hsubMenu, TPM_LEFTALIGN | TPM_LEFTBUTTON | TPM_BOTTOMALIGN, cursorPos.x, cursorPos.y, 0, hwnd, NULL);
 					SendMessage(hwnd, WM_NULL, 0, 0);
-					DestroyMenu(hmenu);
 					break;
 				}
 			}
@@ -174,10 +408,10 @@ LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, L
 			{
 				case ID_MENU_ABOUT:
 				{
-					tString messageString;
+					char message[1024];
 					tsPrintf
 					(
-						messageString,
+						message, sizeof(message),
 						// @todo Support command line options for gamepad buttons, gamepad axis, mouse buttons, mouse movement, keyboard, timeout minutes.
 						"Lockdown V%d.%d.%d by Tristan Grimmer.\n"
 						"Under ISC licence (similar to MIT).\n\n"
@@ -197,11 +431,12 @@ LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, L
 						"By default the timer is reset on keyboard activity, mouse\n"
 						"button presses, mouse movement, gamepad button presses,\n"
 						"and gamepad axis displacement.\n",
-						LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision, Lockdown::SecondsToLock/60, Lockdown::SecondsToLock%60
+						LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision,
+						int(Engine.GetTimeout() / 60000), int((Engine.GetTimeout() % 60000) / 1000)
 					);
 					::MessageBox
 					(
-						hwnd, messageString.Chr(), "About Lockdown", MB_OK | MB_ICONINFORMATION
+						hwnd, message, "About Lockdown", MB_OK | MB_ICONINFORMATION
 					);
 					break;
 				}
@@ -221,46 +456,62 @@ LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, L
 				}
 
 				case ID_MENU_LOCK10:
-					Enabled = true;
-					CountdownSeconds = 10;
+					Metrics.Increment(Counter_SetRemaining);
+					Trace.WriteCommand(TraceCommand_SetRemaining, 10 * 1000);
+					Engine.SetRemaining(GetTimeMs(), 10 * 1000);
+					Coalescer.Reset(10 * 1000);
+					UpdateSchedule(hwnd);
 					break;
 
 				case ID_MENU_ENABLED:
 					// If about to toggle off print a warning.
-					if (Enabled)
+					if (Engine.IsEnabled(GetTimeMs()))
 					{
-						tString message;
+						char message[256];
 						tsPrintf
 						(
-							message,
+							message, sizeof(message),
 							"Please confirm you want to suspend lockdown.\n\n"
 							"OK will suspend auto-locking for %d hours %d minutes.\n"
 							"Cancel will leave lockdown enabled.\n\n",
-							MaxSuspendSeconds / 3600, (MaxSuspendSeconds % 3600) / 60
+							int(Engine.GetMaxSuspend() / 3600000), int((Engine.GetMaxSuspend() % 3600000) / 60000)
 						);
-						int result = ::MessageBox(hwnd, message.Chr(), "Suspend Lockdown?", MB_OKCANCEL | MB_ICONQUESTION);
+						int result = ::MessageBox(hwnd, message, "Suspend Lockdown?", MB_OKCANCEL | MB_ICONQUESTION);
 						if (result == IDOK)
 						{
-							CountdownSuspendSeconds = MaxSuspendSeconds;
-							Enabled = false;
+							Metrics.Increment(Counter_Suspends);
+							Trace.WriteCommand(TraceCommand_Suspend);
+							Engine.Suspend(GetTimeMs());
 						}
 					}
 					else
 					{
-						Enabled = true;
+						Metrics.Increment(Counter_Resumes);
+						Trace.WriteCommand(TraceCommand_Resume);
+						Engine.Resume(GetTimeMs());
+						Coalescer.Reset();
 					}
+					UpdateSchedule(hwnd);
 					break;
 
 				case ID_MENU_LOCKNOW:
-					Enabled = true;
-					LockWorkStation();
+				{
+					int64_t dueUs = GetTimeUs();
+					Metrics.Increment(Counter_LockNow);
+					Trace.WriteCommand(TraceCommand_LockNow);
+					Engine.Resume(GetTimeMs());
+					LockSession(hwnd, dueUs);
+					Coalescer.Reset();
+					UpdateSchedule(hwnd);
 					break;
+				}
 			}
 			break;
 
 		default:
 			if (message == taskbarRestart)
 			{
+				FormatTooltip();
 				NotifyIconAdded = Shell_NotifyIcon(NIM_ADD, &NotifyIconData);
 			}
 			break;
@@ -272,8 +523,19 @@ LRESULT CALLBACK Lockdown::MainWinProc(HWND hwnd, UINT message, WPARAM wparam, L
 
 LRESULT CALLBACK Lockdown::Hook_Keyboard(int code, WPARAM wparam, LPARAM lparam)
 {
+	// Holding a key sends repeated WM_KEYDOWNs without a WM_KEYUP in between. The coalescer tracks which keys are down
+	// so only the initial press counts.
+	KBDLLHOOKSTRUCT* keyStruct = (KBDLLHOOKSTRUCT*)lparam;
 	if (wparam == WM_KEYDOWN)
-		CountdownSeconds = SecondsToLock;
+	{
+		Trace.WriteKey(int(keyStruct->vkCode), true);
+		Coalescer.ReportKey(int(keyStruct->vkCode), true, GetTimeMs());
+	}
+	else if ((wparam == WM_KEYUP) || (wparam == WM_SYSKEYUP))
+	{
+		Trace.WriteKey(int(keyStruct->vkCode), false);
+		Coalescer.ReportKey(int(keyStruct->vkCode), false, GetTimeMs());
+	}
 
 	return CallNextHookEx(hKeyboardHook, code, wparam, lparam);
 }
@@ -281,10 +543,12 @@ LRESULT CALLBACK Lockdown::Hook_Keyboard(int code, WPARAM wparam, LPARAM lparam)
 
 LRESULT CALLBACK Lockdown::Hook_Mouse(int code, WPARAM wparam, LPARAM lparam)
 {
+	// The hook stays installed while either mouse input is on, so each is checked here.
+	ConfigReader config(Config);
 	MSLLHOOKSTRUCT* mouseStruct = (MSLLHOOKSTRUCT*)lparam;
 	if
 	(
-		OptionMouseButton.IsPresent() &&
+		config->IsSourceEnabled(ActivitySource_MouseButton) &&
 		(
 			(wparam == WM_LBUTTONDOWN) || (wparam == WM_LBUTTONUP) ||
 			(wparam == WM_RBUTTONDOWN) || (wparam == WM_RBUTTONUP) ||
@@ -292,88 +556,299 @@ LRESULT CALLBACK Lockdown::Hook_Mouse(int code, WPARAM wparam, LPARAM lparam)
 		)
 	)
 	{
-		CountdownSeconds = SecondsToLock;
+		Trace.WriteMouseButton(int(wparam));
+		Coalescer.Report(ActivitySource_MouseButton);
 	}
 
-	if
-	(
-		OptionMouseMovement.IsPresent() &&
-		(
-			(wparam == WM_MOUSEMOVE) || (wparam == WM_NCMOUSEMOVE)
-		)
-	)
+	// Every move is traced so the distance filter can be replayed. While the movement window is open the distance
+	// check is skipped entirely.
+	bool moved =
+		config->IsSourceEnabled(ActivitySource_MouseMove) && ((wparam == WM_MOUSEMOVE) || (wparam == WM_NCMOUSEMOVE));
+	if (moved)
+		Trace.WriteMousePos(mouseStruct->pt.x, mouseStruct->pt.y);
+
+	if (moved && !Coalescer.TryCoalesce(ActivitySource_MouseMove, GetTimeMs()))
 	{
-		tVector2 prevPos{float(MouseX), float(MouseY)};
-		int xpos = mouseStruct->pt.x;
-		int ypos = mouseStruct->pt.y;
-		tVector2 currPos{float(xpos), float(ypos)};
-		tVector2 delta = currPos - prevPos;
-		if (delta.Length() > MouseDistanceThreshold)
-		{
-			MouseX = xpos;
-			MouseY = ypos;
-			CountdownSeconds = SecondsToLock;
-		}
+		if (MouseMoveFilter.Update(mouseStruct->pt.x, mouseStruct->pt.y))
+			Coalescer.Report(ActivitySource_MouseMove);
 	}
 
 	return CallNextHookEx(hMouseHook, code, wparam, lparam);
 }
 
 
-void Lockdown::Hook_GamepadButton(std::shared_ptr<gamepad::device> dev)
+void Lockdown::Hook_GamepadEvents(const gamepad::device_event* events, size_t count, void*)
 {
-	tdPrintf
-	(
-		"Received button event: Native id: %i, Virtual id: 0x%X (%i) val: %f\n",
-		dev->last_button_event()->native_id, dev->last_button_event()->vc,
-		dev->last_button_event()->vc, dev->last_button_event()->virtual_value
-	);
+	// Only a compact record per event is pushed here. Printing, tracing, and reporting to the coalescer all happen on
+	// the engine thread when it drains the ring, so the hook thread never waits on console output or the trace lock.
+	SteadyStateScope steadyState;
+	int padEventTypes = GetPadEventTypes(*ConfigReader(Config));
+	int64_t nowMs = GetTimeMs();
+	bool pushed = false;
+	for (size_t e = 0; e < count; e++)
+	{
+		const gamepad::device_event& devEvent = events[e];
+		if (!(devEvent.type & padEventTypes))
+			continue;
+
+		// A packet event means the pad had input between polls that left no change. It counts as a button.
+		const gamepad::input_event& ev = devEvent.event;
+		bool isAxis = (devEvent.type == gamepad::update_result::AXIS);
+		ActivityRecord record;
+		record.EventTime	= ev.time;
+		record.TimeMs		= nowMs;
+		record.Value		= ev.value;
+		record.NativeID		= ev.native_id;
+		record.VC			= ev.vc;
+		record.Source		= uint8_t(isAxis ? ActivitySource_PadAxis : ActivitySource_PadButton);
+		record.Type			= uint8_t(isAxis ? TraceType_PadAxis : TraceType_PadButton);
+		record.Device		= uint8_t(devEvent.device_index);
+		record.Pad			= 0;
+		PadRing.Push(record);
+		pushed = true;
+	}
 
-	// Any button press on any gamepad resets the countdown.
-	// @todo Test that LB RB bumper buttons reset.
-	// @todo Ideally this write would be mutex protected.
-	CountdownSeconds = SecondsToLock;
-};
+	if (pushed && PadRing.Publish())
+		PostMessage(hMainWindow, WM_USER_PADACTIVITY, 0, 0);
+}
 
 
-void Lockdown::Hook_GamepadAxis(std::shared_ptr<gamepad::device> dev)
+void Lockdown::DrainPadRing()
 {
-	tdPrintf
+	PadRing.Drain
 	(
-		"Received axis event: Native id: %i, Virtual id: 0x%X (%i) val: %f\n",
-		dev->last_axis_event()->native_id, dev->last_axis_event()->vc,
-		dev->last_axis_event()->vc, dev->last_axis_event()->virtual_value
+		[](const ActivityRecord& record)
+		{
+			tdPrintf
+			(
+				"Received %s event: Native id: %i, Virtual id: 0x%X (%i) val: %i\n",
+				(record.Type == TraceType_PadAxis) ? "axis" : "button", record.NativeID, record.VC, record.VC, record.Value
+			);
+			Trace.WritePad(TraceType(record.Type), record.Device, record.NativeID, record.VC, record.Value, record.EventTime);
+			Coalescer.Report(ActivitySource(record.Source), record.TimeMs);
+		}
 	);
 
-	// The gamepad device already deals with axis dead-zones. This means we can safely ignore
-	// the fact that we're getting events from different gamepads and 'wobbling' between
-	// them. We can simply reset the countdown on any axis event -- regardless of which
-	// gamepad or the particular axis.
-
-	// @todo Test that LT RT triggers reset.
-	// @todo Ideally this write would be mutex protected.
-	CountdownSeconds = SecondsToLock;
-};
+	// Dropped records still count as activity, just not at the exact time.
+	uint32_t droppedSources = PadRing.TakeOverflowSources();
+	if (!droppedSources)
+		return;
+	for (int s = 0; s < ActivitySource_NumSources; s++)
+		if (droppedSources & (1u << s))
+			Coalescer.Report(ActivitySource(s));
+
+	uint64_t numDropped = PadRing.GetNumOverflows();
+	Metrics.Add(Counter_PadRecordsDropped, numDropped - NumPadRecordsDropped);
+	NumPadRecordsDropped = numDropped;
+}
 
 
 void Lockdown::Hook_GamepadConnect(std::shared_ptr<gamepad::device> dev)
 {
 	tdPrintf("%s connected\n", dev->get_name().c_str());
+	Metrics.Increment(Counter_GamepadConnects);
 
-	// @todo Ideally this write would be mutex protected.
-	CountdownSeconds = SecondsToLock;
+	Engine.ReportActivity();
 };
 
 
 void Lockdown::Hook_GamepadDisconnect(std::shared_ptr<gamepad::device> dev)
 {
 	tdPrintf("%s disconnected\n", dev->get_name().c_str());
+	Metrics.Increment(Counter_GamepadDisconnects);
 
 	// On a gamepad disconnect it makes sense _not_ to coult it as an input. One might,
 	// for example, be disconnecting the gamepad when leaving for the day.
 };
 
 
+bool Lockdown::IsGamepadPresent()
+{
+	// Raw input lists devices without opening them, so this is cheap enough to call on every arrival.
+	UINT numDevices = 0;
+	if ((GetRawInputDeviceList(NULL, &numDevices, sizeof(RAWINPUTDEVICELIST)) != 0) || (numDevices == 0))
+		return false;
+
+	std::vector<RAWINPUTDEVICELIST> devices(numDevices);
+	numDevices = GetRawInputDeviceList(devices.data(), &numDevices, sizeof(RAWINPUTDEVICELIST));
+	if (numDevices == UINT(-1))
+		return false;
+
+	for (UINT d = 0; d < numDevices; d++)
+	{
+		if (devices[d].dwType != RIM_TYPEHID)
+			continue;
+
+		// Generic desktop page, joystick or gamepad usage.
+		RID_DEVICE_INFO info;
+		info.cbSize = sizeof(info);
+		UINT size = sizeof(info);
+		if (GetRawInputDeviceInfo(devices[d].hDevice, RIDI_DEVICEINFO, &info, &size) == UINT(-1))
+			continue;
+		if ((info.hid.usUsagePage == 0x01) && ((info.hid.usUsage == 0x04) || (info.hid.usUsage == 0x05)))
+			return true;
+	}
+	return false;
+}
+
+
+bool Lockdown::EnableGamepads(HWND hwnd)
+{
+	if (PadHook || hPadNotify)
+		return true;
+
+	// Arrivals are registered for before looking for a pad so one plugged in between the two isn't missed.
+	// GUID_DEVINTERFACE_HID. Spelled out to avoid needing initguid.h and hidclass.h for one value.
+	DEV_BROADCAST_DEVICEINTERFACE filter;
+	memset(&filter, 0, sizeof(filter));
+	filter.dbcc_size			= sizeof(filter);
+	filter.dbcc_devicetype		= DBT_DEVTYP_DEVICEINTERFACE;
+	filter.dbcc_classguid		= { 0x4D1E55B2, 0xF16F, 0x11CF, { 0x88, 0xCB, 0x00, 0x11, 0x11, 0x00, 0x00, 0x30 } };
+	hPadNotify = RegisterDeviceNotification(hwnd, &filter, DEVICE_NOTIFY_WINDOW_HANDLE);
+
+	if (!hPadNotify || IsGamepadPresent())
+	{
+		if (hPadNotify)
+			UnregisterDeviceNotification(hPadNotify);
+		hPadNotify = NULL;
+		return StartGamepadHook();
+	}
+	return true;
+}
+
+
+bool Lockdown::StartGamepadHook()
+{
+	// Starting the hook allocates, which is fine since it only happens once.
+	SteadyStateScope starting(false);
+	PadHook = gamepad::hook::make();
+	PadHook->set_plug_and_play(true, gamepad::ms(1000));
+	PadHook->set_sleep_time(gamepad::ms(100)); // 10fps poll.
+
+	// Only pad input before the next deadline matters, so while the pads are idle XInput is polled every couple of
+	// seconds at most and just ahead of the deadline. Input between polls still shows up in the packet number.
+	PadHook->set_adaptive_polling
+	(
+		true, gamepad::ms(2000),
+		[]() { int64_t nowMs = GetTimeMs(); return gamepad::ms(Engine.GetNextDeadline(nowMs) - nowMs); }
+	);
+	PadHook->set_batch_event_handler(Hook_GamepadEvents);
+	PadHook->set_connect_event_handler(Hook_GamepadConnect);
+	PadHook->set_disconnect_event_handler(Hook_GamepadDisconnect);
+
+	// What the pads' axis filters learn, such as the deadzone a drifting stick needs, is kept across runs if asked.
+	if (OptionDeadzones.IsPresent() && !PadHook->load_calibration(OptionDeadzones.Arg1().Chr()))
+		tdPrintf("Couldn't read gamepad deadzones %s. They are learned again.\n", OptionDeadzones.Arg1().Chr());
+	if (!PadHook->start())
+	{
+		tdPrintf("Couldn't start gamepad hook.\n");
+		PadHook.reset();
+		return false;
+	}
+	return true;
+}
+
+
+bool Lockdown::LoadConfig(const char* path, ConfigSnapshot& config)
+{
+	std::string text;
+	if (!ConfigWatcher::Read(path, text))
+	{
+		tdPrintf("Couldn't read config file %s.\n", path);
+		return false;
+	}
+
+	ConfigSnapshot loaded = BaseConfig;
+	std::string error;
+	if (!ParseConfig(text, loaded, error))
+	{
+		tdPrintf("Config file %s not applied. %s.\n", path, error.c_str());
+		return false;
+	}
+	config = loaded;
+	return true;
+}
+
+
+void Lockdown::ApplySettings()
+{
+	ConfigReader config(Config);
+	Engine.SetTimeout(config->TimeoutMs);
+	Engine.SetMaxSuspend(config->MaxSuspendMs);
+	Coalescer.SetTimeout(config->TimeoutMs);
+	Coalescer.SetWindows(config->WindowMs);
+	MouseMoveFilter.SetThreshold(config->DistanceThreshold);
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+		Scheduler.SetStage(PolicyStage(s), config->StageEnabled[s], config->StageOffsetMs[s]);
+	Metrics.SetGauge(Gauge_ConfigGeneration, int64_t(config->Generation));
+}
+
+
+bool Lockdown::ApplyInputs(HWND hwnd)
+{
+	// An input that is turned off costs nothing once its hook is removed. Gamepads turned off are left running and
+	// their events ignored, so turning them back on doesn't wait for XInput to load.
+	ConfigReader config(Config);
+	const uint32_t mouseSources	= (1u << ActivitySource_MouseMove) | (1u << ActivitySource_MouseButton);
+	const uint32_t padSources	= (1u << ActivitySource_PadButton) | (1u << ActivitySource_PadAxis);
+	bool keyboard				= config->IsSourceEnabled(ActivitySource_Keyboard);
+	bool mouse					= config->Sources & mouseSources;
+	bool pad					= config->Sources & padSources;
+
+	if (keyboard && !hKeyboardHook)
+		hKeyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, Hook_Keyboard, NULL, 0);
+	else if (!keyboard && hKeyboardHook)
+	{
+		UnhookWindowsHookEx(hKeyboardHook);
+		hKeyboardHook = NULL;
+	}
+
+	if (mouse && !hMouseHook)
+		hMouseHook = SetWindowsHookEx(WH_MOUSE_LL, Hook_Mouse, NULL, 0);
+	else if (!mouse && hMouseHook)
+	{
+		UnhookWindowsHookEx(hMouseHook);
+		hMouseHook = NULL;
+	}
+
+	return pad ? EnableGamepads(hwnd) : true;
+}
+
+
+void Lockdown::ReloadConfig(HWND hwnd)
+{
+	// Reading, parsing, and publishing the file all allocate. A reload is rare enough not to count as steady state.
+	SteadyStateScope reloading(false);
+	ConfigSnapshot config;
+	if (!LoadConfig(Watcher.GetPath().c_str(), config))
+	{
+		Metrics.Increment(Counter_ConfigErrors);
+		return;
+	}
+
+	// The new snapshot is complete before the hooks can see it. The old one goes once no reader can be using it. The
+	// new settings may bring the deadline closer, so the schedule is evaluated now rather than at the old deadline.
+	Config.Publish(config);
+	Metrics.Increment(Counter_ConfigReloads);
+	ApplySettings();
+	ApplyInputs(hwnd);
+	UpdateSchedule(hwnd);
+	UpdateTooltip();
+}
+
+
+int Lockdown::GetPadEventTypes(const ConfigSnapshot& config)
+{
+	// A packet event means the pad had input between polls that left no change. It counts for either.
+	int types = 0;
+	if (config.IsSourceEnabled(ActivitySource_PadButton))
+		types |= gamepad::update_result::BUTTON | gamepad::update_result::PACKET;
+	if (config.IsSourceEnabled(ActivitySource_PadAxis))
+		types |= gamepad::update_result::AXIS | gamepad::update_result::PACKET;
+	return types;
+}
+
+
 int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE hprevInstance, LPSTR cmdLine, int cmdShow)
 {
 	// If one is already running, do not start another.
@@ -387,51 +862,67 @@ int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE hprevInstance, LPSTR cmdLine,
 	// Parse command line.
 	tCmdLine::tParse((char8_t*)cmdLine, false, false);
 
-	// Was a timeout override specified?
-	int timeoutOverride = 0;
+	// The command line settings. Deadlines have millisecond resolution so fractional seconds are allowed.
+	Lockdown::ConfigSnapshot& base = Lockdown::BaseConfig;
+	int64_t timeoutOverrideMs = 0;
 	if (OptionTimeoutMinutes.IsPresent())
-		timeoutOverride += 60 * OptionTimeoutMinutes.Arg1().AsInt();
+		timeoutOverrideMs += 60000 * int64_t(OptionTimeoutMinutes.Arg1().AsInt());
 	if (OptionTimeoutSeconds.IsPresent())
-		timeoutOverride += OptionTimeoutSeconds.Arg1().AsInt();
-	if (timeoutOverride > 0)
-		Lockdown::SecondsToLock = timeoutOverride;
-	Lockdown::CountdownSeconds = Lockdown::SecondsToLock;
+		timeoutOverrideMs += int64_t(OptionTimeoutSeconds.Arg1().AsFloat() * 1000.0f);
+	if (timeoutOverrideMs > 0)
+		base.TimeoutMs = timeoutOverrideMs;
 
-	int suspendOverride = 0;
+	int64_t suspendOverrideMs = 0;
 	if (OptionMaxSuspendMinutes.IsPresent())
-		suspendOverride = 60 * OptionMaxSuspendMinutes.Arg1().AsInt();
-	if (suspendOverride > 0)
-		Lockdown::MaxSuspendSeconds = suspendOverride;
-	Lockdown::CountdownSuspendSeconds = Lockdown::MaxSuspendSeconds;
+		suspendOverrideMs = 60000 * int64_t(OptionMaxSuspendMinutes.Arg1().AsInt());
+	if (suspendOverrideMs > 0)
+		base.MaxSuspendMs = suspendOverrideMs;
 
+	if (OptionWindow.IsPresent() && (OptionWindow.Arg1().AsInt() >= 0))
+		base.WindowMs = OptionWindow.Arg1().AsInt();
+
+	// Policy stages are placed relative to the lock so the timeout is still the time to lock.
+	if (OptionWarn.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Warn] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Warn] = -int64_t(OptionWarn.Arg1().AsFloat() * 1000.0f);
+	}
+	if (OptionBlank.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Blank] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Blank] = -int64_t(OptionBlank.Arg1().AsFloat() * 1000.0f);
+	}
+	if (OptionLogout.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Logout] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Logout] = 60000 * int64_t(OptionLogout.Arg1().AsInt());
+	}
+
+	// If no inputs are given they all count, which is the default.
 	if
 	(
-		!OptionKeyboard.IsPresent()		&& !OptionMouseMovement.IsPresent()		&& !OptionMouseButton.IsPresent() &&
-		!OptionPadButtons.IsPresent()	&& !OptionAxis.IsPresent()
+		OptionKeyboard.IsPresent()		|| OptionMouseMovement.IsPresent()		|| OptionMouseButton.IsPresent() ||
+		OptionPadButtons.IsPresent()	|| OptionAxis.IsPresent()
 	)
 	{
-		OptionKeyboard.Present = true;
-		OptionMouseMovement.Present = true;
-		OptionMouseButton.Present = true;
-		OptionPadButtons.Present = true;
-		OptionAxis.Present = true;
+		base.Sources = 0;
+		base.Sources |= OptionKeyboard.IsPresent()		? (1u << Lockdown::ActivitySource_Keyboard)		: 0;
+		base.Sources |= OptionMouseMovement.IsPresent()	? (1u << Lockdown::ActivitySource_MouseMove)	: 0;
+		base.Sources |= OptionMouseButton.IsPresent()	? (1u << Lockdown::ActivitySource_MouseButton)	: 0;
+		base.Sources |= OptionPadButtons.IsPresent()	? (1u << Lockdown::ActivitySource_PadButton)	: 0;
+		base.Sources |= OptionAxis.IsPresent()			? (1u << Lockdown::ActivitySource_PadAxis)		: 0;
 	}
 
-	if (OptionKeyboard.IsPresent())
-		Lockdown::hKeyboardHook	= SetWindowsHookEx(WH_KEYBOARD_LL,	Lockdown::Hook_Keyboard,	NULL, 0);
-
-	if (OptionMouseMovement.IsPresent() || OptionMouseButton.IsPresent())
-		Lockdown::hMouseHook	= SetWindowsHookEx(WH_MOUSE_LL,		Lockdown::Hook_Mouse,		NULL, 0);
+	// A config file that can't be used at startup isn't fatal. It is watched anyway so fixing it takes effect.
+	Lockdown::ConfigSnapshot config = base;
+	if (OptionConfig.IsPresent() && !Lockdown::LoadConfig(OptionConfig.Arg1().Chr(), config))
+		Lockdown::Metrics.Increment(Lockdown::Counter_ConfigErrors);
+	Lockdown::Config.Publish(config);
+	Lockdown::ApplySettings();
 
+	// The deadline timer needs a window, so creating one is all that happens before it is armed. Nothing here uses
+	// common controls. The tray menu and message boxes are plain user32 so comctl32 is never loaded.
 	Lockdown::hInst = hinstance;
-
-	INITCOMMONCONTROLSEX comControls;
-	memset(&comControls, 0, sizeof(comControls));
-	comControls.dwSize		= sizeof(comControls);
-	comControls.dwICC		= ICC_UPDOWN_CLASS | ICC_LISTVIEW_CLASSES;
-	if (!InitCommonControlsEx(&comControls))
-		return Lockdown::ExitCode_CommonControlsInitFailure;
-
 	WNDCLASSEX winClass;
 	memset(&winClass, 0, sizeof(winClass));
 	winClass.cbSize				= sizeof(winClass);
@@ -489,54 +980,102 @@ int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE hprevInstance, LPSTR cmdLine,
 		return Lockdown::ExitCode_Success;
 	}
 
+	// Arm the one-shot deadline timer before any optional work. Nothing after this can delay the lock, only when input
+	// starts being seen, and the full timeout is there to cover that. It is re-armed each time it fires for whatever
+	// the next deadline is then.
+	Lockdown::hMainWindow = hwnd;
+	Lockdown::Engine.Restart(Lockdown::GetTimeMs());
+	Lockdown::UpdateSchedule(hwnd);
+	Lockdown::Metrics.SetGauge(Lockdown::Gauge_StartupArmedUs, Lockdown::GetProcessAgeUs());
+
+	// Session changes confirm locks. Without them a lock still happens but its confirm latency isn't measured.
+	WTSRegisterSessionNotification(hwnd, NOTIFY_FOR_THIS_SESSION);
+
+	// Recording starts before the hooks are installed so the trace sees everything from the first event. The trace
+	// keeps the settings it started with. Start a new one to replay against reloaded timing.
+	if (OptionTrace.IsPresent())
+	{
+		Lockdown::TraceConfig traceConfig;
+		traceConfig.TimeoutMs			= config.TimeoutMs;
+		traceConfig.MaxSuspendMs		= config.MaxSuspendMs;
+		traceConfig.WindowMs			= config.WindowMs;
+		traceConfig.DistanceThreshold	= config.DistanceThreshold;
+		for (int s = 0; s < Lockdown::PolicyStage_NumStages; s++)
+		{
+			traceConfig.StageEnabled[s]		= config.StageEnabled[s];
+			traceConfig.StageOffsetMs[s]	= config.StageOffsetMs[s];
+		}
+		if (!Lockdown::Trace.Open(OptionTrace.Arg1().Chr(), traceConfig))
+		{
+			DestroyWindow(hwnd);
+			return Lockdown::ExitCode_TraceFailure;
+		}
+	}
+
+	if (OptionMetrics.IsPresent() && !Lockdown::Exporter.Start(OptionMetrics.Arg1().Chr()))
+	{
+		DestroyWindow(hwnd);
+		return Lockdown::ExitCode_MetricsFailure;
+	}
+
 	// System tray icon.
 	memset(&Lockdown::NotifyIconData, 0, sizeof(Lockdown::NotifyIconData));
 	Lockdown::NotifyIconData.cbSize			= sizeof(Lockdown::NotifyIconData);
 	Lockdown::NotifyIconData.hWnd			= hwnd;
 	Lockdown::NotifyIconData.uID			= IDI_LOCKDOWN_ICON;
 	Lockdown::NotifyIconData.uFlags			= NIF_ICON | NIF_MESSAGE | NIF_TIP;
-
-	int secondsLeft = Lockdown::CountdownSeconds + 1;
-	int mins = secondsLeft / 60;
-	int secs = secondsLeft % 60;
-   	Lockdown::Enabled = true;
-	tsPrintf(Lockdown::NotifyIconData.szTip, sizeof(Lockdown::NotifyIconData.szTip), "Lock in %02d:%02d", mins, secs);
+	Lockdown::FormatTooltip();
 
 	Lockdown::NotifyIconData.hIcon = LoadIcon(hinstance, (LPCTSTR)MAKEINTRESOURCE(IDI_LOCKDOWN_ICON));
 	Lockdown::NotifyIconData.uCallbackMessage = WM_USER_TRAYICON;
 	Lockdown::NotifyIconAdded = Shell_NotifyIcon(NIM_ADD, &Lockdown::NotifyIconData);
+	Lockdown::hTrayMenu = LoadMenu(hinstance, MAKEINTRESOURCE(IDR_TRAY_MENU));
+
+	// Input hooks and gamepads. The gamepad hook must outlive the message loop since destroying it stops the hook
+	// thread.
+	if (!Lockdown::ApplyInputs(hwnd))
+	{
+		DestroyWindow(hwnd);
+		return Lockdown::ExitCode_XInputGamepadHookFailure;
+	}
 
-	// Send a timer message every second.
-	SetTimer(hwnd, 42, 1000, NULL);
+	if (OptionConfig.IsPresent() && !Lockdown::Watcher.Start(OptionConfig.Arg1().Chr()))
+		tdPrintf("Couldn't watch config file %s. Changes need a restart.\n", OptionConfig.Arg1().Chr());
 
-	// Hook into gamepad/controller events.
-	if (OptionPadButtons.IsPresent() || OptionAxis.IsPresent())
+	// The message loop also waits on the config watcher. With nothing to wait on it is the same as GetMessage. Startup
+	// is done, so from here on the input hooks, deadlines, and locks must not allocate.
+	HANDLE hWatch = HANDLE(Lockdown::Watcher.GetWaitHandle());
+	DWORD numHandles = (hWatch != INVALID_HANDLE_VALUE) ? 1 : 0;
+	bool quit = false;
+	while (!quit)
 	{
-		auto hook = gamepad::hook::make();
-		hook->set_plug_and_play(true, gamepad::ms(1000));
-		hook->set_sleep_time(gamepad::ms(100)); // 10fps poll.
-		if (OptionPadButtons.IsPresent())
-			hook->set_button_event_handler(Lockdown::Hook_GamepadButton);
-		if (OptionAxis.IsPresent())
-			hook->set_axis_event_handler(Lockdown::Hook_GamepadAxis);
-		hook->set_connect_event_handler(Lockdown::Hook_GamepadConnect);
-		hook->set_disconnect_event_handler(Lockdown::Hook_GamepadDisconnect);
+		Lockdown::SteadyStateScope steadyState;
+		DWORD result = MsgWaitForMultipleObjects(numHandles, &hWatch, FALSE, INFINITE, QS_ALLINPUT);
+		if ((result == WAIT_OBJECT_0) && numHandles && Lockdown::Watcher.Acknowledge())
+			Lockdown::ReloadConfig(hwnd);
 
-		if (!hook->start())
+		MSG msg;
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
-			tdPrintf("Couldn't start gamepad hook.\n");
-			DestroyWindow(hwnd);
-			return Lockdown::ExitCode_XInputGamepadHookFailure;
+			if (msg.message == WM_QUIT)
+			{
+				quit = true;
+				break;
+			}
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
 		}
 	}
 
-  	MSG msg;
-	while (GetMessage(&msg, NULL, 0, 0))
-	{
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
-	}
-
-	// If we get here WM_CLOSE has already handled DestroyWindow.
+	// If we get here WM_CLOSE has already handled DestroyWindow. The hook thread is stopped first so nothing is
+	// written to the trace after it closes.
+	if (Lockdown::PadHook)
+		Lockdown::PadHook->stop();
+	if (Lockdown::hPadNotify)
+		UnregisterDeviceNotification(Lockdown::hPadNotify);
+	Lockdown::Watcher.Stop();
+	Lockdown::DrainPadRing();
+	Lockdown::Trace.Close();
+	Lockdown::Exporter.Stop();
 	return Lockdown::ExitCode_Success;
 }
@@ -0,0 +1,827 @@
+// LockdownBench.cpp
+//
+// Benchmarks for the always-on parts of lockdown. It measures:
+// - throughput of the activity path from one thread and from several producers at once
+// - per-event cost of the mouse distance filter and the gamepad callback path
+// - how long a stick kept moving goes unreported while the axis filter learns its deadzone
+// - timer wakeups per idle hour
+// - resident memory in the same idle configuration as the app
+// - the daemon's session table at 10k sessions: bytes per session, sweep cost, and how late locks are dispatched
+// - heap allocations on the input, deadline, and lock paths once set up, in a LOCKDOWN_COUNT_ALLOCATIONS build
+// Results are written as JSON. Given a baseline, every metric is compared against it and the exit code is non-zero if
+// any got worse by more than its tolerance.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(PLATFORM_LINUX)
+#include <sys/epoll.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <System/tPrint.h>
+#include <System/tCmdLine.h>
+#include <libgamepad.hpp>
+#include "Version.cmake.h"
+#include "IdleEngine.h"
+#include "LockScheduler.h"
+#include "PolicyScheduler.h"
+#include "ActivityCoalescer.h"
+#include "ActivityTrace.h"
+#include "MouseFilter.h"
+#include "SessionTable.h"
+#include "ActivityRing.h"
+#include "Config.h"
+#include "Metrics.h"
+#include "LockAction.h"
+#include "AllocationCounter.h"
+
+
+tCmdLine::tOption OptionHelp				("Display help and usage screen.",			"help",			'h'			);
+tCmdLine::tOption OptionBaseline			("Baseline JSON to compare against.",		"baseline",		'b',	1	);
+tCmdLine::tOption OptionOutput				("Results JSON file.",						"output",		'o',	1	);
+tCmdLine::tOption OptionProducers			("Concurrent producers (max 5).",			"producers",	'p',	1	);
+tCmdLine::tOption OptionEvents				("Events per throughput run in millions.",	"events",		'e',	1	);
+tCmdLine::tOption OptionIdleSeconds			("Seconds to measure idle wakeups over.",	"idle",			'i',	1	);
+tCmdLine::tOption OptionTolerance			("Override all tolerances (percent).",		"tolerance",	't',	1	);
+
+
+namespace Bench
+{
+	using namespace Lockdown;
+	using Clock = std::chrono::steady_clock;
+
+	enum ExitCode
+	{
+		ExitCode_Success,
+		ExitCode_Regression,
+		ExitCode_BadBaseline,
+		ExitCode_OutputFailure
+	};
+
+	// A metric is a regression if it is worse than the baseline by more than both the relative tolerance and the
+	// absolute slack. The slack keeps small integer counts like wakeups from failing on a difference of one.
+	struct Metric
+	{
+		const char* Name;
+		const char* Unit;
+		bool HigherIsBetter;
+		double Tolerance;
+		double Slack;
+		double Value							= 0.0;
+		bool Measured							= false;
+	};
+
+	enum MetricID
+	{
+		MetricID_ActivityEPS,
+		MetricID_ActivityConcurrentEPS,
+		MetricID_MouseFilterP50,
+		MetricID_MouseFilterP99,
+		MetricID_PadCallbackP50,
+		MetricID_PadCallbackP99,
+		MetricID_PadSweepGap,
+		MetricID_SchedulerWakeups,
+		MetricID_ProcessWakeups,
+		MetricID_RSS,
+		MetricID_SessionTableBytes,
+		MetricID_SessionSweep,
+		MetricID_SessionLockLateP99,
+		MetricID_PolicyWakeups,
+		MetricID_PolicyRearm,
+		MetricID_SteadyStateAllocations,
+		MetricID_NumMetrics
+	};
+
+	Metric Metrics[MetricID_NumMetrics] =
+	{
+		{ "activity_eps",						"events/s",		true,	0.25,	0.0		},
+		{ "activity_concurrent_eps",			"events/s",		true,	0.25,	0.0		},
+		{ "mouse_filter_p50_ns",				"ns",			false,	0.50,	5.0		},
+		{ "mouse_filter_p99_ns",				"ns",			false,	0.50,	10.0	},
+		{ "pad_callback_p50_ns",				"ns",			false,	0.50,	5.0		},
+		{ "pad_callback_p99_ns",				"ns",			false,	0.50,	10.0	},
+		{ "pad_sweep_gap_ms",					"ms",			false,	0.0,	20.0	},
+		{ "scheduler_wakeups_per_idle_hour",	"wakeups",		false,	0.0,	1.0		},
+		{ "process_wakeups_per_idle_hour",		"wakeups",		false,	0.20,	720.0	},
+		{ "rss_kb",								"kB",			false,	0.20,	512.0	},
+		{ "session_table_bytes",				"bytes",		false,	0.0,	1.0		},
+		{ "session_sweep_ns",					"ns",			false,	0.50,	0.2		},
+		{ "session_lock_late_p99_ms",			"ms",			false,	0.0,	2.0		},
+		{ "policy_wakeups_per_idle_hour",		"wakeups",		false,	0.0,	1.0		},
+		{ "policy_rearm_ns",					"ns",			false,	0.50,	10.0	},
+		{ "steady_state_allocations",			"allocations",	false,	0.0,	0.0		}
+	};
+
+	void Set(MetricID id, double value)																				{ Metrics[id].Value = value; Metrics[id].Measured = true; }
+
+	// Per-event costs are far below the clock resolution so events are timed in batches and each batch gives one
+	// sample of the average cost per event.
+	const int BatchSize						= 64;
+	const int NumBatches					= 100000;
+	double GetPercentile(std::vector<double>& samples, double percentile);
+
+	void MeasureActivity(int64_t numEvents);
+	void MeasureActivityConcurrent(int64_t numEvents, int numProducers);
+	void MeasureMouseFilter();
+	void MeasurePadCallback();
+	void MeasureSchedulerWakeups();
+
+	// Sweeps a stick through its axis filter for a while and then pushes it part way, and records the longest time it
+	// was moving without a change being reported. The filter learns from the stick at rest, so this stays around the
+	// time a sweep spends turning at each end. A filter that learns the movement itself as drift goes quiet for good.
+	void MeasurePadSweep();
+	const int PadSweepHz					= 250;
+	void MeasureProcessWakeups(int idleSeconds);
+	void MeasureRSS();
+	void MeasureSessions();
+	const int NumSessions					= 10000;
+
+	// The scheduler with every policy stage enabled.
+	void MeasurePolicy();
+	void SetAllStages(PolicyScheduler&);
+
+	// Runs the app's steady-state paths and counts what they allocate. Only measured in a counting build.
+	void MeasureSteadyState();
+
+	// Exposes the protected event functions so the bench can feed a device the way a platform backend does.
+	class BenchDevice : public gamepad::device
+	{
+	public:
+		void Axis(uint16_t nativeID, uint16_t vc, int32_t value, float vv)											{ axis_event(nativeID, vc, value, vv); }
+	};
+
+	bool WriteResults(const char* path);
+	bool Compare(const char* baselinePath, bool& regressed);
+}
+
+
+double Bench::GetPercentile(std::vector<double>& samples, double percentile)
+{
+	if (samples.empty())
+		return 0.0;
+
+	size_t index = std::min(samples.size() - 1, size_t(percentile * double(samples.size())));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+
+void Bench::MeasureActivity(int64_t numEvents)
+{
+	// The path every hook takes. Time is read per event as the hooks do. Mouse movement is the busiest source by far.
+	IdleEngine engine;
+	ActivityCoalescer coalescer(engine);
+	Clock::time_point start = Clock::now();
+	for (int64_t e = 0; e < numEvents; e++)
+		coalescer.Report(ActivitySource_MouseMove);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	Set(MetricID_ActivityEPS, double(numEvents) / seconds);
+}
+
+
+void Bench::MeasureActivityConcurrent(int64_t numEvents, int numProducers)
+{
+	// Each producer owns a source, just like the keyboard, mouse, and gamepad hook threads do. The window is zero so
+	// every event is published to the one shared engine, which is the contended case.
+	IdleEngine engine;
+	ActivityCoalescer coalescer(engine);
+	coalescer.SetWindows(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> producers;
+	int64_t perProducer = numEvents / numProducers;
+	for (int p = 0; p < numProducers; p++)
+	{
+		producers.emplace_back
+		(
+			[&coalescer, &go, perProducer, p]()
+			{
+				ActivitySource source = ActivitySource(p);
+				while (!go.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				for (int64_t e = 0; e < perProducer; e++)
+					coalescer.Report(source);
+			}
+		);
+	}
+
+	Clock::time_point start = Clock::now();
+	go.store(true, std::memory_order_release);
+	for (std::thread& producer : producers)
+		producer.join();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	Set(MetricID_ActivityConcurrentEPS, double(perProducer * numProducers) / seconds);
+}
+
+
+void Bench::MeasureMouseFilter()
+{
+	// The Windows mouse hook body. The window is zero so every event reaches the distance check, which is the worst
+	// case. The pointer wanders in small steps so some moves pass the threshold and some do not.
+	IdleEngine engine;
+	ActivityCoalescer coalescer(engine);
+	coalescer.SetWindows(0);
+	MouseFilter filter(20);
+
+	std::vector<double> samples;
+	samples.reserve(NumBatches);
+	uint32_t rng = 12345;
+	int x = 0, y = 0;
+	for (int b = 0; b < NumBatches; b++)
+	{
+		Clock::time_point start = Clock::now();
+		for (int e = 0; e < BatchSize; e++)
+		{
+			rng = rng*1664525u + 1013904223u;
+			x += int((rng >> 24) & 7) - 3;
+			y += int((rng >> 16) & 7) - 3;
+			if (!coalescer.TryCoalesce(ActivitySource_MouseMove, GetTimeMs()) && filter.Update(x, y))
+				coalescer.Report(ActivitySource_MouseMove);
+		}
+		samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BatchSize);
+	}
+
+	Set(MetricID_MouseFilterP50, GetPercentile(samples, 0.50));
+	Set(MetricID_MouseFilterP99, GetPercentile(samples, 0.99));
+}
+
+
+void Bench::MeasurePadCallback()
+{
+	// Everything from a backend reporting an axis change to the coalescer seeing it: the device updating its state and
+	// appending to the event batch, the hook delivering the batch, and a handler shaped like the app's with tracing off.
+	// Batches are the size of a busy poll cycle.
+	struct Context
+	{
+		ActivityCoalescer* Coalescer;
+		ActivityTraceWriter* Trace;
+	};
+	gamepad::batch_callback handler = [](const gamepad::device_event* events, size_t count, void* user)
+	{
+		Context* context = static_cast<Context*>(user);
+		for (size_t e = 0; e < count; e++)
+		{
+			const gamepad::input_event& ev = events[e].event;
+			context->Trace->WritePad(TraceType_PadAxis, events[e].device_index, ev.native_id, ev.vc, ev.value, ev.time);
+		}
+		context->Coalescer->Report(ActivitySource_PadAxis);
+	};
+
+	IdleEngine engine;
+	ActivityCoalescer coalescer(engine);
+	ActivityTraceWriter trace;
+	Context context = { &coalescer, &trace };
+	gamepad::event_batch batch;
+	batch.set_callback(handler, &context);
+
+	BenchDevice device;
+	device.set_batch(&batch);
+	const int eventsPerCycle = 8;
+	std::vector<double> samples;
+	samples.reserve(NumBatches);
+	for (int b = 0; b < NumBatches; b++)
+	{
+		Clock::time_point start = Clock::now();
+		for (int e = 0; e < BatchSize; e++)
+		{
+			uint16_t axis = uint16_t(gamepad::axis::LEFT_STICK_X + (e & 3));
+			int32_t value = (e * 97) & 0x7FFF;
+			device.Axis(uint16_t(e & 3), axis, value, float(value) / 32767.0f);
+			if ((e % eventsPerCycle) == (eventsPerCycle - 1))
+				batch.flush();
+		}
+		batch.flush();
+		samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BatchSize);
+	}
+
+	Set(MetricID_PadCallbackP50, GetPercentile(samples, 0.50));
+	Set(MetricID_PadCallbackP99, GetPercentile(samples, 0.99));
+}
+
+
+void Bench::MeasurePadSweep()
+{
+	// The default deadzone of a stick. A quick wide sweep, a slow full-range one, a rest, and then a push to about a
+	// tenth of the range that has to get through whatever was learned.
+	gamepad::axis_filter filter;
+	filter.configure(0, 100);
+	filter.seed(0, 0);
+	struct Segment { double Seconds; double Amplitude; double Hz; bool Moving; };
+	const Segment segments[] =
+	{
+		{ 10.0,		6000.0,		0.5,	true	},
+		{ 10.0,		20000.0,	0.1,	true	},
+		{ 1.0,		0.0,		0.0,	false	},
+		{ 1.0,		3000.0,		0.0,	true	}
+	};
+
+	const double twoPi = 6.283185307179586;
+	int16_t values[8] = { };
+	double maxGapMs = 0.0;
+	for (const Segment& segment : segments)
+	{
+		int numSamples = int(segment.Seconds * PadSweepHz);
+		int lastReport = 0;
+		for (int s = 1; s <= numSamples; s++)
+		{
+			double t = double(s) / PadSweepHz;
+			double value = segment.Amplitude * ((segment.Hz > 0.0) ? std::sin(twoPi * segment.Hz * t) : 1.0);
+			values[0] = int16_t(std::lround(value));
+			if (filter.filter(values, 8) & 1)
+				lastReport = s;
+			// A stick held still only has its first change to report.
+			bool held = (segment.Hz == 0.0) && lastReport;
+			if (segment.Moving && !held)
+				maxGapMs = std::max(maxGapMs, double(s - lastReport) * 1000.0 / PadSweepHz);
+		}
+	}
+	Set(MetricID_PadSweepGap, maxGapMs);
+}
+
+
+void Bench::MeasureSchedulerWakeups()
+{
+	// An hour with no input on a virtual clock, firing the deadline timer exactly when it is armed for.
+	IdleEngine engine;
+	PolicyScheduler scheduler(engine);
+	int64_t startMs = 0;
+	int64_t endMs = startMs + 60*60*1000;
+	int64_t deadlineMs = 0;
+	engine.Restart(startMs);
+	scheduler.Update(startMs, deadlineMs);
+	int64_t numStartUpdates = scheduler.GetNumUpdates();
+	while (deadlineMs <= endMs)
+		scheduler.Update(deadlineMs, deadlineMs);
+	Set(MetricID_SchedulerWakeups, double(scheduler.GetNumUpdates() - numStartUpdates));
+}
+
+
+#if defined(PLATFORM_LINUX)
+namespace Bench
+{
+	// Sum of voluntary and involuntary context switches over every thread in the process. Each time a blocked thread
+	// wakes it counts at least once.
+	int64_t GetNumContextSwitches();
+}
+
+
+int64_t Bench::GetNumContextSwitches()
+{
+	int64_t total = 0;
+	DIR* dir = opendir("/proc/self/task");
+	if (!dir)
+		return 0;
+
+	while (dirent* entry = readdir(dir))
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+
+		std::ifstream status(std::string("/proc/self/task/") + entry->d_name + "/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if ((line.rfind("voluntary_ctxt_switches:", 0) == 0) || (line.rfind("nonvoluntary_ctxt_switches:", 0) == 0))
+				total += std::stoll(line.substr(line.find(':') + 1));
+		}
+	}
+	closedir(dir);
+	return total;
+}
+#endif
+
+
+void Bench::MeasureProcessWakeups(int idleSeconds)
+{
+	#if defined(PLATFORM_LINUX)
+	// The app's idle setup: the deadline timer on an epoll set and the gamepad hook with hotplug. Evdev input is left
+	// out since opening it needs the input group. Nothing is touched while measuring.
+	std::shared_ptr<gamepad::hook> hook = gamepad::hook::make();
+	hook->set_hotplug(true);
+	hook->set_plug_and_play(true, gamepad::ms(1000));
+	bool hookRunning = hook->start();
+
+	IdleEngine engine;
+	PolicyScheduler scheduler(engine);
+	DeadlineTimer timer;
+	int epollFD = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event ev = { };
+	ev.events = EPOLLIN;
+	ev.data.fd = timer.GetFD();
+	epoll_ctl(epollFD, EPOLL_CTL_ADD, timer.GetFD(), &ev);
+
+	int64_t deadlineMs = 0;
+	engine.Restart(GetTimeMs());
+	scheduler.Update(GetTimeMs(), deadlineMs);
+	timer.Arm(deadlineMs);
+
+	// Let the hook thread finish its initial device scan before counting.
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	int64_t startSwitches = GetNumContextSwitches();
+	int64_t endMs = GetTimeMs() + int64_t(idleSeconds)*1000;
+	for (int64_t nowMs = GetTimeMs(); nowMs < endMs; nowMs = GetTimeMs())
+	{
+		epoll_event events[1];
+		if (epoll_wait(epollFD, events, 1, int(endMs - nowMs)) > 0)
+		{
+			timer.Acknowledge();
+			scheduler.Update(GetTimeMs(), deadlineMs);
+			timer.Arm(deadlineMs);
+		}
+	}
+
+	// One of the switches is the end of the measuring wait itself.
+	int64_t numSwitches = std::max(GetNumContextSwitches() - startSwitches - 1, int64_t(0));
+	Set(MetricID_ProcessWakeups, double(numSwitches) * 3600.0 / double(idleSeconds));
+
+	// Memory is measured here while the idle setup is still alive and before any big sample buffers exist.
+	MeasureRSS();
+
+	close(epollFD);
+	if (hookRunning)
+		hook->stop();
+	#else
+	// Context switch counts are not available per process on Windows without ETW.
+	(void)idleSeconds;
+	MeasureRSS();
+	#endif
+}
+
+
+void Bench::SetAllStages(PolicyScheduler& scheduler)
+{
+	scheduler.SetStage(PolicyStage_Warn, true, -30*1000);
+	scheduler.SetStage(PolicyStage_Blank, true, -10*1000);
+	scheduler.SetStage(PolicyStage_Logout, true, 5*60*1000);
+}
+
+
+void Bench::MeasurePolicy()
+{
+	// Idle wakeups should be one per stage performed and no more. With the default timeout a countdown runs from the
+	// restart at one logout to the next, so an hour holds two and a bit of them.
+	IdleEngine engine;
+	PolicyScheduler scheduler(engine);
+	SetAllStages(scheduler);
+	int64_t endMs = 60*60*1000;
+	int64_t deadlineMs = 0;
+	engine.Restart(0);
+	scheduler.Update(0, deadlineMs);
+	int64_t numStartUpdates = scheduler.GetNumUpdates();
+	while (deadlineMs <= endMs)
+		scheduler.Update(deadlineMs, deadlineMs);
+	Set(MetricID_PolicyWakeups, double(scheduler.GetNumUpdates() - numStartUpdates));
+
+	// The cost of the wakeup after activity has moved the deadline, which re-arms every stage. The time moves on by a
+	// few milliseconds each update so timers land in different slots and levels.
+	std::vector<double> samples;
+	samples.reserve(NumBatches / 10);
+	int64_t nowMs = 0;
+	engine.Restart(nowMs);
+	for (int b = 0; b < NumBatches / 10; b++)
+	{
+		Clock::time_point start = Clock::now();
+		for (int e = 0; e < BatchSize; e++)
+		{
+			nowMs += 7;
+			engine.ReportActivity(nowMs);
+			scheduler.Update(nowMs, deadlineMs);
+		}
+		samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / BatchSize);
+	}
+	Set(MetricID_PolicyRearm, GetPercentile(samples, 0.50));
+}
+
+
+void Bench::MeasureSteadyState()
+{
+	if (!IsCountingAllocations())
+		return;
+
+	// Everything is set up first, as the app does at startup. Any allocation after that is a regression.
+	IdleEngine engine;
+	ActivityCoalescer coalescer(engine);
+	coalescer.SetWindows(0);
+	PolicyScheduler scheduler(engine);
+	SetAllStages(scheduler);
+	MouseFilter filter(20);
+	ConfigStore config;
+	LockAction locker(LockBackend_Simulated);
+	static MetricsRegistry metrics;
+	static ActivityRing ring;
+
+	#if defined(PLATFORM_WINDOWS)
+	const char* nullPath = "NUL";
+	#else
+	const char* nullPath = "/dev/null";
+	#endif
+	ActivityTraceWriter trace;
+	trace.Open(nullPath, TraceConfig());
+
+	// The gamepad hook thread's side, a device feeding a batch whose handler pushes to the ring.
+	gamepad::batch_callback handler = [](const gamepad::device_event* events, size_t count, void* user)
+	{
+		ActivityRing* ring = static_cast<ActivityRing*>(user);
+		for (size_t e = 0; e < count; e++)
+		{
+			ActivityRecord record = { };
+			record.EventTime	= events[e].event.time;
+			record.Value		= events[e].event.value;
+			record.NativeID		= events[e].event.native_id;
+			record.VC			= events[e].event.vc;
+			record.Source		= uint8_t(ActivitySource_PadAxis);
+			record.Type			= uint8_t(TraceType_PadAxis);
+			ring->Push(record);
+		}
+		ring->Publish();
+	};
+	gamepad::event_batch batch;
+	batch.set_callback(handler, &ring);
+	BenchDevice device;
+	device.set_batch(&batch);
+
+	SetAbortOnSteadyStateAllocation(false);
+	uint64_t numAllocations = GetNumSteadyStateAllocations();
+	{
+		SteadyStateScope steadyState;
+		int64_t nowMs = 0;
+		int64_t deadlineMs = 0;
+		engine.Restart(nowMs);
+		scheduler.Update(nowMs, deadlineMs);
+
+		// Mouse, keyboard, and pad input, with the schedule re-evaluated as often as the Windows tooltip does.
+		for (int e = 0; e < NumBatches; e++)
+		{
+			nowMs += 7;
+			int x = (e * 13) & 255;
+			int y = (e * 7) & 255;
+			trace.WriteMousePos(x, y);
+			if (ConfigReader(config)->IsSourceEnabled(ActivitySource_MouseMove) && filter.Update(x, y))
+				coalescer.Report(ActivitySource_MouseMove, nowMs);
+			trace.WriteKey(e & 127, (e & 1) == 0);
+			coalescer.ReportKey(e & 127, (e & 1) == 0, nowMs);
+
+			int32_t value = (e * 97) & 0x7FFF;
+			uint16_t axis = uint16_t(gamepad::axis::LEFT_STICK_X + (e & 3));
+			device.Axis(uint16_t(e & 3), axis, value, float(value) / 32767.0f);
+			batch.flush();
+			ring.Drain
+			(
+				[&](const ActivityRecord& record)
+				{
+					TraceType type = TraceType(record.Type);
+					trace.WritePad(type, record.Device, record.NativeID, record.VC, record.Value, record.EventTime);
+					coalescer.Report(ActivitySource(record.Source), nowMs);
+				}
+			);
+			metrics.Increment(Counter_TimerWakeups);
+			scheduler.Update(nowMs, deadlineMs);
+		}
+
+		// Then idle, so every stage fires in turn and the lock is issued and confirmed.
+		for (int w = 0; w < 8; w++)
+		{
+			metrics.RecordTimerWakeup(0);
+			nowMs = deadlineMs;
+			scheduler.Update(nowMs, deadlineMs);
+		}
+		LockResult result = locker.Issue(GetTimeUs());
+		metrics.RecordLockIssued(locker.GetIssueLatencyUs());
+		for (int wait = 0; (result == LockResult_None) && (wait < 1000); wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			result = locker.Update();
+		}
+		if (result == LockResult_Confirmed)
+			metrics.RecordLockConfirmed(locker.GetConfirmLatencyUs());
+	}
+	numAllocations = GetNumSteadyStateAllocations() - numAllocations;
+	SetAbortOnSteadyStateAllocation(true);
+	trace.Close();
+	Set(MetricID_SteadyStateAllocations, double(numAllocations));
+}
+
+
+void Bench::MeasureRSS()
+{
+	#if defined(PLATFORM_WINDOWS)
+	PROCESS_MEMORY_COUNTERS counters = { };
+	if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		Set(MetricID_RSS, double(counters.WorkingSetSize) / 1024.0);
+	#elif defined(PLATFORM_LINUX)
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.rfind("VmRSS:", 0) == 0)
+		{
+			Set(MetricID_RSS, double(std::stoll(line.substr(6))));
+			break;
+		}
+	}
+	#endif
+}
+
+
+void Bench::MeasureSessions()
+{
+	// Memory is what the table has allocated, padding and all, when sized for the sessions up front as the daemon's
+	// steady state is. The daemon's session names and lookup map come on top.
+	SessionTable table(2000);
+	table.Reserve(NumSessions);
+	for (int s = 0; s < NumSessions; s++)
+		table.Add(0);
+	Set(MetricID_SessionTableBytes, double(table.GetNumBytesAllocated()) / double(NumSessions));
+
+	// A sweep with nothing due, which is the cost paid for every session on every wakeup.
+	const int numSweeps = 2000;
+	std::vector<int> due;
+	due.reserve(NumSessions);
+	volatile int64_t earliest = 0;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < numSweeps; i++)
+		earliest = table.CollectDue(int64_t(i & 1), due);
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	Set(MetricID_SessionSweep, ns / (double(numSweeps) * double(NumSessions)));
+
+	#if defined(PLATFORM_LINUX)
+	// Lock accuracy on the real clock. The first deadlines are spread over two seconds and every session then locks
+	// each timeout, so the deadline timer fires with anything from one to a few dozen sessions due. Lateness is the
+	// time from a session's deadline to its lock being dispatched, sweep included.
+	DeadlineTimer timer;
+	int64_t nowMs = GetTimeMs();
+	for (int s = 0; s < NumSessions; s++)
+		table.SetRemaining(s, nowMs, 200 + int64_t(s) * 2000 / NumSessions);
+
+	std::vector<double> samples;
+	samples.reserve(3*NumSessions);
+	int64_t endMs = nowMs + 5000;
+	int64_t deadlineMs = table.CollectDue(nowMs, due);
+	while (deadlineMs < endMs)
+	{
+		timer.Arm(deadlineMs);
+		pollfd pfd = { timer.GetFD(), POLLIN, 0 };
+		if (poll(&pfd, 1, -1) <= 0)
+			break;
+		timer.Acknowledge();
+
+		nowMs = GetTimeMs();
+		due.clear();
+		deadlineMs = table.CollectDue(nowMs, due);
+		for (int s : due)
+		{
+			int64_t lockDeadlineMs = table.GetNextDeadline(s);
+			int64_t nextMs;
+			if (table.Update(s, nowMs, nextMs) == LockScheduler::Action::Lock)
+				samples.push_back(double(GetTimeMs() - lockDeadlineMs));
+			deadlineMs = std::min(deadlineMs, nextMs);
+		}
+	}
+	Set(MetricID_SessionLockLateP99, GetPercentile(samples, 0.99));
+	#endif
+}
+
+
+bool Bench::WriteResults(const char* path)
+{
+	json11::Json::object metrics;
+	for (const Metric& metric : Metrics)
+	{
+		if (metric.Measured)
+			metrics[metric.Name] = metric.Value;
+	}
+
+	json11::Json::object root;
+	char version[32];
+	tsPrintf(version, sizeof(version), "%d.%d.%d", LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision);
+	root["version"] = version;
+	root["hardware_threads"] = int(std::thread::hardware_concurrency());
+	root["metrics"] = metrics;
+
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << json11::Json(root).dump() << "\n";
+	return bool(file);
+}
+
+
+bool Bench::Compare(const char* baselinePath, bool& regressed)
+{
+	std::ifstream file(baselinePath);
+	if (!file)
+		return false;
+	std::stringstream contents;
+	contents << file.rdbuf();
+
+	std::string error;
+	json11::Json baseline = json11::Json::parse(contents.str(), error);
+	if (!error.empty() || !baseline["metrics"].is_object())
+		return false;
+
+	double toleranceOverride = OptionTolerance.IsPresent() ? OptionTolerance.Arg1().AsDouble() / 100.0 : -1.0;
+	regressed = false;
+	tPrintf("\n%-34s %14s %14s %8s\n", "Metric", "Baseline", "Current", "Change");
+	for (const Metric& metric : Metrics)
+	{
+		const json11::Json& base = baseline["metrics"][metric.Name];
+		if (!metric.Measured || !base.is_number())
+			continue;
+
+		// Positive change is always an improvement.
+		double baseValue = base.number_value();
+		double delta = metric.HigherIsBetter ? metric.Value - baseValue : baseValue - metric.Value;
+		double tolerance = (toleranceOverride >= 0.0) ? toleranceOverride : metric.Tolerance;
+		double allowed = std::max(tolerance * std::fabs(baseValue), metric.Slack);
+		bool worse = delta < -allowed;
+		regressed |= worse;
+
+		double percent = (baseValue != 0.0) ? 100.0 * delta / std::fabs(baseValue) : 0.0;
+		tPrintf("%-34s %14.1f %14.1f %+7.1f%% %s\n", metric.Name, baseValue, metric.Value, percent, worse ? "REGRESSED" : "");
+	}
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	tCmdLine::tParse(argc, argv);
+	if (OptionHelp.IsPresent())
+	{
+		tCmdLine::tPrintUsage
+		(
+			u8"Tristan Grimmer",
+			u8""
+			"Benchmarks the activity path, input filters, idle wakeups, and memory use of lockdown. "
+			"Results are written as JSON. With a baseline the results are compared and the exit code "
+			"is non-zero if anything regressed beyond its tolerance.",
+			LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision
+		);
+		return Bench::ExitCode_Success;
+	}
+
+	int numProducers = OptionProducers.IsPresent() ? OptionProducers.Arg1().AsInt() : 4;
+	numProducers = std::clamp(numProducers, 1, int(Lockdown::ActivitySource_NumSources));
+	int64_t numEvents = OptionEvents.IsPresent() ? int64_t(OptionEvents.Arg1().AsInt()) * 1000000 : 20000000;
+	if (numEvents <= 0)
+		numEvents = 20000000;
+	int idleSeconds = OptionIdleSeconds.IsPresent() ? OptionIdleSeconds.Arg1().AsInt() : 10;
+	if (idleSeconds <= 0)
+		idleSeconds = 10;
+
+	// Idle first so the memory figure is taken before the sample buffers are allocated.
+	Bench::MeasureProcessWakeups(idleSeconds);
+	Bench::MeasureSchedulerWakeups();
+	Bench::MeasureActivity(numEvents);
+	Bench::MeasureActivityConcurrent(numEvents, numProducers);
+	Bench::MeasureMouseFilter();
+	Bench::MeasurePadCallback();
+	Bench::MeasurePadSweep();
+	Bench::MeasureSessions();
+	Bench::MeasurePolicy();
+	Bench::MeasureSteadyState();
+
+	for (const Bench::Metric& metric : Bench::Metrics)
+	{
+		if (metric.Measured)
+			tPrintf("%-34s %14.1f %s\n", metric.Name, metric.Value, metric.Unit);
+	}
+
+	tString outputPath = OptionOutput.IsPresent() ? OptionOutput.Arg1() : tString("lockdown_bench.json");
+	if (!Bench::WriteResults(outputPath.Chr()))
+	{
+		tPrintf("Couldn't write results to %s.\n", outputPath.Chr());
+		return Bench::ExitCode_OutputFailure;
+	}
+
+	if (!OptionBaseline.IsPresent())
+		return Bench::ExitCode_Success;
+
+	bool regressed = false;
+	if (!Bench::Compare(OptionBaseline.Arg1().Chr(), regressed))
+	{
+		tPrintf("Couldn't read baseline %s.\n", OptionBaseline.Arg1().Chr());
+		return Bench::ExitCode_BadBaseline;
+	}
+	return regressed ? Bench::ExitCode_Regression : Bench::ExitCode_Success;
+}
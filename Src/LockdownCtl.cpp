@@ -0,0 +1,133 @@
+// LockdownCtl.cpp
+//
+// Command line client for the control socket of a running Linux lockdown. It sends one command, prints the reply, and
+// exits, so scripts and agents can lock, suspend, resume, or retime a session without starting another lockdown or
+// going through a menu. It links nothing but the control code so a call costs little more than the exec. Usage:
+//
+// lockdownctl [-n name] [-w milliseconds] command [seconds]
+//
+// Commands are status, lock, suspend, resume, remaining seconds (lock in that many seconds), and timeout seconds. The
+// name defaults to the one a lockdown started in this login session binds. -w is how long to wait for the reply. The
+// exit code is 0 if the command was carried out, 1 if it was refused, and 2 if no lockdown answered.
+//
+// watch is for status bars. It prints the status text, such as "Lock in 12 minutes", and then a new line each time the
+// text changes, until the lockdown exits. Then it exits with 2. Nothing is polled. Lockdown sends each change as it
+// happens.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "Control.h"
+
+
+namespace Ctl
+{
+	enum ExitCode
+	{
+		ExitCode_Success,
+		ExitCode_Refused,
+		ExitCode_NoReply,
+		ExitCode_Usage
+	};
+
+	int PrintUsage();
+
+	// Prints each status line that differs from the one before. Renewals are answered with the same text again.
+	bool PrintStatus(const char* text);
+	char LastStatus[Lockdown::MaxControlMessage]	= { };
+	bool WatchRefused								= false;
+}
+
+
+int Ctl::PrintUsage()
+{
+	fprintf
+	(
+		stderr,
+		"Usage: lockdownctl [-n name] [-w milliseconds] command [seconds]\n"
+		"Commands: status, lock, suspend, resume, remaining seconds, timeout seconds, watch.\n"
+	);
+	return ExitCode_Usage;
+}
+
+
+bool Ctl::PrintStatus(const char* text)
+{
+	if (strncmp(text, "error ", 6) == 0)
+	{
+		fputs(text, stderr);
+		WatchRefused = true;
+		return false;
+	}
+
+	if (strcmp(text, LastStatus) == 0)
+		return true;
+	snprintf(LastStatus, sizeof(LastStatus), "%s", text);
+
+	// Flushed since a status bar reads this through a pipe and would otherwise see nothing until the buffer filled.
+	fputs(text, stdout);
+	fflush(stdout);
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string name = Lockdown::GetControlName();
+	int timeoutMs = 1000;
+	int arg = 1;
+	for (; (arg < argc) && (argv[arg][0] == '-'); arg++)
+	{
+		if ((strcmp(argv[arg], "-n") == 0) && (arg + 1 < argc))
+			name = argv[++arg];
+		else if ((strcmp(argv[arg], "-w") == 0) && (arg + 1 < argc))
+			timeoutMs = atoi(argv[++arg]);
+		else
+			return Ctl::PrintUsage();
+	}
+	if (arg >= argc)
+		return Ctl::PrintUsage();
+
+	// The rest of the arguments are the request. Checked here so a typo gets the usage rather than a refusal.
+	std::string request;
+	for (; arg < argc; arg++)
+	{
+		if (!request.empty())
+			request += ' ';
+		request += argv[arg];
+	}
+	Lockdown::ControlRequest parsed;
+	if (!Lockdown::ParseControlRequest(request.c_str(), int(request.size()), parsed))
+		return Ctl::PrintUsage();
+
+	if (parsed.Command == Lockdown::ControlCommand_Watch)
+	{
+		if (Lockdown::WatchControl(name.c_str(), Ctl::PrintStatus, timeoutMs))
+			return Ctl::WatchRefused ? Ctl::ExitCode_Refused : Ctl::ExitCode_Success;
+		if (!Ctl::LastStatus[0])
+			fprintf(stderr, "No lockdown is answering on %s.\n", name.c_str());
+		return Ctl::ExitCode_NoReply;
+	}
+
+	std::string reply;
+	if (!Lockdown::SendControlRequest(name.c_str(), request.c_str(), reply, timeoutMs))
+	{
+		fprintf(stderr, "No lockdown is answering on %s.\n", name.c_str());
+		return Ctl::ExitCode_NoReply;
+	}
+
+	fputs(reply.c_str(), stdout);
+	return (reply.compare(0, 3, "ok ") == 0) ? Ctl::ExitCode_Success : Ctl::ExitCode_Refused;
+}
@@ -0,0 +1,636 @@
+// LockdownDaemon.cpp
+//
+// Headless Linux daemon that enforces the idle lock on every logind session on the machine from one process. It is
+// meant for shared hosts with many graphical sessions and seats, where a lockdown per session would cost a process and
+// its wakeups each. Sessions are discovered from the logind session files and kept up to date with inotify. Their idle
+// state lives in a struct-of-arrays SessionTable and one deadline timer is armed for the earliest deadline of them all.
+// Nothing is read while a session's countdown is running. When a deadline is reached the session is probed for the
+// last activity logind knows about (the idle hint for graphical sessions, the terminal access time for text ones), and
+// it is locked with loginctl only if there was none since the countdown started. Asking logind means running loginctl,
+// so those probes run in the background and the session is swept again when the answer comes in. With no activity at
+// all there are a couple of wakeups per session per timeout. Needs to run as root to lock other users' sessions.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <System/tPrint.h>
+#include <System/tCmdLine.h>
+#include "Version.cmake.h"
+#include "IdleEngine.h"
+#include "LockScheduler.h"
+#include "SessionTable.h"
+
+
+tCmdLine::tOption OptionHelp				("Display help and usage screen.",		"help",			'h'			);
+tCmdLine::tOption OptionSyntax				("Display CLI syntax guide.",			"syntax",		'y'			);
+tCmdLine::tOption OptionTimeoutMinutes		("Timeout in minutes.",					"minutes",		'm',	1	);
+tCmdLine::tOption OptionTimeoutSeconds		("Timeout in seconds.",					"seconds",		's',	1	);
+tCmdLine::tOption OptionSessionDir			("Directory of logind session files.",	"sessions",		'd',	1	);
+tCmdLine::tOption OptionDryRun				("Print locks instead of locking.",		"dryrun",		'n'			);
+
+
+extern char** environ;
+
+
+namespace Daemon
+{
+	using namespace Lockdown;
+
+	enum ExitCode
+	{
+		ExitCode_Success,
+		ExitCode_EpollFailure,
+		ExitCode_TimerFailure,
+		ExitCode_SessionDirFailure
+	};
+
+	// How a session's last activity is found when its deadline comes up.
+	enum ProbeType : uint8_t
+	{
+		ProbeType_IdleHint,						// Ask logind. Graphical sessions report idleness to it.
+		ProbeType_TTY							// The access time of the session's terminal, which input updates.
+	};
+
+	// An idle hint probe in progress. Probes are keyed by session name since indices move when sessions end.
+	struct IdleProbe
+	{
+		std::string Session;
+		pid_t PID;
+		int FD;																	// Closed and -1 once all output is in.
+		int64_t StartMs;
+		std::string Output;
+	};
+
+	// A probe that takes longer than this is abandoned and the session treated as idle.
+	const int64_t ProbeTimeoutMs			= 5000;
+
+	std::string SessionDir					= "/run/systemd/sessions";
+	bool DryRun								= false;
+	int EpollFD								= -1;
+	SessionTable Table;
+
+	// Per-session data the sweep never touches, indexed the same as the table.
+	std::vector<std::string> Names;
+	std::vector<std::string> TTYs;
+	std::vector<uint8_t> Probes;
+	std::unordered_map<std::string, int> SessionIndices;
+	std::vector<int> DueSessions;
+	std::vector<IdleProbe> IdleProbes;
+	std::vector<pid_t> ProbePIDs;												// Probe children not reaped yet.
+	uint64_t NumLocks						= 0;
+
+	// Re-reads the session directory, adding new sessions and removing ones that have ended.
+	void ScanSessions(int64_t nowMs);
+	bool ReadSessionFile(const std::string& name, std::string& tty, ProbeType&);
+	void AddSession(const std::string& name, const std::string& tty, ProbeType, int64_t nowMs);
+	void RemoveSession(int session);
+
+	// Sets activityMs to the time of the last activity logind knows of for the session in GetTimeMs time, or INT64_MIN
+	// if unknown, and returns true. Returns false if the answer isn't in yet, in which case the session should be
+	// swept again by probeDeadlineMs or when ReadProbe says a probe finished, whichever comes first.
+	bool ProbeLastActivity(int session, int64_t nowMs, int64_t& activityMs, int64_t& probeDeadlineMs);
+	bool StartIdleHintProbe(const std::string& name, int64_t nowMs);
+	int64_t ParseIdleHint(const std::string& output, int64_t nowMs);
+	void CancelIdleHintProbe(std::vector<IdleProbe>::iterator);
+
+	// Reads what a probe's loginctl has written to fd. Returns true if it has finished.
+	bool ReadProbe(int fd);
+
+	// Approximate memory in use per session, including names and the lookup map.
+	size_t GetBytesPerSession();
+
+	// Locks any due sessions that have been idle for the whole timeout. Returns the next deadline to arm for.
+	int64_t Sweep(int64_t nowMs);
+
+	// Starts loginctl to lock one session. It is not waited for. Finished children are reaped on SIGCHLD.
+	void LockSession(int session);
+	void ReapChildren();
+}
+
+
+void Daemon::ScanSessions(int64_t nowMs)
+{
+	DIR* dir = opendir(SessionDir.c_str());
+	if (!dir)
+		return;
+
+	std::vector<uint8_t> seen(Names.size(), 0);
+	while (dirent* entry = readdir(dir))
+	{
+		// logind writes a temporary file and renames it into place, so names with a dot are skipped.
+		if (strchr(entry->d_name, '.'))
+			continue;
+
+		std::string name = entry->d_name;
+		auto existing = SessionIndices.find(name);
+		if (existing != SessionIndices.end())
+		{
+			seen[existing->second] = 1;
+			continue;
+		}
+
+		std::string tty;
+		ProbeType probe = ProbeType_IdleHint;
+		if (ReadSessionFile(name, tty, probe))
+			AddSession(name, tty, probe, nowMs);
+	}
+	closedir(dir);
+
+	// Highest index first. A removal moves the last session down, and by then the last one is either still present or
+	// was just added, so nothing that has ended is ever moved below the scan.
+	for (int s = int(seen.size()) - 1; s >= 0; s--)
+	{
+		if (seen[s])
+			continue;
+		tdPrintf("Session %s ended.\n", Names[s].c_str());
+		RemoveSession(s);
+	}
+}
+
+
+bool Daemon::ReadSessionFile(const std::string& name, std::string& tty, ProbeType& probe)
+{
+	std::ifstream file(SessionDir + "/" + name);
+	if (!file)
+		return false;
+
+	// Only user sessions are locked. Greeters, lock screens, and background sessions are left alone.
+	std::string sessionClass, type, line;
+	while (std::getline(file, line))
+	{
+		size_t eq = line.find('=');
+		if (eq == std::string::npos)
+			continue;
+		std::string key = line.substr(0, eq);
+		if (key == "CLASS")
+			sessionClass = line.substr(eq + 1);
+		else if (key == "TYPE")
+			type = line.substr(eq + 1);
+		else if (key == "TTY")
+			tty = line.substr(eq + 1);
+	}
+
+	if (sessionClass.rfind("user", 0) != 0)
+		return false;
+
+	// Input to a graphical session goes to the compositor rather than its terminal, so the access time means nothing.
+	bool graphical = (type == "x11") || (type == "wayland") || (type == "mir");
+	probe = (graphical || tty.empty()) ? ProbeType_IdleHint : ProbeType_TTY;
+	return true;
+}
+
+
+void Daemon::AddSession(const std::string& name, const std::string& tty, ProbeType probe, int64_t nowMs)
+{
+	// A new session starts its countdown when it is first seen, just as the app does when it starts.
+	int session = Table.Add(nowMs);
+	Names.push_back(name);
+	TTYs.push_back(tty);
+	Probes.push_back(probe);
+	SessionIndices[name] = session;
+	tdPrintf("Session %s started.%s%s\n", name.c_str(), tty.empty() ? "" : " TTY ", tty.c_str());
+}
+
+
+void Daemon::RemoveSession(int session)
+{
+	for (auto probe = IdleProbes.begin(); probe != IdleProbes.end(); ++probe)
+	{
+		if (probe->Session == Names[session])
+		{
+			CancelIdleHintProbe(probe);
+			break;
+		}
+	}
+
+	SessionIndices.erase(Names[session]);
+	int moved = Table.Remove(session);
+	if (moved >= 0)
+	{
+		Names[session] = std::move(Names[moved]);
+		TTYs[session] = std::move(TTYs[moved]);
+		Probes[session] = Probes[moved];
+		SessionIndices[Names[session]] = session;
+	}
+	Names.pop_back();
+	TTYs.pop_back();
+	Probes.pop_back();
+}
+
+
+bool Daemon::ProbeLastActivity(int session, int64_t nowMs, int64_t& activityMs, int64_t& probeDeadlineMs)
+{
+	activityMs = std::numeric_limits<int64_t>::min();
+	if (Probes[session] == ProbeType_IdleHint)
+	{
+		auto probe = IdleProbes.begin();
+		while ((probe != IdleProbes.end()) && (probe->Session != Names[session]))
+			++probe;
+
+		// A probe that can't be started is no answer, the same as one that fails.
+		if (probe == IdleProbes.end())
+		{
+			if (!StartIdleHintProbe(Names[session], nowMs))
+				return true;
+			probeDeadlineMs = nowMs + ProbeTimeoutMs;
+			return false;
+		}
+
+		if (probe->FD >= 0)
+		{
+			probeDeadlineMs = probe->StartMs + ProbeTimeoutMs;
+			if (nowMs < probeDeadlineMs)
+				return false;
+			tPrintf("Idle hint for session %s took too long.\n", Names[session].c_str());
+		}
+		else
+		{
+			activityMs = ParseIdleHint(probe->Output, nowMs);
+		}
+		CancelIdleHintProbe(probe);
+		return true;
+	}
+
+	// Terminal times are wall-clock so they are converted by their age.
+	struct stat info;
+	if (stat(("/dev/" + TTYs[session]).c_str(), &info) != 0)
+		return true;
+
+	timespec realNow;
+	clock_gettime(CLOCK_REALTIME, &realNow);
+	int64_t ageMs =
+		(int64_t(realNow.tv_sec) - int64_t(info.st_atim.tv_sec))*1000 +
+		(int64_t(realNow.tv_nsec) - int64_t(info.st_atim.tv_nsec))/1000000;
+	activityMs = nowMs - ((ageMs > 0) ? ageMs : 0);
+	return true;
+}
+
+
+bool Daemon::StartIdleHintProbe(const std::string& name, int64_t nowMs)
+{
+	// loginctl is run directly rather than through a shell so the session name is never interpreted. Only the read end
+	// is non-blocking. The write end becomes loginctl's stdout.
+	int pipeFDs[2];
+	if (pipe2(pipeFDs, O_CLOEXEC) != 0)
+		return false;
+	fcntl(pipeFDs[0], F_SETFL, O_NONBLOCK);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, pipeFDs[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+	const char* argv[] =
+	{
+		"loginctl", "show-session", "-p", "IdleHint", "-p", "IdleSinceHintMonotonic", name.c_str(), nullptr
+	};
+	pid_t pid = 0;
+	int result = posix_spawnp(&pid, "loginctl", &actions, nullptr, (char* const*)argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(pipeFDs[1]);
+
+	epoll_event ev = { };
+	ev.events = EPOLLIN;
+	ev.data.fd = pipeFDs[0];
+	if ((result != 0) || (epoll_ctl(EpollFD, EPOLL_CTL_ADD, pipeFDs[0], &ev) != 0))
+	{
+		if (result == 0)
+		{
+			kill(pid, SIGKILL);
+			ProbePIDs.push_back(pid);
+		}
+		close(pipeFDs[0]);
+		return false;
+	}
+
+	ProbePIDs.push_back(pid);
+	IdleProbes.push_back({ name, pid, pipeFDs[0], nowMs, std::string() });
+	return true;
+}
+
+
+int64_t Daemon::ParseIdleHint(const std::string& output, int64_t nowMs)
+{
+	// A session that isn't idle is active now. An idle one has been since the monotonic time given in microseconds.
+	if (output.find("IdleHint=no") != std::string::npos)
+		return nowMs;
+
+	size_t since = output.find("IdleSinceHintMonotonic=");
+	if (since == std::string::npos)
+		return std::numeric_limits<int64_t>::min();
+	int64_t sinceUs = std::strtoll(output.c_str() + since + strlen("IdleSinceHintMonotonic="), nullptr, 10);
+	if (sinceUs <= 0)
+		return std::numeric_limits<int64_t>::min();
+
+	// CLOCK_MONOTONIC stops during a system sleep and GetTimeMs doesn't, so convert with the current difference.
+	timespec monoNow;
+	clock_gettime(CLOCK_MONOTONIC, &monoNow);
+	int64_t monoNowMs = int64_t(monoNow.tv_sec)*1000 + int64_t(monoNow.tv_nsec)/1000000;
+	return nowMs - (monoNowMs - sinceUs/1000);
+}
+
+
+void Daemon::CancelIdleHintProbe(std::vector<IdleProbe>::iterator probe)
+{
+	// A finished loginctl has exited already and is reaped on SIGCHLD like any other. One still running is killed.
+	if (probe->FD >= 0)
+	{
+		kill(probe->PID, SIGKILL);
+		close(probe->FD);
+	}
+	IdleProbes.erase(probe);
+}
+
+
+bool Daemon::ReadProbe(int fd)
+{
+	auto probe = IdleProbes.begin();
+	while ((probe != IdleProbes.end()) && (probe->FD != fd))
+		++probe;
+	if (probe == IdleProbes.end())
+		return false;
+
+	char buf[256];
+	for (;;)
+	{
+		ssize_t numRead = read(fd, buf, sizeof(buf));
+		if (numRead > 0)
+		{
+			probe->Output.append(buf, numRead);
+			continue;
+		}
+		if ((numRead < 0) && (errno == EINTR))
+			continue;
+		if ((numRead < 0) && (errno == EAGAIN))
+			return false;
+		break;
+	}
+
+	// End of output, or an error that means there won't be any more. Closing takes it out of the epoll set.
+	close(fd);
+	probe->FD = -1;
+	return true;
+}
+
+
+size_t Daemon::GetBytesPerSession()
+{
+	int numSessions = Table.GetNumSessions();
+	if (numSessions == 0)
+		return SessionTable::GetTableBytesPerSession();
+
+	// Strings count their own size plus any heap buffer. Map nodes hold the key, the index, a next pointer, and the
+	// cached hash.
+	size_t numBytes = Table.GetNumBytesAllocated();
+	numBytes += (Names.capacity() + TTYs.capacity())*sizeof(std::string) + Probes.capacity()*sizeof(uint8_t);
+	numBytes += SessionIndices.bucket_count()*sizeof(void*);
+	numBytes += SessionIndices.size()*(sizeof(std::pair<const std::string, int>) + sizeof(void*) + sizeof(size_t));
+	std::string empty;
+	for (int s = 0; s < numSessions; s++)
+	{
+		// The name is held twice, once here and once as the map key.
+		if (Names[s].capacity() > empty.capacity())
+			numBytes += 2*(Names[s].capacity() + 1);
+		if (TTYs[s].capacity() > empty.capacity())
+			numBytes += TTYs[s].capacity() + 1;
+	}
+	return numBytes / size_t(numSessions);
+}
+
+
+int64_t Daemon::Sweep(int64_t nowMs)
+{
+	DueSessions.clear();
+	int64_t nextDeadlineMs = Table.CollectDue(nowMs, DueSessions);
+	for (int session : DueSessions)
+	{
+		// Only a session that is about to lock is probed. Activity found moves its deadline later instead. A session
+		// whose probe is still running stays due and is looked at again once it has finished.
+		if (Table.IsEnabled(session) && (Table.GetLockDeadline(session) <= nowMs))
+		{
+			int64_t activityMs = 0;
+			int64_t probeDeadlineMs = 0;
+			if (!ProbeLastActivity(session, nowMs, activityMs, probeDeadlineMs))
+			{
+				if (probeDeadlineMs < nextDeadlineMs)
+					nextDeadlineMs = probeDeadlineMs;
+				continue;
+			}
+			Table.ReportActivity(session, activityMs);
+		}
+
+		int64_t deadlineMs;
+		if (Table.Update(session, nowMs, deadlineMs) == LockScheduler::Action::Lock)
+			LockSession(session);
+		if (deadlineMs < nextDeadlineMs)
+			nextDeadlineMs = deadlineMs;
+	}
+
+	return nextDeadlineMs;
+}
+
+
+void Daemon::LockSession(int session)
+{
+	NumLocks++;
+	if (DryRun)
+	{
+		tPrintf("Lock session %s.\n", Names[session].c_str());
+		return;
+	}
+
+	const char* argv[] = { "loginctl", "lock-session", Names[session].c_str(), nullptr };
+	pid_t pid = 0;
+	int result = posix_spawnp(&pid, "loginctl", nullptr, nullptr, (char* const*)argv, environ);
+	if (result != 0)
+		tPrintf("Couldn't lock session %s: %s\n", Names[session].c_str(), strerror(result));
+}
+
+
+void Daemon::ReapChildren()
+{
+	int status;
+	pid_t pid;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+	{
+		// Probes report problems through their output, or the lack of it.
+		auto probe = std::find(ProbePIDs.begin(), ProbePIDs.end(), pid);
+		if (probe != ProbePIDs.end())
+		{
+			ProbePIDs.erase(probe);
+			continue;
+		}
+
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+			tPrintf("Lock command %d failed with status %d.\n", int(pid), status);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	tCmdLine::tParse(argc, argv);
+	if (OptionHelp.IsPresent())
+	{
+		tCmdLine::tPrintUsage
+		(
+			u8"Tristan Grimmer",
+			u8""
+			"Lockdown daemon locks every logind session on the machine after a period of inactivity, "
+			"from a single process. Sessions are found in the logind session directory as they come and "
+			"go. Graphical sessions are judged idle by the idle hint they report to logind, text sessions "
+			"by their terminal. Locking other users' sessions requires root.",
+			LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision
+		);
+		return Daemon::ExitCode_Success;
+	}
+
+	if (OptionSyntax.IsPresent())
+	{
+		tCmdLine::tPrintSyntax();
+		return Daemon::ExitCode_Success;
+	}
+
+	int64_t timeoutOverrideMs = 0;
+	if (OptionTimeoutMinutes.IsPresent())
+		timeoutOverrideMs += 60000 * int64_t(OptionTimeoutMinutes.Arg1().AsInt());
+	if (OptionTimeoutSeconds.IsPresent())
+		timeoutOverrideMs += int64_t(OptionTimeoutSeconds.Arg1().AsFloat() * 1000.0f);
+	if (timeoutOverrideMs > 0)
+		Daemon::Table.SetTimeout(timeoutOverrideMs);
+	if (OptionSessionDir.IsPresent())
+		Daemon::SessionDir = OptionSessionDir.Arg1().Chr();
+	Daemon::DryRun = OptionDryRun.IsPresent();
+
+	int epollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFD < 0)
+		return Daemon::ExitCode_EpollFailure;
+	Daemon::EpollFD = epollFD;
+
+	Lockdown::DeadlineTimer timer;
+	if (!timer.IsValid())
+		return Daemon::ExitCode_TimerFailure;
+
+	// logind renames each session file into place when it changes and deletes it when the session ends.
+	int watchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	uint32_t watchMask = IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM;
+	if ((watchFD < 0) || (inotify_add_watch(watchFD, Daemon::SessionDir.c_str(), watchMask) < 0))
+	{
+		tPrintf("Couldn't watch session directory %s.\n", Daemon::SessionDir.c_str());
+		return Daemon::ExitCode_SessionDirFailure;
+	}
+
+	// Lock commands are not waited for. SIGCHLD comes through the signalfd too so they are reaped in the loop.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &signals, nullptr);
+	int signalFD = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	int fds[] = { timer.GetFD(), watchFD, signalFD };
+	for (int fd : fds)
+	{
+		if (fd < 0)
+			continue;
+		epoll_event ev = { };
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &ev);
+	}
+
+	Daemon::ScanSessions(Lockdown::GetTimeMs());
+	tPrintf("Tracking %d sessions.\n", Daemon::Table.GetNumSessions());
+	int64_t deadlineMs = Daemon::Sweep(Lockdown::GetTimeMs());
+	if (deadlineMs != std::numeric_limits<int64_t>::max())
+		timer.Arm(deadlineMs);
+
+	bool running = true;
+	while (running)
+	{
+		epoll_event events[16];
+		int numEvents = epoll_wait(epollFD, events, 16, -1);
+		if ((numEvents < 0) && (errno != EINTR))
+			break;
+
+		bool sweep = false;
+		for (int e = 0; e < numEvents; e++)
+		{
+			int fd = events[e].data.fd;
+			if (fd == timer.GetFD())
+			{
+				timer.Acknowledge();
+				sweep = true;
+			}
+			else if (fd == watchFD)
+			{
+				// The events only say something changed. Rescanning is cheap next to how rarely sessions change.
+				alignas(inotify_event) char buf[4096];
+				while (read(watchFD, buf, sizeof(buf)) > 0) { }
+				Daemon::ScanSessions(Lockdown::GetTimeMs());
+				sweep = true;
+			}
+			else if (fd == signalFD)
+			{
+				signalfd_siginfo info;
+				while (read(signalFD, &info, sizeof(info)) == sizeof(info))
+				{
+					if (info.ssi_signo != SIGCHLD)
+						running = false;
+				}
+				Daemon::ReapChildren();
+			}
+			else if (Daemon::ReadProbe(fd))
+			{
+				sweep = true;
+			}
+		}
+
+		if (sweep && running)
+		{
+			deadlineMs = Daemon::Sweep(Lockdown::GetTimeMs());
+			if (deadlineMs != std::numeric_limits<int64_t>::max())
+				timer.Arm(deadlineMs);
+		}
+	}
+
+	tPrintf
+	(
+		"Tracked %d sessions in about %d bytes each, %d of them the table. Locked %llu times.\n",
+		Daemon::Table.GetNumSessions(), int(Daemon::GetBytesPerSession()),
+		int(Lockdown::SessionTable::GetTableBytesPerSession()), (unsigned long long)Daemon::NumLocks
+	);
+	if (signalFD >= 0)
+		close(signalFD);
+	close(watchFD);
+	close(epollFD);
+	return Daemon::ExitCode_Success;
+}
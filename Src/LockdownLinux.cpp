@@ -0,0 +1,943 @@
+// LockdownLinux.cpp
+//
+// Linux front end. Locks the session after a period of inactivity. Keyboard and mouse activity comes from the evdev
+// backend and the lock deadline is a CLOCK_BOOTTIME timerfd, all multiplexed on one epoll set. Gamepads are read by the
+// libgamepad hook thread, which blocks on its own epoll set and passes events to the main thread through a ring. Nothing
+// wakes the process unless there is input of interest or a deadline is reached. The countdown is shown by status bars
+// that watch it through the control socket, and is only worked out when it changes while something is watching.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstring>
+#include <System/tPrint.h>
+#include <System/tCmdLine.h>
+#include <libgamepad.hpp>
+#include "Version.cmake.h"
+#include "IdleEngine.h"
+#include "LockScheduler.h"
+#include "PolicyScheduler.h"
+#include "Config.h"
+#include "ActivityCoalescer.h"
+#include "ActivityTrace.h"
+#include "ActivityRing.h"
+#include "Metrics.h"
+#include "InputEvdev.h"
+#include "Control.h"
+#include "LockAction.h"
+#include "AllocationCounter.h"
+#include "StatusText.h"
+
+
+// Command-line options. These match the Windows tray app.
+tCmdLine::tOption OptionHelp				("Display help and usage screen.",	"help",		'h'			);
+tCmdLine::tOption OptionSyntax				("Display CLI syntax guide.",		"syntax",	'y'			);
+tCmdLine::tOption OptionTimeoutMinutes		("Timeout in minutes.",				"minutes",	'm',	1	);
+tCmdLine::tOption OptionTimeoutSeconds		("Timeout in seconds.",				"seconds",	's',	1	);
+tCmdLine::tOption OptionMaxSuspendMinutes	("Max suspend time in minutes.",	"suspend",	'x',	1	);
+tCmdLine::tOption OptionKeyboard			("Detect any keyboard input",		"keyboard",	'k'			);
+tCmdLine::tOption OptionMouseMovement		("Detect any mouse movement.",		"movement",	'v'			);
+tCmdLine::tOption OptionMouseButton			("Detect any mouse button presses.","button",	'b'			);
+tCmdLine::tOption OptionPadButtons			("Detect any gamepad button input.","pad",		'p'			);
+tCmdLine::tOption OptionAxis				("Detect any gamepad axis changes.","axis",		'a'			);
+tCmdLine::tOption OptionWindow				("Coalescing window in ms.",		"window",	'w',	1	);
+tCmdLine::tOption OptionTrace				("Record input to a trace file.",	"trace",	't',	1	);
+tCmdLine::tOption OptionMetrics				("Serve metrics on a unix socket.",	"metrics",	'e',	1	);
+tCmdLine::tOption OptionWarn				("Warn seconds before locking.",	"warn",		'r',	1	);
+tCmdLine::tOption OptionBlank				("Blank display seconds before lock.","blank",	'l',	1	);
+tCmdLine::tOption OptionLogout				("Log out minutes after locking.",	"logout",	'o',	1	);
+tCmdLine::tOption OptionConfig				("Config file. Reloaded on change.","config",	'c',	1	);
+tCmdLine::tOption OptionDeadzones			("Keep learned pad deadzones here.","deadzone",	'g',	1	);
+tCmdLine::tOption OptionLocker				("Locker command, or simulate.",	"locker",	'L',	1	);
+
+
+namespace Lockdown
+{
+	IdleEngine Engine;												// 20 minute timeout and 3 hour max suspend unless overridden by command line.
+	PolicyScheduler Scheduler(Engine);								// Only locks unless stages are given on the command line.
+	ActivityCoalescer Coalescer(Engine);							// All input goes through here on its way to the engine.
+	ActivityTraceWriter Trace;										// Only records if -t is given.
+	ConfigSnapshot BaseConfig;										// From the command line. The config file goes over it.
+	ConfigStore Config;												// What is in use. Read by the gamepad hook thread too.
+	ConfigWatcher Watcher;											// Only watches if -c is given.
+	ActivityRing PadRing;											// Gamepad hook thread to engine thread.
+	uint64_t NumPadRecordsDropped			= 0;					// As of the last drain.
+	int PadRingFD							= -1;					// An eventfd signalled when the ring needs draining.
+	std::shared_ptr<gamepad::hook> PadHook;							// Not started until a pad is present.
+	int PadWatchFD							= -1;					// Watches for the first pad while there is no hook.
+	MetricsRegistry Metrics;
+	MetricsExporter Exporter(Metrics, Engine, Coalescer);			// Only serves if -e is given.
+	ControlServer Control;											// Also what stops a second instance in a session.
+	LockAction Locker;												// logind unless -L gives a command.
+	int64_t BlankChild						= -1;					// The blank command's process while it runs.
+	int64_t LogoutChild						= -1;					// The same for logging out.
+	uint64_t NumControlRejected				= 0;					// As of the last requests handled.
+	StatusText Status;												// As last sent to watchers.
+	char StatusLine[StatusText::MaxLength+2];						// The same with a newline.
+	DeadlineTimer StatusTimer;										// Only armed while there are watchers.
+
+	// Starts locking the current session and returns without waiting. dueUs is when the lock became due. Results come
+	// back to HandleLockResult, from here if the backend finishes straight away and from SIGCHLD otherwise.
+	void LockSession(int64_t dueUs);
+	void HandleLockResult(LockResult);
+	void PrintActivityCounts();
+
+	// Performs the PolicyActions returned by the scheduler. Blank and logout commands are spawned like the locker and
+	// reaped by ReapCommands on SIGCHLD. A stage whose command is still running from last time isn't run again.
+	void PerformActions(uint32_t actions, int64_t nowMs);
+	void ReapCommands();
+
+	// Reads the config file over the command line settings. On failure it says why and the config is left alone.
+	bool LoadConfig(const char* path, ConfigSnapshot&);
+
+	// Applies the published config. Settings are the engine, coalescer, and scheduler values, which must be in place
+	// before the first deadline is armed. Inputs opens or closes whatever input the config turns on or off.
+	void ApplySettings();
+	bool ApplyInputs(EvdevInput&, int epollFD);
+	void ReloadConfig(EvdevInput&, int epollFD);
+	uint32_t GetEvdevFlags(const ConfigSnapshot&);
+	int GetPadEventTypes(const ConfigSnapshot&);
+
+	// Handles every request waiting on the control socket. Each is answered as soon as it has taken effect on the
+	// engine and before anything slow, such as running the lock command, is done. Returns true if the schedule needs
+	// evaluating.
+	bool ProcessControl();
+
+	// Sends the status to the watchers if the text has changed and arms the status timer for when the countdown next
+	// changes it. Does nothing while there are no watchers. Returns true if it was sent.
+	bool PublishStatus(int64_t nowMs);
+
+	// These are called on the gamepad hook thread.
+	void Hook_GamepadEvents(const gamepad::device_event*, size_t count, void*);
+
+	// Called on the engine thread to process everything the gamepad hook thread has pushed.
+	void DrainPadRing();
+	void Hook_GamepadConnect(std::shared_ptr<gamepad::device>);
+	void Hook_GamepadDisconnect(std::shared_ptr<gamepad::device>);
+
+	// Most machines never see a gamepad, so the hook and its thread are only started once a joydev node exists. Until
+	// then an inotify watch on the input directory waits for one. ProcessPadWatch returns false if the hook was needed
+	// and couldn't be started.
+	bool IsGamepadPresent(const char* dir);
+	bool EnableGamepads(int epollFD);
+	bool StartGamepadHook();
+	bool ProcessPadWatch();
+
+	enum ExitCode
+	{
+		ExitCode_Success,
+		ExitCode_EpollFailure,
+		ExitCode_TimerFailure,
+		ExitCode_InputFailure,
+		ExitCode_GamepadHookFailure,
+		ExitCode_TraceFailure,
+		ExitCode_MetricsFailure,
+		ExitCode_AlreadyRunning
+	};
+}
+
+
+void Lockdown::LockSession(int64_t dueUs)
+{
+	// A lock folded into one already pending keeps that one's times, so nothing new is recorded for it.
+	bool pending = Locker.IsPending();
+	LockResult result = Locker.Issue(dueUs);
+	if (!pending && (result != LockResult_Failed))
+		Metrics.RecordLockIssued(Locker.GetIssueLatencyUs());
+	HandleLockResult(result);
+}
+
+
+void Lockdown::HandleLockResult(LockResult result)
+{
+	if (result == LockResult_Confirmed)
+	{
+		Metrics.RecordLockConfirmed(Locker.GetConfirmLatencyUs());
+		tdPrintf("Locked %lld us after issuing.\n", (long long)Locker.GetConfirmLatencyUs());
+	}
+	else if (result == LockResult_Failed)
+	{
+		Metrics.Increment(Counter_LockFailures);
+		tPrintf("Lock failed using the %s backend.\n", GetLockBackendName(Locker.GetBackend()));
+	}
+}
+
+
+void Lockdown::PerformActions(uint32_t actions, int64_t nowMs)
+{
+	if (actions & PolicyAction_Cancel)
+	{
+		Metrics.Increment(Counter_StagesCancelled);
+		tPrintf("Activity. Lock cancelled.\n");
+	}
+
+	if (actions & PolicyAction_Warn)
+	{
+		Metrics.Increment(Counter_Warnings);
+		Trace.WriteCommand(TraceCommand_Warn);
+		tPrintf("Locking in %d seconds.\n", int((Engine.GetRemaining(nowMs) + 999) / 1000));
+	}
+
+	// The trace records the stage whether or not there is a display to blank, since a replay only has the scheduler.
+	if (actions & PolicyAction_Blank)
+		Trace.WriteCommand(TraceCommand_Blank);
+
+	// Only an X display can be forced off from here. Under Wayland the compositor's own idle handling blanks it.
+	if ((actions & PolicyAction_Blank) && std::getenv("DISPLAY"))
+	{
+		Metrics.Increment(Counter_Blanks);
+		const char* argv[] = { "xset", "dpms", "force", "off", nullptr };
+		if (BlankChild < 0)
+			BlankChild = SpawnChild(argv);
+	}
+
+	if (actions & PolicyAction_Lock)
+	{
+		Metrics.Increment(Counter_Locks);
+		Trace.WriteCommand(TraceCommand_Lock);
+		LockSession(Scheduler.GetDueTime(PolicyStage_Lock) * 1000);
+		Coalescer.Reset();
+	}
+
+	// Terminating the session ends this process along with everything else in it.
+	if (actions & PolicyAction_Logout)
+	{
+		Metrics.Increment(Counter_Logouts);
+		Trace.WriteCommand(TraceCommand_Logout);
+		const char* session = std::getenv("XDG_SESSION_ID");
+		const char* argv[] = { "loginctl", "terminate-session", session ? session : "", nullptr };
+		if (LogoutChild < 0)
+			LogoutChild = SpawnChild(argv);
+		if (LogoutChild < 0)
+			tPrintf("Logout command couldn't be started.\n");
+	}
+}
+
+
+void Lockdown::ReapCommands()
+{
+	bool success = false;
+	ReapChild(BlankChild, success);
+	if (ReapChild(LogoutChild, success) && !success)
+		tPrintf("Logout command failed.\n");
+}
+
+
+void Lockdown::Hook_GamepadEvents(const gamepad::device_event* events, size_t count, void*)
+{
+	// Only a compact record per event is pushed here. Printing, tracing, and reporting to the coalescer all happen on
+	// the engine thread when it drains the ring, so the hook thread never waits on console output or the trace lock.
+	SteadyStateScope steadyState;
+	int padEventTypes = GetPadEventTypes(*ConfigReader(Config));
+	int64_t nowMs = GetTimeMs();
+	bool pushed = false;
+	for (size_t e = 0; e < count; e++)
+	{
+		const gamepad::device_event& devEvent = events[e];
+		if (!(devEvent.type & padEventTypes))
+			continue;
+
+		const gamepad::input_event& ev = devEvent.event;
+		bool isAxis = (devEvent.type == gamepad::update_result::AXIS);
+		ActivityRecord record;
+		record.EventTime	= ev.time;
+		record.TimeMs		= nowMs;
+		record.Value		= ev.value;
+		record.NativeID		= ev.native_id;
+		record.VC			= ev.vc;
+		record.Source		= uint8_t(isAxis ? ActivitySource_PadAxis : ActivitySource_PadButton);
+		record.Type			= uint8_t(isAxis ? TraceType_PadAxis : TraceType_PadButton);
+		record.Device		= uint8_t(devEvent.device_index);
+		record.Pad			= 0;
+		PadRing.Push(record);
+		pushed = true;
+	}
+
+	if (pushed && PadRing.Publish())
+	{
+		uint64_t one = 1;
+		if (write(PadRingFD, &one, sizeof(one)) < 0)
+			tdPrintf("Couldn't wake the engine thread.\n");
+	}
+}
+
+
+void Lockdown::DrainPadRing()
+{
+	PadRing.Drain
+	(
+		[](const ActivityRecord& record)
+		{
+			tdPrintf
+			(
+				"Received %s event: Native id: %i, Virtual id: 0x%X (%i) val: %i\n",
+				(record.Type == TraceType_PadAxis) ? "axis" : "button", record.NativeID, record.VC, record.VC, record.Value
+			);
+			Trace.WritePad(TraceType(record.Type), record.Device, record.NativeID, record.VC, record.Value, record.EventTime);
+			Coalescer.Report(ActivitySource(record.Source), record.TimeMs);
+		}
+	);
+
+	// Dropped records still count as activity, just not at the exact time.
+	uint32_t droppedSources = PadRing.TakeOverflowSources();
+	if (!droppedSources)
+		return;
+	for (int s = 0; s < ActivitySource_NumSources; s++)
+		if (droppedSources & (1u << s))
+			Coalescer.Report(ActivitySource(s));
+
+	uint64_t numDropped = PadRing.GetNumOverflows();
+	Metrics.Add(Counter_PadRecordsDropped, numDropped - NumPadRecordsDropped);
+	NumPadRecordsDropped = numDropped;
+}
+
+
+void Lockdown::Hook_GamepadConnect(std::shared_ptr<gamepad::device> dev)
+{
+	tdPrintf("%s connected\n", dev->get_name().c_str());
+	Metrics.Increment(Counter_GamepadConnects);
+	Engine.ReportActivity();
+}
+
+
+void Lockdown::Hook_GamepadDisconnect(std::shared_ptr<gamepad::device> dev)
+{
+	// Unplugging a gamepad is not counted as input. One might be unplugging it when leaving for the day.
+	tdPrintf("%s disconnected\n", dev->get_name().c_str());
+	Metrics.Increment(Counter_GamepadDisconnects);
+}
+
+
+bool Lockdown::IsGamepadPresent(const char* dir)
+{
+	DIR* d = opendir(dir);
+	if (!d)
+		return false;
+
+	bool present = false;
+	while (dirent* entry = readdir(d))
+	{
+		if (strncmp(entry->d_name, "js", 2) == 0)
+		{
+			present = true;
+			break;
+		}
+	}
+	closedir(d);
+	return present;
+}
+
+
+bool Lockdown::EnableGamepads(int epollFD)
+{
+	if (PadHook || (PadWatchFD >= 0))
+		return true;
+
+	// The watch is added before looking for a pad so one plugged in between the two isn't missed.
+	PadWatchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if ((PadWatchFD >= 0) && (inotify_add_watch(PadWatchFD, "/dev/input", IN_CREATE) < 0))
+	{
+		close(PadWatchFD);
+		PadWatchFD = -1;
+	}
+
+	if ((PadWatchFD < 0) || IsGamepadPresent("/dev/input"))
+	{
+		if (PadWatchFD >= 0)
+			close(PadWatchFD);
+		PadWatchFD = -1;
+		return StartGamepadHook();
+	}
+
+	epoll_event ev = { };
+	ev.events = EPOLLIN;
+	ev.data.fd = PadWatchFD;
+	epoll_ctl(epollFD, EPOLL_CTL_ADD, PadWatchFD, &ev);
+	return true;
+}
+
+
+bool Lockdown::StartGamepadHook()
+{
+	// The hook thread sleeps in epoll_wait on all joydev nodes and only wakes for actual pad input. Pads that are
+	// plugged in or removed after this are picked up from inotify on /dev/input. Only if that can't be watched does it
+	// fall back to rescanning once a second. Starting it allocates, which is fine since it only happens once.
+	SteadyStateScope starting(false);
+	PadHook = gamepad::hook::make();
+	PadHook->set_hotplug(true);
+	PadHook->set_plug_and_play(true, gamepad::ms(1000));
+	PadHook->set_batch_event_handler(Hook_GamepadEvents);
+	PadHook->set_connect_event_handler(Hook_GamepadConnect);
+	PadHook->set_disconnect_event_handler(Hook_GamepadDisconnect);
+
+	// What the pads' axis filters learn, such as the deadzone a drifting stick needs, is kept across runs if asked.
+	if (OptionDeadzones.IsPresent() && !PadHook->load_calibration(OptionDeadzones.Arg1().Chr()))
+		tPrintf("Couldn't read gamepad deadzones %s. They are learned again.\n", OptionDeadzones.Arg1().Chr());
+	if (!PadHook->start())
+	{
+		tdPrintf("Couldn't start gamepad hook.\n");
+		PadHook.reset();
+		return false;
+	}
+	return true;
+}
+
+
+bool Lockdown::ProcessPadWatch()
+{
+	// The node may not be readable when it is created, but the hook's own watch sees it once it is.
+	alignas(inotify_event) char buf[4096];
+	bool created = false;
+	ssize_t numRead;
+	while ((numRead = read(PadWatchFD, buf, sizeof(buf))) > 0)
+	{
+		for (char* ptr = buf; ptr < buf + numRead; )
+		{
+			inotify_event* ev = (inotify_event*)ptr;
+			if (ev->len && (strncmp(ev->name, "js", 2) == 0))
+				created = true;
+			ptr += sizeof(inotify_event) + ev->len;
+		}
+	}
+	if (!created)
+		return true;
+
+	close(PadWatchFD);
+	PadWatchFD = -1;
+	return StartGamepadHook();
+}
+
+
+bool Lockdown::LoadConfig(const char* path, ConfigSnapshot& config)
+{
+	std::string text;
+	if (!ConfigWatcher::Read(path, text))
+	{
+		tPrintf("Couldn't read config file %s.\n", path);
+		return false;
+	}
+
+	ConfigSnapshot loaded = BaseConfig;
+	std::string error;
+	if (!ParseConfig(text, loaded, error))
+	{
+		tPrintf("Config file %s not applied. %s.\n", path, error.c_str());
+		return false;
+	}
+	config = loaded;
+	return true;
+}
+
+
+void Lockdown::ApplySettings()
+{
+	ConfigReader config(Config);
+	Engine.SetTimeout(config->TimeoutMs);
+	Engine.SetMaxSuspend(config->MaxSuspendMs);
+	Coalescer.SetTimeout(config->TimeoutMs);
+	Coalescer.SetWindows(config->WindowMs);
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+		Scheduler.SetStage(PolicyStage(s), config->StageEnabled[s], config->StageOffsetMs[s]);
+	Metrics.SetGauge(Gauge_ConfigGeneration, int64_t(config->Generation));
+}
+
+
+bool Lockdown::ApplyInputs(EvdevInput& input, int epollFD)
+{
+	// Gamepads turned off are left running and their events ignored, so turning them back on doesn't wait for a scan.
+	ConfigReader config(Config);
+	input.Configure(GetEvdevFlags(*config), config->DistanceThreshold);
+	if (config->IsSourceEnabled(ActivitySource_PadButton) || config->IsSourceEnabled(ActivitySource_PadAxis))
+		return EnableGamepads(epollFD);
+	return true;
+}
+
+
+void Lockdown::ReloadConfig(EvdevInput& input, int epollFD)
+{
+	// Reading, parsing, and publishing the file all allocate. A reload is rare enough not to count as steady state.
+	SteadyStateScope reloading(false);
+	ConfigSnapshot config;
+	if (!LoadConfig(Watcher.GetPath().c_str(), config))
+	{
+		Metrics.Increment(Counter_ConfigErrors);
+		return;
+	}
+
+	// The new snapshot is complete before the hooks can see it. The old one goes once no reader can be using it.
+	uint64_t generation = Config.Publish(config);
+	Metrics.Increment(Counter_ConfigReloads);
+	ApplySettings();
+	ApplyInputs(input, epollFD);
+	tPrintf("Config %llu loaded from %s.\n", (unsigned long long)generation, Watcher.GetPath().c_str());
+}
+
+
+uint32_t Lockdown::GetEvdevFlags(const ConfigSnapshot& config)
+{
+	uint32_t flags = 0;
+	if (config.IsSourceEnabled(ActivitySource_Keyboard))
+		flags |= EvdevFlag_Keyboard;
+	if (config.IsSourceEnabled(ActivitySource_MouseMove))
+		flags |= EvdevFlag_MouseMovement;
+	if (config.IsSourceEnabled(ActivitySource_MouseButton))
+		flags |= EvdevFlag_MouseButton;
+	return flags;
+}
+
+
+int Lockdown::GetPadEventTypes(const ConfigSnapshot& config)
+{
+	// A packet event means the pad had input between polls that left no change. It counts for either.
+	int types = 0;
+	if (config.IsSourceEnabled(ActivitySource_PadButton))
+		types |= gamepad::update_result::BUTTON | gamepad::update_result::PACKET;
+	if (config.IsSourceEnabled(ActivitySource_PadAxis))
+		types |= gamepad::update_result::AXIS | gamepad::update_result::PACKET;
+	return types;
+}
+
+
+bool Lockdown::ProcessControl()
+{
+	bool changed = false;
+	ControlRequest request;
+	while (Control.Receive(request))
+	{
+		Metrics.Increment(Counter_ControlRequests);
+		int64_t receivedUs = GetTimeUs();
+		int64_t nowMs = GetTimeMs();
+		if (request.Command == ControlCommand_Watch)
+		{
+			// A new watcher needs the text whether or not it changed. If it did, every other watcher is owed it too.
+			if (!Control.Watch())
+				Control.Reply("error too many watchers\n");
+			else if (!PublishStatus(nowMs))
+				Control.Reply(StatusLine);
+			continue;
+		}
+
+		bool lockNow = false;
+		switch (request.Command)
+		{
+			case ControlCommand_Lock:
+				Metrics.Increment(Counter_LockNow);
+				Trace.WriteCommand(TraceCommand_LockNow);
+				Engine.Resume(nowMs);
+				Coalescer.Reset();
+				lockNow = true;
+				break;
+
+			case ControlCommand_Suspend:
+				Metrics.Increment(Counter_Suspends);
+				Trace.WriteCommand(TraceCommand_Suspend);
+				Engine.Suspend(nowMs);
+				break;
+
+			case ControlCommand_Resume:
+				if (Engine.IsEnabled(nowMs))
+					break;
+				Metrics.Increment(Counter_Resumes);
+				Trace.WriteCommand(TraceCommand_Resume);
+				Engine.Resume(nowMs);
+				Coalescer.Reset();
+				break;
+
+			case ControlCommand_Remaining:
+				Metrics.Increment(Counter_SetRemaining);
+				Trace.WriteCommand(TraceCommand_SetRemaining, request.ValueMs);
+				Engine.SetRemaining(nowMs, request.ValueMs);
+				Coalescer.Reset(request.ValueMs);
+				break;
+
+			case ControlCommand_Timeout:
+			{
+				// Published like any other config change. It lasts until the config file next changes.
+				SteadyStateScope publishing(false);
+				ConfigSnapshot config = *ConfigReader(Config);
+				config.TimeoutMs = request.ValueMs;
+				Config.Publish(config);
+				ApplySettings();
+				break;
+			}
+
+			default:
+				break;
+		}
+		changed |= (request.Command != ControlCommand_Status);
+
+		// A shorter timeout can leave the lock overdue. It happens when the schedule is evaluated, right after this.
+		char reply[MaxControlMessage];
+		bool enabled = Engine.IsEnabled(nowMs);
+		int64_t remainingMs = enabled ? Engine.GetRemaining(nowMs) : Engine.GetSuspendRemaining(nowMs);
+		snprintf
+		(
+			reply, sizeof(reply), "ok %s remaining_ms=%lld timeout_ms=%lld\n", enabled ? "enabled" : "suspended",
+			(long long)((remainingMs > 0) ? remainingMs : 0), (long long)Engine.GetTimeout()
+		);
+		Control.Reply(reply);
+		if (lockNow)
+			LockSession(receivedUs);
+	}
+
+	uint64_t numRejected = Control.GetNumRejected();
+	Metrics.Add(Counter_ControlRejected, numRejected - NumControlRejected);
+	NumControlRejected = numRejected;
+	return changed;
+}
+
+
+bool Lockdown::PublishStatus(int64_t nowMs)
+{
+	if (!Control.GetNumWatchers())
+		return false;
+
+	bool changed = Status.Update(Engine, nowMs);
+	if (changed)
+	{
+		snprintf(StatusLine, sizeof(StatusLine), "%s\n", Status.Get());
+		Control.Notify(StatusLine);
+		Metrics.Increment(Counter_StatusUpdates);
+	}
+
+	// Once the last watcher has gone the timer is left to run out. It finds no one to send to and isn't re-armed.
+	if (Control.GetNumWatchers() && (Status.GetNextChange() != StatusText::NoChange))
+		StatusTimer.Arm(Status.GetNextChange());
+	return changed;
+}
+
+
+void Lockdown::PrintActivityCounts()
+{
+	for (int s = 0; s < ActivitySource_NumSources; s++)
+	{
+		ActivitySource source = ActivitySource(s);
+		tdPrintf
+		(
+			"%-12s accepted %llu coalesced %llu\n", GetSourceName(source),
+			(unsigned long long)Coalescer.GetNumAccepted(source), (unsigned long long)Coalescer.GetNumCoalesced(source)
+		);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	tCmdLine::tParse(argc, argv);
+	if (OptionHelp.IsPresent())
+	{
+		tCmdLine::tPrintUsage
+		(
+			u8"Tristan Grimmer",
+			u8""
+			"Lockdown locks the session after a period of inactivity. It can monitor user input "
+			"from keyboard, mouse, and gamepads. If no inputs are specified on the command line "
+			"(-kvbpa), all inputs are monitored. Reading input devices requires membership of "
+			"the 'input' group.",
+			LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision
+		);
+		return Lockdown::ExitCode_Success;
+	}
+
+	if (OptionSyntax.IsPresent())
+	{
+		tCmdLine::tPrintSyntax();
+		return Lockdown::ExitCode_Success;
+	}
+
+	// SIGINT and SIGTERM are read from a signalfd so shutdown goes through the same loop. So is SIGCHLD, which is how
+	// the locker process finishing is seen. They are blocked before any thread starts so every thread inherits the
+	// mask. Otherwise a SIGCHLD could be delivered to the gamepad or metrics thread and discarded.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+	if (OptionLocker.IsPresent())
+	{
+		if (strcmp(OptionLocker.Arg1().Chr(), "simulate") == 0)
+			Lockdown::Locker.SetBackend(Lockdown::LockBackend_Simulated);
+		else
+			Lockdown::Locker.SetBackend(Lockdown::LockBackend_Command, OptionLocker.Arg1().Chr());
+	}
+
+	// The control socket is bound first since it is what says whether lockdown is already running in this session.
+	// Failing to bind it for any other reason only loses remote control.
+	std::string controlName = Lockdown::GetControlName();
+	Lockdown::ControlServer::StartResult controlResult = Lockdown::Control.Start(controlName.c_str());
+	if (controlResult == Lockdown::ControlServer::StartResult_AlreadyRunning)
+	{
+		tPrintf("Lockdown is already running in this session. Use lockdownctl to control it.\n");
+		return Lockdown::ExitCode_AlreadyRunning;
+	}
+	if (controlResult == Lockdown::ControlServer::StartResult_Taken)
+		tPrintf("Control socket %s is held by another user. Running without remote control.\n", controlName.c_str());
+	if (controlResult == Lockdown::ControlServer::StartResult_Failed)
+		tPrintf("Couldn't bind control socket %s.\n", controlName.c_str());
+
+	// The command line settings. Deadlines have millisecond resolution so fractional seconds are allowed.
+	Lockdown::ConfigSnapshot& base = Lockdown::BaseConfig;
+	int64_t timeoutOverrideMs = 0;
+	if (OptionTimeoutMinutes.IsPresent())
+		timeoutOverrideMs += 60000 * int64_t(OptionTimeoutMinutes.Arg1().AsInt());
+	if (OptionTimeoutSeconds.IsPresent())
+		timeoutOverrideMs += int64_t(OptionTimeoutSeconds.Arg1().AsFloat() * 1000.0f);
+	if (timeoutOverrideMs > 0)
+		base.TimeoutMs = timeoutOverrideMs;
+
+	int64_t suspendOverrideMs = 0;
+	if (OptionMaxSuspendMinutes.IsPresent())
+		suspendOverrideMs = 60000 * int64_t(OptionMaxSuspendMinutes.Arg1().AsInt());
+	if (suspendOverrideMs > 0)
+		base.MaxSuspendMs = suspendOverrideMs;
+
+	if (OptionWindow.IsPresent() && (OptionWindow.Arg1().AsInt() >= 0))
+		base.WindowMs = OptionWindow.Arg1().AsInt();
+
+	// Policy stages are placed relative to the lock so the timeout is still the time to lock.
+	if (OptionWarn.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Warn] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Warn] = -int64_t(OptionWarn.Arg1().AsFloat() * 1000.0f);
+	}
+	if (OptionBlank.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Blank] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Blank] = -int64_t(OptionBlank.Arg1().AsFloat() * 1000.0f);
+	}
+	if (OptionLogout.IsPresent())
+	{
+		base.StageEnabled[Lockdown::PolicyStage_Logout] = true;
+		base.StageOffsetMs[Lockdown::PolicyStage_Logout] = 60000 * int64_t(OptionLogout.Arg1().AsInt());
+	}
+
+	// If no inputs are given they all count, which is the default.
+	if
+	(
+		OptionKeyboard.IsPresent()		|| OptionMouseMovement.IsPresent()		|| OptionMouseButton.IsPresent() ||
+		OptionPadButtons.IsPresent()	|| OptionAxis.IsPresent()
+	)
+	{
+		base.Sources = 0;
+		base.Sources |= OptionKeyboard.IsPresent()		? (1u << Lockdown::ActivitySource_Keyboard)		: 0;
+		base.Sources |= OptionMouseMovement.IsPresent()	? (1u << Lockdown::ActivitySource_MouseMove)	: 0;
+		base.Sources |= OptionMouseButton.IsPresent()	? (1u << Lockdown::ActivitySource_MouseButton)	: 0;
+		base.Sources |= OptionPadButtons.IsPresent()	? (1u << Lockdown::ActivitySource_PadButton)	: 0;
+		base.Sources |= OptionAxis.IsPresent()			? (1u << Lockdown::ActivitySource_PadAxis)		: 0;
+	}
+
+	// A config file that can't be used at startup isn't fatal. It is watched anyway so fixing it takes effect.
+	Lockdown::ConfigSnapshot config = base;
+	if (OptionConfig.IsPresent() && !Lockdown::LoadConfig(OptionConfig.Arg1().Chr(), config))
+		Lockdown::Metrics.Increment(Lockdown::Counter_ConfigErrors);
+	Lockdown::Config.Publish(config);
+	Lockdown::ApplySettings();
+
+	// The first deadline is armed before any optional work. Nothing after this can delay the lock, only when input
+	// starts being seen, and the full timeout is there to cover that.
+	Lockdown::DeadlineTimer timer;
+	if (!timer.IsValid())
+		return Lockdown::ExitCode_TimerFailure;
+
+	int64_t deadlineMs = 0;
+	Lockdown::Engine.Restart(Lockdown::GetTimeMs());
+	Lockdown::Scheduler.Update(Lockdown::GetTimeMs(), deadlineMs);
+	timer.Arm(deadlineMs);
+	Lockdown::Metrics.SetGauge(Lockdown::Gauge_StartupArmedUs, Lockdown::GetProcessAgeUs());
+
+	// Recording starts before any input is opened so the trace sees everything from the first event. The trace keeps
+	// the settings it started with. Start a new one to replay against reloaded timing.
+	if (OptionTrace.IsPresent())
+	{
+		Lockdown::TraceConfig traceConfig;
+		traceConfig.TimeoutMs			= config.TimeoutMs;
+		traceConfig.MaxSuspendMs		= config.MaxSuspendMs;
+		traceConfig.WindowMs			= config.WindowMs;
+		traceConfig.DistanceThreshold	= config.DistanceThreshold;
+		for (int s = 0; s < Lockdown::PolicyStage_NumStages; s++)
+		{
+			traceConfig.StageEnabled[s]		= config.StageEnabled[s];
+			traceConfig.StageOffsetMs[s]	= config.StageOffsetMs[s];
+		}
+		if (!Lockdown::Trace.Open(OptionTrace.Arg1().Chr(), traceConfig))
+		{
+			tPrintf("Couldn't open trace file %s.\n", OptionTrace.Arg1().Chr());
+			return Lockdown::ExitCode_TraceFailure;
+		}
+	}
+
+	if (OptionMetrics.IsPresent())
+	{
+		if (!Lockdown::Exporter.Start(OptionMetrics.Arg1().Chr()))
+		{
+			tPrintf("Couldn't serve metrics on socket %s.\n", OptionMetrics.Arg1().Chr());
+			return Lockdown::ExitCode_MetricsFailure;
+		}
+	}
+
+	int epollFD = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFD < 0)
+		return Lockdown::ExitCode_EpollFailure;
+
+	// Input is opened even with keyboard and mouse off, since a reload may turn them on. With no devices wanted it is
+	// just a directory watch. The gamepad ring is created up front for the same reason.
+	Lockdown::EvdevInput input(Lockdown::Coalescer, Lockdown::GetEvdevFlags(config), config.DistanceThreshold);
+	if (Lockdown::Trace.IsRecording())
+		input.SetTrace(&Lockdown::Trace);
+	if (!input.Open())
+		return Lockdown::ExitCode_InputFailure;
+
+	Lockdown::PadRingFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (Lockdown::PadRingFD < 0)
+		return Lockdown::ExitCode_GamepadHookFailure;
+	if (!Lockdown::ApplyInputs(input, epollFD))
+		return Lockdown::ExitCode_GamepadHookFailure;
+	tdPrintf("Monitoring %d input devices.\n", input.GetNumDevices());
+
+	if (OptionConfig.IsPresent() && !Lockdown::Watcher.Start(OptionConfig.Arg1().Chr()))
+		tPrintf("Couldn't watch config file %s. Changes need a restart.\n", OptionConfig.Arg1().Chr());
+
+	int signalFD = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	int watchFD = int(Lockdown::Watcher.GetWaitHandle());
+	int fds[] =
+	{
+		timer.GetFD(), input.GetFD(), signalFD, Lockdown::PadRingFD, watchFD, Lockdown::Control.GetFD(),
+		Lockdown::StatusTimer.GetFD()
+	};
+	for (int fd : fds)
+	{
+		if (fd < 0)
+			continue;
+		epoll_event ev = { };
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &ev);
+	}
+
+	// The one-shot deadline timer is re-armed each time it fires for whatever the next deadline is then. Startup is
+	// done, so from here on input, deadlines, and locks must not allocate.
+	bool running = true;
+	while (running)
+	{
+		Lockdown::SteadyStateScope steadyState;
+		epoll_event events[8];
+		int numEvents = epoll_wait(epollFD, events, 8, -1);
+		if ((numEvents < 0) && (errno != EINTR))
+			break;
+
+		for (int e = 0; e < numEvents; e++)
+		{
+			int fd = events[e].data.fd;
+			if (fd == input.GetFD())
+			{
+				input.Process();
+			}
+			else if (fd == Lockdown::PadRingFD)
+			{
+				uint64_t count;
+				if (read(Lockdown::PadRingFD, &count, sizeof(count)) > 0)
+					Lockdown::DrainPadRing();
+			}
+			else if ((Lockdown::PadWatchFD >= 0) && (fd == Lockdown::PadWatchFD))
+			{
+				// Failing to start here isn't fatal. Keyboard and mouse still count.
+				Lockdown::ProcessPadWatch();
+			}
+			else if (fd == Lockdown::Control.GetFD())
+			{
+				if (!Lockdown::ProcessControl())
+					continue;
+				int64_t nowMs = Lockdown::GetTimeMs();
+				uint32_t actions = Lockdown::Scheduler.Update(nowMs, deadlineMs);
+				Lockdown::PerformActions(actions, nowMs);
+				timer.Arm(deadlineMs);
+				Lockdown::PublishStatus(nowMs);
+			}
+			else if ((watchFD >= 0) && (fd == watchFD))
+			{
+				// The new settings may bring the deadline closer, so the timer is re-armed as if it had fired.
+				if (!Lockdown::Watcher.Acknowledge())
+					continue;
+				Lockdown::ReloadConfig(input, epollFD);
+				int64_t nowMs = Lockdown::GetTimeMs();
+				uint32_t actions = Lockdown::Scheduler.Update(nowMs, deadlineMs);
+				Lockdown::PerformActions(actions, nowMs);
+				timer.Arm(deadlineMs);
+				Lockdown::PublishStatus(nowMs);
+			}
+			else if (fd == timer.GetFD())
+			{
+				// Pad input that hasn't been drained yet must count before deciding what to do.
+				timer.Acknowledge();
+				Lockdown::DrainPadRing();
+				int64_t nowMs = Lockdown::GetTimeMs();
+				Lockdown::Metrics.RecordTimerWakeup(nowMs - deadlineMs);
+				uint32_t actions = Lockdown::Scheduler.Update(nowMs, deadlineMs);
+				Lockdown::PerformActions(actions, nowMs);
+				timer.Arm(deadlineMs);
+				Lockdown::PublishStatus(nowMs);
+				if (Lockdown::Config.GetNumRetired())
+					Lockdown::Config.Reclaim();
+			}
+			else if (fd == Lockdown::StatusTimer.GetFD())
+			{
+				// Only a watched countdown gets here. The schedule has its own timer, so this just shows the time.
+				Lockdown::StatusTimer.Acknowledge();
+				Lockdown::DrainPadRing();
+				Lockdown::PublishStatus(Lockdown::GetTimeMs());
+			}
+			else if (fd == signalFD)
+			{
+				signalfd_siginfo info;
+				while (read(signalFD, &info, sizeof(info)) == ssize_t(sizeof(info)))
+				{
+					if (info.ssi_signo == SIGCHLD)
+					{
+						Lockdown::HandleLockResult(Lockdown::Locker.Update());
+						Lockdown::ReapCommands();
+					}
+					else
+						running = false;
+				}
+			}
+		}
+	}
+
+	if (Lockdown::PadHook)
+		Lockdown::PadHook->stop();
+	Lockdown::DrainPadRing();
+	input.Close();
+	Lockdown::Trace.Close();
+	Lockdown::Exporter.Stop();
+	Lockdown::PrintActivityCounts();
+	if (signalFD >= 0)
+		close(signalFD);
+	if (Lockdown::PadRingFD >= 0)
+		close(Lockdown::PadRingFD);
+	if (Lockdown::PadWatchFD >= 0)
+		close(Lockdown::PadWatchFD);
+	Lockdown::Watcher.Stop();
+	Lockdown::Control.Stop();
+	close(epollFD);
+	return Lockdown::ExitCode_Success;
+}
@@ -0,0 +1,417 @@
+// LockdownReplay.cpp
+//
+// Replays an activity trace recorded with -t through the countdown logic on a virtual clock. The trace is memory-mapped
+// and every record is fed to the same coalescer, engine, and policy scheduler the app uses, with the stages recorded in
+// the trace and the mouse distance filter reproduced here. Time only advances as far as the next record or deadline so
+// a day of traffic replays in well under a second. The warnings, blanks, locks, and logouts the replay produces are
+// compared against the ones recorded in the trace and any that differ by more than the tolerance are reported. The exit
+// code is non-zero if any did, so field traces can be kept as regression tests.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <chrono>
+#include <vector>
+#include <System/tPrint.h>
+#include <System/tCmdLine.h>
+#include "Version.cmake.h"
+#include "IdleEngine.h"
+#include "PolicyScheduler.h"
+#include "ActivityCoalescer.h"
+#include "ActivityTrace.h"
+#include "MouseFilter.h"
+
+
+// Settings recorded in the trace are used unless overridden here.
+tCmdLine::tParam ParamTraceFile				(1, "TraceFile", "Trace file recorded with lockdown -t."				);
+tCmdLine::tOption OptionHelp				("Display help and usage screen.",		"help",			'h'			);
+tCmdLine::tOption OptionTimeoutMinutes		("Timeout in minutes.",					"minutes",		'm',	1	);
+tCmdLine::tOption OptionTimeoutSeconds		("Timeout in seconds.",					"seconds",		's',	1	);
+tCmdLine::tOption OptionWindow				("Coalescing window in ms.",			"window",		'w',	1	);
+tCmdLine::tOption OptionDistance			("Mouse distance threshold.",			"distance",		'd',	1	);
+tCmdLine::tOption OptionTolerance			("Lock time tolerance in ms.",			"tolerance",	'l',	1	);
+tCmdLine::tOption OptionVerbose				("Print every lock.",					"verbose",		'v'			);
+
+
+namespace Replay
+{
+	using namespace Lockdown;
+
+	enum ExitCode
+	{
+		ExitCode_Success,
+		ExitCode_LocksDiffer,
+		ExitCode_BadTrace
+	};
+
+	// Overrides from the command line. Negative means use the value from the trace.
+	int64_t TimeoutOverrideMs				= -1;
+	int64_t WindowOverrideMs				= -1;
+	int DistanceOverride					= -1;
+	int64_t ToleranceMs						= 1000;
+
+	// The state the app keeps outside the engine.
+	IdleEngine Engine;
+	PolicyScheduler Scheduler(Engine);
+	ActivityCoalescer Coalescer(Engine);
+	int64_t DeadlineMs						= 0;
+	int DistanceThreshold					= 20;
+	MouseFilter MouseMoveFilter(DistanceThreshold);
+	int AccumX								= 0;
+	int AccumY								= 0;
+
+	// Times each stage was performed by the scheduler in the current session. Explicit lock-now commands are not
+	// compared.
+	std::vector<int64_t> RecordedStages[PolicyStage_NumStages];
+	std::vector<int64_t> ReplayedStages[PolicyStage_NumStages];
+	int64_t SessionStartMs					= 0;
+	int NumSessions							= 0;
+	int NumMismatches						= 0;
+
+	void BeginSession(const TraceRecord&);
+	void EndSession();
+	void AdvanceTo(int64_t nowMs);
+	void PerformActions(uint32_t actions, int64_t nowMs);
+	void Apply(const TraceRecord&);
+	void ApplyMouseMove(int64_t nowMs, int x, int y, bool relative);
+	void FormatTime(char* dest, int size, int64_t ms);
+}
+
+
+void Replay::FormatTime(char* dest, int size, int64_t ms)
+{
+	int64_t secs = ms / 1000;
+	tsPrintf(dest, size, "%02d:%02d:%02d.%03d", int(secs / 3600), int((secs / 60) % 60), int(secs % 60), int(ms % 1000));
+}
+
+
+void Replay::BeginSession(const TraceRecord& sync)
+{
+	EndSession();
+	NumSessions++;
+	SessionStartMs = sync.TimeMs;
+
+	Engine.SetTimeout((TimeoutOverrideMs > 0) ? TimeoutOverrideMs : sync.TimeoutMs);
+	Engine.SetMaxSuspend(sync.MaxSuspendMs);
+	Coalescer.SetTimeout(Engine.GetTimeout());
+	Coalescer.SetWindows((WindowOverrideMs >= 0) ? WindowOverrideMs : sync.WindowMs);
+	DistanceThreshold = (DistanceOverride >= 0) ? DistanceOverride : sync.DistanceThreshold;
+	MouseMoveFilter.SetThreshold(DistanceThreshold);
+	MouseMoveFilter.Reset();
+	AccumX = AccumY = 0;
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+		Scheduler.SetStage(PolicyStage(s), sync.StageEnabled[s], sync.StageOffsetMs[s]);
+
+	// The app restarts the engine and arms the deadline the same way on startup.
+	Engine.Resume(sync.TimeMs);
+	Engine.Restart(sync.TimeMs);
+	Coalescer.Reset();
+	Scheduler.Update(sync.TimeMs, DeadlineMs);
+
+	char stages[128] = "";
+	int stagesLen = 0;
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		if (Scheduler.IsStageEnabled(PolicyStage(s)) && (s != PolicyStage_Lock))
+		{
+			stagesLen += tsPrintf
+			(
+				stages + stagesLen, int(sizeof(stages)) - stagesLen, ", %s %+lld ms", GetStageName(PolicyStage(s)),
+				(long long)Scheduler.GetStageOffset(PolicyStage(s))
+			);
+		}
+	}
+
+	tPrintf
+	(
+		"Session %d: timeout %lld ms, window %lld ms, distance %d%s\n", NumSessions,
+		(long long)Engine.GetTimeout(), (long long)Coalescer.GetWindow(ActivitySource_Keyboard), DistanceThreshold, stages
+	);
+}
+
+
+void Replay::EndSession()
+{
+	if (NumSessions == 0)
+		return;
+
+	// Walk both lists of each stage in time order. Times within the tolerance of each other are a match.
+	char timeStr[32];
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		const char* name = GetStageName(PolicyStage(s));
+		const std::vector<int64_t>& recorded = RecordedStages[s];
+		const std::vector<int64_t>& replayed = ReplayedStages[s];
+		size_t r = 0, p = 0;
+		while ((r < recorded.size()) || (p < replayed.size()))
+		{
+			bool haveRec = r < recorded.size();
+			bool haveRep = p < replayed.size();
+			int64_t diff = (haveRec && haveRep) ? replayed[p] - recorded[r] : 0;
+			if (haveRec && haveRep && (diff >= -ToleranceMs) && (diff <= ToleranceMs))
+			{
+				if (OptionVerbose.IsPresent())
+				{
+					FormatTime(timeStr, sizeof(timeStr), recorded[r] - SessionStartMs);
+					tPrintf("  %s %s (replay %+lld ms)\n", timeStr, name, (long long)diff);
+				}
+				r++;
+				p++;
+			}
+			else if (haveRec && (!haveRep || (recorded[r] < replayed[p])))
+			{
+				FormatTime(timeStr, sizeof(timeStr), recorded[r] - SessionStartMs);
+				tPrintf("  %s recorded %s missing from replay\n", timeStr, name);
+				NumMismatches++;
+				r++;
+			}
+			else
+			{
+				FormatTime(timeStr, sizeof(timeStr), replayed[p] - SessionStartMs);
+				tPrintf("  %s replayed %s not in recording\n", timeStr, name);
+				NumMismatches++;
+				p++;
+			}
+		}
+
+		RecordedStages[s].clear();
+		ReplayedStages[s].clear();
+	}
+}
+
+
+void Replay::AdvanceTo(int64_t nowMs)
+{
+	// Fire every deadline that falls before the next record exactly as the platform timer would.
+	while (DeadlineMs <= nowMs)
+	{
+		int64_t firedMs = DeadlineMs;
+		PerformActions(Scheduler.Update(firedMs, DeadlineMs), firedMs);
+	}
+}
+
+
+void Replay::PerformActions(uint32_t actions, int64_t nowMs)
+{
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		if (actions & (1u << s))
+			ReplayedStages[s].push_back(nowMs);
+	}
+
+	// The app resets the coalescer after locking since input on the lock screen is never seen.
+	if (actions & PolicyAction_Lock)
+		Coalescer.Reset();
+}
+
+
+void Replay::ApplyMouseMove(int64_t nowMs, int x, int y, bool relative)
+{
+	int64_t thresholdSq = int64_t(DistanceThreshold)*DistanceThreshold;
+
+	// The evdev backend accumulates relative motion and re-anchors whenever it passes the threshold, coalesced or not.
+	if (relative)
+	{
+		AccumX += x;
+		AccumY += y;
+		if ((int64_t(AccumX)*AccumX + int64_t(AccumY)*AccumY) <= thresholdSq)
+			return;
+
+		AccumX = AccumY = 0;
+		Coalescer.Report(ActivitySource_MouseMove, nowMs);
+		return;
+	}
+
+	// The Windows mouse hook skips the distance check entirely while the movement window is open.
+	if (Coalescer.TryCoalesce(ActivitySource_MouseMove, nowMs))
+		return;
+
+	if (MouseMoveFilter.Update(x, y))
+		Coalescer.Report(ActivitySource_MouseMove, nowMs);
+}
+
+
+void Replay::Apply(const TraceRecord& rec)
+{
+	int64_t nowMs = rec.TimeMs;
+	switch (rec.Type)
+	{
+		case TraceType_Sync:
+			break;
+
+		case TraceType_Key:
+			Coalescer.ReportKey(rec.Code, rec.Down, nowMs);
+			break;
+
+		case TraceType_MouseButton:
+			Coalescer.Report(ActivitySource_MouseButton, nowMs);
+			break;
+
+		case TraceType_MousePos:
+			ApplyMouseMove(nowMs, rec.X, rec.Y, false);
+			break;
+
+		case TraceType_MouseRel:
+			ApplyMouseMove(nowMs, rec.X, rec.Y, true);
+			break;
+
+		case TraceType_PadButton:
+			Coalescer.Report(ActivitySource_PadButton, nowMs);
+			break;
+
+		case TraceType_PadAxis:
+			Coalescer.Report(ActivitySource_PadAxis, nowMs);
+			break;
+
+		case TraceType_Command:
+			switch (rec.Code)
+			{
+				case TraceCommand_Warn:
+					RecordedStages[PolicyStage_Warn].push_back(nowMs);
+					break;
+
+				case TraceCommand_Blank:
+					RecordedStages[PolicyStage_Blank].push_back(nowMs);
+					break;
+
+				case TraceCommand_Lock:
+					RecordedStages[PolicyStage_Lock].push_back(nowMs);
+					break;
+
+				case TraceCommand_Logout:
+					RecordedStages[PolicyStage_Logout].push_back(nowMs);
+					break;
+
+				case TraceCommand_Suspend:
+					Engine.Suspend(nowMs);
+					break;
+
+				case TraceCommand_Resume:
+					Engine.Resume(nowMs);
+					Coalescer.Reset();
+					break;
+
+				case TraceCommand_SetRemaining:
+					Engine.SetRemaining(nowMs, rec.Value);
+					Coalescer.Reset(rec.Value);
+					break;
+
+				case TraceCommand_LockNow:
+					Engine.Resume(nowMs);
+					Coalescer.Reset();
+					break;
+
+				case TraceCommand_Exit:
+					// Reaching this record has already fired every deadline up to the exit.
+					break;
+			}
+
+			// Commands may move a deadline earlier so the app re-evaluates after each one.
+			PerformActions(Scheduler.Update(nowMs, DeadlineMs), nowMs);
+			break;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	tCmdLine::tParse(argc, argv);
+	if (OptionHelp.IsPresent() || !ParamTraceFile.IsPresent())
+	{
+		tCmdLine::tPrintUsage
+		(
+			u8"Tristan Grimmer",
+			u8""
+			"Replays a lockdown activity trace through the countdown logic on a virtual clock and "
+			"compares the resulting warnings, blanks, locks, and logouts against the ones recorded. The "
+			"timeout, coalescing window, and mouse distance threshold default to the values recorded in "
+			"the trace. Stages always come from the trace.",
+			LockdownVersion::Major, LockdownVersion::Minor, LockdownVersion::Revision
+		);
+		return Replay::ExitCode_Success;
+	}
+
+	int64_t timeoutOverrideMs = 0;
+	if (OptionTimeoutMinutes.IsPresent())
+		timeoutOverrideMs += 60000 * int64_t(OptionTimeoutMinutes.Arg1().AsInt());
+	if (OptionTimeoutSeconds.IsPresent())
+		timeoutOverrideMs += int64_t(OptionTimeoutSeconds.Arg1().AsFloat() * 1000.0f);
+	if (timeoutOverrideMs > 0)
+		Replay::TimeoutOverrideMs = timeoutOverrideMs;
+	if (OptionWindow.IsPresent())
+		Replay::WindowOverrideMs = OptionWindow.Arg1().AsInt();
+	if (OptionDistance.IsPresent())
+		Replay::DistanceOverride = OptionDistance.Arg1().AsInt();
+	if (OptionTolerance.IsPresent())
+		Replay::ToleranceMs = OptionTolerance.Arg1().AsInt();
+
+	Lockdown::ActivityTraceReader reader;
+	if (!reader.Open(ParamTraceFile.Get().Chr()))
+	{
+		tPrintf("Could not open trace %s.\n", ParamTraceFile.Get().Chr());
+		return Replay::ExitCode_BadTrace;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	int64_t numRecords = 0;
+	int64_t spanMs = 0;
+	int64_t sessionStartMs = 0;
+	Lockdown::TraceRecord rec;
+	while (reader.Next(rec))
+	{
+		numRecords++;
+		if (rec.Type == Lockdown::TraceType_Sync)
+		{
+			Replay::BeginSession(rec);
+			sessionStartMs = rec.TimeMs;
+			continue;
+		}
+
+		// Anything before the first sync has no configuration to replay against.
+		if (Replay::NumSessions == 0)
+			continue;
+
+		Replay::AdvanceTo(rec.TimeMs);
+		Replay::Apply(rec);
+		spanMs += rec.TimeMs - sessionStartMs;
+		sessionStartMs = rec.TimeMs;
+	}
+	Replay::EndSession();
+
+	if (reader.IsCorrupt())
+		tPrintf("Trace is corrupt after %lld records. Replayed what could be read.\n", (long long)numRecords);
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	tPrintf
+	(
+		"%lld records, %lld bytes, %d sessions, %.1f hours of activity replayed in %.3f s (%.0fx real time)\n",
+		(long long)numRecords, (long long)reader.GetSize(), Replay::NumSessions,
+		double(spanMs) / 3600000.0, elapsed, (elapsed > 0.0) ? double(spanMs) / 1000.0 / elapsed : 0.0
+	);
+
+	for (int s = 0; s < Lockdown::ActivitySource_NumSources; s++)
+	{
+		Lockdown::ActivitySource source = Lockdown::ActivitySource(s);
+		tPrintf
+		(
+			"%-12s accepted %llu coalesced %llu\n", Lockdown::GetSourceName(source),
+			(unsigned long long)Replay::Coalescer.GetNumAccepted(source),
+			(unsigned long long)Replay::Coalescer.GetNumCoalesced(source)
+		);
+	}
+
+	if (Replay::NumMismatches > 0)
+	{
+		tPrintf("%d mismatches.\n", Replay::NumMismatches);
+		return Replay::ExitCode_LocksDiffer;
+	}
+	return Replay::ExitCode_Success;
+}
@@ -0,0 +1,459 @@
+// Metrics.cpp
+//
+// Sharded counters and the Prometheus exporter.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#if defined(PLATFORM_WINDOWS)
+#include <winsock2.h>
+#include <afunix.h>
+#ifndef IO_REPARSE_TAG_AF_UNIX
+#define IO_REPARSE_TAG_AF_UNIX 0x80000023
+#endif
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "Metrics.h"
+
+
+namespace Lockdown
+{
+	struct CounterInfo
+	{
+		const char* Name;
+		const char* Help;
+	};
+
+	const CounterInfo CounterInfos[Counter_NumCounters] =
+	{
+		{ "locks",					"Locks due to the inactivity timeout."						},
+		{ "lock_now",				"Locks requested from the menu or control socket."			},
+		{ "warnings",				"Warnings shown ahead of a lock."							},
+		{ "blanks",					"Times the display was blanked ahead of a lock."			},
+		{ "logouts",				"Logouts after a lock."										},
+		{ "stages_cancelled",		"Countdowns cancelled by activity after a warn or blank."	},
+		{ "suspends",				"Times auto-locking was suspended."							},
+		{ "resumes",				"Times auto-locking was resumed early."						},
+		{ "set_remaining",			"Times the countdown was forced, as in lock in 10 seconds."	},
+		{ "timer_wakeups",			"Times the deadline timer fired."							},
+		{ "gamepad_connects",		"Gamepads connected."										},
+		{ "gamepad_disconnects",	"Gamepads disconnected."									},
+		{ "pad_records_dropped",	"Gamepad events dropped due to a full ring."				},
+		{ "config_reloads",			"Times the config file was reloaded and applied."			},
+		{ "config_errors",			"Config file loads rejected because of an error."			},
+		{ "control_requests",		"Commands received on the control socket."					},
+		{ "control_rejected",		"Control commands dropped for coming from another user."	},
+		{ "lock_failures",			"Locks that couldn't be started or that the locker failed."	},
+		{ "status_updates",			"Status text changes sent to the tray or to watchers."		}
+	};
+
+	#if defined(PLATFORM_WINDOWS)
+	const intptr_t InvalidSocket = intptr_t(INVALID_SOCKET);
+	void CloseSocket(intptr_t s)																						{ closesocket(SOCKET(s)); }
+	#else
+	const intptr_t InvalidSocket = -1;
+	void CloseSocket(intptr_t s)																						{ close(int(s)); }
+	#endif
+
+	const int AcceptBackoffMs = 100;
+
+	// What to do after accept fails.
+	enum AcceptError
+	{
+		AcceptError_Retry,														// The client went away. Accept the next one.
+		AcceptError_Wait,														// Out of descriptors or memory for now.
+		AcceptError_Fatal														// The socket is unusable or was shut down.
+	};
+	AcceptError GetAcceptError();
+
+	void AppendLine(std::string& out, const char* format, ...);
+	void AppendHeader(std::string& out, const char* name, const char* type, const char* help);
+}
+
+
+void Lockdown::AppendLine(std::string& out, const char* format, ...)
+{
+	char line[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (len > 0)
+		out.append(line, (len < int(sizeof(line))) ? len : int(sizeof(line)) - 1);
+}
+
+
+void Lockdown::AppendHeader(std::string& out, const char* name, const char* type, const char* help)
+{
+	AppendLine(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+Lockdown::MetricsRegistry::MetricsRegistry() :
+	NumShards(0)
+{
+	for (Shard& shard : Shards)
+		for (std::atomic<uint64_t>& count : shard.Counters)
+			count.store(0, std::memory_order_relaxed);
+
+	for (std::atomic<int64_t>& gauge : Gauges)
+		gauge.store(0, std::memory_order_relaxed);
+}
+
+
+Lockdown::MetricsRegistry::Shard& Lockdown::MetricsRegistry::ClaimShard()
+{
+	int index = NumShards.fetch_add(1, std::memory_order_relaxed);
+	return Shards[(index < SharedShard) ? index : SharedShard];
+}
+
+
+uint64_t Lockdown::MetricsRegistry::GetCounter(Counter counter) const
+{
+	// Unclaimed shards are zero so there is no need to know how many were claimed.
+	uint64_t total = 0;
+	for (const Shard& shard : Shards)
+		total += shard.Counters[counter].load(std::memory_order_relaxed);
+	return total;
+}
+
+
+void Lockdown::MetricsRegistry::RecordTimerWakeup(int64_t driftMs)
+{
+	// Firing early is not drift, it is the timer being re-armed for a later deadline.
+	if (driftMs < 0)
+		driftMs = 0;
+
+	Increment(Counter_TimerWakeups);
+	SetGauge(Gauge_TimerDriftMs, driftMs);
+	if (driftMs > GetGauge(Gauge_TimerDriftMaxMs))
+		SetGauge(Gauge_TimerDriftMaxMs, driftMs);
+}
+
+
+void Lockdown::MetricsRegistry::RecordLockIssued(int64_t latencyUs)
+{
+	SetGauge(Gauge_LockIssueUs, latencyUs);
+	if (latencyUs > GetGauge(Gauge_LockIssueMaxUs))
+		SetGauge(Gauge_LockIssueMaxUs, latencyUs);
+}
+
+
+void Lockdown::MetricsRegistry::RecordLockConfirmed(int64_t latencyUs)
+{
+	SetGauge(Gauge_LockConfirmUs, latencyUs);
+	if (latencyUs > GetGauge(Gauge_LockConfirmMaxUs))
+		SetGauge(Gauge_LockConfirmMaxUs, latencyUs);
+}
+
+
+const char* Lockdown::MetricsRegistry::GetCounterName(Counter counter)
+{
+	if ((counter < 0) || (counter >= Counter_NumCounters))
+		return "unknown";
+	return CounterInfos[counter].Name;
+}
+
+
+Lockdown::MetricsExporter::MetricsExporter(const MetricsRegistry& registry, const IdleEngine& engine, const ActivityCoalescer& coalescer) :
+	Registry(registry),
+	Engine(engine),
+	Coalescer(coalescer),
+	Running(false),
+	NumScrapes(0)
+{
+}
+
+
+void Lockdown::MetricsExporter::Format(std::string& out) const
+{
+	AppendHeader(out, "lockdown_events_total", "counter", "Input events that reached the coalescer, by source.");
+	for (int s = 0; s < ActivitySource_NumSources; s++)
+	{
+		ActivitySource source = ActivitySource(s);
+		uint64_t total = Coalescer.GetNumAccepted(source) + Coalescer.GetNumCoalesced(source);
+		AppendLine(out, "lockdown_events_total{source=\"%s\"} %llu\n", GetSourceName(source), (unsigned long long)total);
+	}
+
+	AppendHeader(out, "lockdown_countdown_resets_total", "counter", "Events that reset the countdown, by source.");
+	for (int s = 0; s < ActivitySource_NumSources; s++)
+	{
+		ActivitySource source = ActivitySource(s);
+		AppendLine
+		(
+			out, "lockdown_countdown_resets_total{source=\"%s\"} %llu\n",
+			GetSourceName(source), (unsigned long long)Coalescer.GetNumAccepted(source)
+		);
+	}
+
+	for (int c = 0; c < Counter_NumCounters; c++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "lockdown_%s_total", CounterInfos[c].Name);
+		AppendHeader(out, name, "counter", CounterInfos[c].Help);
+		AppendLine(out, "%s %llu\n", name, (unsigned long long)Registry.GetCounter(Counter(c)));
+	}
+
+	// Connects and disconnects are counted on the gamepad thread. The difference is the number attached.
+	int64_t numPads = int64_t(Registry.GetCounter(Counter_GamepadConnects) - Registry.GetCounter(Counter_GamepadDisconnects));
+	AppendHeader(out, "lockdown_gamepads_attached", "gauge", "Gamepads currently attached.");
+	AppendLine(out, "lockdown_gamepads_attached %lld\n", (long long)numPads);
+
+	AppendHeader(out, "lockdown_timer_drift_ms", "gauge", "How late the deadline timer fired last time.");
+	AppendLine(out, "lockdown_timer_drift_ms %lld\n", (long long)Registry.GetGauge(Gauge_TimerDriftMs));
+	AppendHeader(out, "lockdown_timer_drift_max_ms", "gauge", "The latest the deadline timer has ever fired.");
+	AppendLine(out, "lockdown_timer_drift_max_ms %lld\n", (long long)Registry.GetGauge(Gauge_TimerDriftMaxMs));
+	AppendHeader(out, "lockdown_startup_armed_us", "gauge", "Process start to first deadline armed in microseconds.");
+	AppendLine(out, "lockdown_startup_armed_us %lld\n", (long long)Registry.GetGauge(Gauge_StartupArmedUs));
+	AppendHeader(out, "lockdown_config_generation", "gauge", "Config generation in use. Each reload adds one.");
+	AppendLine(out, "lockdown_config_generation %lld\n", (long long)Registry.GetGauge(Gauge_ConfigGeneration));
+
+	// Zero until the first lock. The maximums are what an audit of how quickly an idle session locks needs.
+	AppendHeader(out, "lockdown_lock_issue_us", "gauge", "Lock due to lock issued last time, in microseconds.");
+	AppendLine(out, "lockdown_lock_issue_us %lld\n", (long long)Registry.GetGauge(Gauge_LockIssueUs));
+	AppendHeader(out, "lockdown_lock_issue_max_us", "gauge", "Longest lock due to lock issued.");
+	AppendLine(out, "lockdown_lock_issue_max_us %lld\n", (long long)Registry.GetGauge(Gauge_LockIssueMaxUs));
+	AppendHeader(out, "lockdown_lock_confirm_us", "gauge", "Lock issued to lock confirmed last time, in microseconds.");
+	AppendLine(out, "lockdown_lock_confirm_us %lld\n", (long long)Registry.GetGauge(Gauge_LockConfirmUs));
+	AppendHeader(out, "lockdown_lock_confirm_max_us", "gauge", "Longest lock issued to lock confirmed.");
+	AppendLine(out, "lockdown_lock_confirm_max_us %lld\n", (long long)Registry.GetGauge(Gauge_LockConfirmMaxUs));
+
+	int64_t nowMs = GetTimeMs();
+	bool enabled = Engine.IsEnabled(nowMs);
+	int64_t remainingMs = enabled ? Engine.GetRemaining(nowMs) : 0;
+	AppendHeader(out, "lockdown_suspended", "gauge", "1 if auto-locking is suspended.");
+	AppendLine(out, "lockdown_suspended %d\n", enabled ? 0 : 1);
+	AppendHeader(out, "lockdown_remaining_seconds", "gauge", "Time before the session locks if there is no input.");
+	AppendLine(out, "lockdown_remaining_seconds %.3f\n", double((remainingMs > 0) ? remainingMs : 0) / 1000.0);
+	AppendHeader(out, "lockdown_timeout_seconds", "gauge", "The inactivity timeout.");
+	AppendLine(out, "lockdown_timeout_seconds %.3f\n", double(Engine.GetTimeout()) / 1000.0);
+
+	AppendHeader(out, "lockdown_scrapes_total", "counter", "Metrics requests served, including this one.");
+	AppendLine(out, "lockdown_scrapes_total %llu\n", (unsigned long long)(GetNumScrapes() + 1));
+}
+
+
+bool Lockdown::MetricsExporter::Start(const char* socketPath)
+{
+	Stop();
+	if (!socketPath || !*socketPath)
+		return false;
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	size_t pathLen = strlen(socketPath);
+	if (pathLen >= sizeof(addr.sun_path))
+		return false;
+	memcpy(addr.sun_path, socketPath, pathLen);
+	int addrLen = int(offsetof(sockaddr_un, sun_path) + pathLen + 1);
+
+	#if defined(PLATFORM_WINDOWS)
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+	intptr_t listenSocket = intptr_t(socket(AF_UNIX, SOCK_STREAM, 0));
+
+	// A socket file left over from a previous run would make bind fail. Unix sockets show up as reparse points with
+	// their own tag, so only ever remove one of those, never a regular file that happens to have been given as the path.
+	WIN32_FIND_DATAA found;
+	HANDLE find = FindFirstFileA(socketPath, &found);
+	if (find != INVALID_HANDLE_VALUE)
+	{
+		FindClose(find);
+		if ((found.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && (found.dwReserved0 == IO_REPARSE_TAG_AF_UNIX))
+			DeleteFileA(socketPath);
+	}
+
+	#else
+	intptr_t listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketPath[0] == '@')
+	{
+		// Abstract namespace. The name is not nul terminated and the socket disappears with the process.
+		addr.sun_path[0] = 0;
+		addrLen = int(offsetof(sockaddr_un, sun_path) + pathLen);
+	}
+	else
+	{
+		// A socket left over from a previous run would make bind fail. Only ever remove a socket, never a regular file
+		// that happens to have been given as the path.
+		struct stat st;
+		if ((lstat(socketPath, &st) == 0) && S_ISSOCK(st.st_mode))
+			unlink(socketPath);
+	}
+	#endif
+
+	if (listenSocket == InvalidSocket)
+		return false;
+
+	if ((bind(listenSocket, (const sockaddr*)&addr, addrLen) != 0) || (listen(listenSocket, 4) != 0))
+	{
+		CloseSocket(listenSocket);
+		return false;
+	}
+
+	SocketPath = socketPath;
+	ListenSocket = listenSocket;
+	Running.store(true, std::memory_order_relaxed);
+	Thread = std::thread(&MetricsExporter::Serve, this);
+	return true;
+}
+
+
+void Lockdown::MetricsExporter::Stop()
+{
+	if (!Running.exchange(false))
+		return;
+
+	// Shutting down the listening socket wakes the thread out of accept.
+	#if defined(PLATFORM_WINDOWS)
+	shutdown(SOCKET(ListenSocket), SD_BOTH);
+	#else
+	shutdown(int(ListenSocket), SHUT_RDWR);
+	#endif
+	CloseSocket(ListenSocket);
+	if (Thread.joinable())
+		Thread.join();
+	ListenSocket = InvalidSocket;
+
+	#if defined(PLATFORM_WINDOWS)
+	remove(SocketPath.c_str());
+	WSACleanup();
+	#else
+	if (SocketPath[0] != '@')
+		unlink(SocketPath.c_str());
+	#endif
+}
+
+
+void Lockdown::MetricsExporter::Serve()
+{
+	while (Running.load(std::memory_order_relaxed))
+	{
+		#if defined(PLATFORM_WINDOWS)
+		intptr_t client = intptr_t(accept(SOCKET(ListenSocket), nullptr, nullptr));
+		#else
+		intptr_t client = accept4(int(ListenSocket), nullptr, nullptr, SOCK_CLOEXEC);
+		#endif
+		if (client == InvalidSocket)
+		{
+			// Retrying straight away when out of descriptors would spin until one frees up.
+			AcceptError error = GetAcceptError();
+			if (error == AcceptError_Fatal)
+				break;
+			if (error == AcceptError_Wait)
+				std::this_thread::sleep_for(std::chrono::milliseconds(AcceptBackoffMs));
+			continue;
+		}
+
+		ServeClient(client);
+		CloseSocket(client);
+	}
+}
+
+
+Lockdown::AcceptError Lockdown::GetAcceptError()
+{
+	#if defined(PLATFORM_WINDOWS)
+	switch (WSAGetLastError())
+	{
+		case WSAEINTR:
+		case WSAECONNRESET:
+			return AcceptError_Retry;
+		case WSAEMFILE:
+		case WSAENOBUFS:
+			return AcceptError_Wait;
+	}
+	#else
+	switch (errno)
+	{
+		case EINTR:
+		case ECONNABORTED:
+		case EPROTO:
+			return AcceptError_Retry;
+		case EMFILE:
+		case ENFILE:
+		case ENOBUFS:
+		case ENOMEM:
+			return AcceptError_Wait;
+	}
+	#endif
+	return AcceptError_Fatal;
+}
+
+
+void Lockdown::MetricsExporter::ServeClient(intptr_t client)
+{
+	// Read whatever request there is. Scrapers send a short HTTP request. A client that sends nothing is answered
+	// once it half-closes or after the timeout.
+	#if defined(PLATFORM_WINDOWS)
+	DWORD timeoutMs = 1000;
+	setsockopt(SOCKET(client), SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeoutMs, sizeof(timeoutMs));
+	#else
+	timeval timeout = { 1, 0 };
+	setsockopt(int(client), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	#endif
+
+	char request[1024];
+	int requestLen = 0;
+	while (requestLen < int(sizeof(request)) - 1)
+	{
+		int numRead = int(recv(client, request + requestLen, int(sizeof(request)) - 1 - requestLen, 0));
+		if (numRead <= 0)
+			break;
+		requestLen += numRead;
+		request[requestLen] = 0;
+		if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+			break;
+	}
+	request[requestLen] = 0;
+
+	std::string body;
+	body.reserve(4096);
+	Format(body);
+
+	std::string response;
+	if (strncmp(request, "GET ", 4) == 0)
+	{
+		AppendLine
+		(
+			response,
+			"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+			int(body.size())
+		);
+	}
+	response += body;
+
+	#if defined(PLATFORM_WINDOWS)
+	int flags = 0;
+	#else
+	int flags = MSG_NOSIGNAL;
+	#endif
+	for (size_t sent = 0; sent < response.size(); )
+	{
+		int numSent = int(send(client, response.data() + sent, int(response.size() - sent), flags));
+		if (numSent <= 0)
+			break;
+		sent += size_t(numSent);
+	}
+
+	NumScrapes.fetch_add(1, std::memory_order_relaxed);
+}
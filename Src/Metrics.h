@@ -0,0 +1,176 @@
+// Metrics.h
+//
+// Operational counters and gauges, and an exporter that serves them in the Prometheus text format over a Unix domain
+// socket. Counters are sharded per thread. Each thread that increments a counter claims a cache-line aligned shard on
+// first use and from then on only ever writes its own shard with a relaxed load and store, so counting costs the same
+// as incrementing a plain integer. Shards are only summed when the metrics are read. Per-source input event counts are
+// not duplicated here. They already live in the activity coalescer and the exporter reads them from there, so the hook
+// paths pay nothing extra.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "IdleEngine.h"
+#include "ActivityCoalescer.h"
+
+
+namespace Lockdown
+{
+	enum Counter
+	{
+		Counter_Locks,															// Locks due to the timeout.
+		Counter_LockNow,														// Locks requested by the user.
+		Counter_Warnings,														// Staged policy warnings before a lock.
+		Counter_Blanks,
+		Counter_Logouts,
+		Counter_StagesCancelled,												// Activity after a stage was performed.
+		Counter_Suspends,
+		Counter_Resumes,
+		Counter_SetRemaining,													// Lock-in-10-seconds and similar.
+		Counter_TimerWakeups,													// Times the deadline timer fired.
+		Counter_GamepadConnects,
+		Counter_GamepadDisconnects,
+		Counter_PadRecordsDropped,												// Gamepad events lost to a full ring.
+		Counter_ConfigReloads,
+		Counter_ConfigErrors,													// Reloads rejected. The old config stays.
+		Counter_ControlRequests,												// Commands from lockdownctl and the like.
+		Counter_ControlRejected,												// Commands from other users, dropped.
+		Counter_LockFailures,													// The lock couldn't be started or failed.
+		Counter_StatusUpdates,													// Tooltip or watcher text changes sent.
+		Counter_NumCounters
+	};
+
+	// Gauges are set, not added, and have a single writer each (the engine thread) so they are not sharded.
+	enum Gauge
+	{
+		Gauge_TimerDriftMs,														// How late the deadline timer fired last time.
+		Gauge_TimerDriftMaxMs,													// The worst it has ever been.
+		Gauge_StartupArmedUs,													// Process creation to first deadline armed.
+		Gauge_ConfigGeneration,													// Bumped by each config published.
+		Gauge_LockIssueUs,														// Lock due to lock issued, last time.
+		Gauge_LockIssueMaxUs,
+		Gauge_LockConfirmUs,													// Lock issued to lock confirmed, last time.
+		Gauge_LockConfirmMaxUs,
+		Gauge_NumGauges
+	};
+
+	class MetricsRegistry
+	{
+	public:
+		MetricsRegistry();
+
+		// Safe to call from any thread.
+		void Increment(Counter counter)																					{ Add(counter, 1); }
+		inline void Add(Counter, uint64_t amount);
+
+		// Call from the engine thread each time the deadline timer fires, with how late it fired relative to the deadline
+		// it was armed for.
+		void RecordTimerWakeup(int64_t driftMs);
+
+		// Call from the engine thread when a lock is issued, with how long after it was due that was, and when it is
+		// confirmed, with how long after it was issued.
+		void RecordLockIssued(int64_t latencyUs);
+		void RecordLockConfirmed(int64_t latencyUs);
+
+		void SetGauge(Gauge gauge, int64_t value)																		{ Gauges[gauge].store(value, std::memory_order_relaxed); }
+
+		// Reading sums every shard. The result may miss increments that are in flight, which is fine for monitoring.
+		uint64_t GetCounter(Counter) const;
+		int64_t GetGauge(Gauge gauge) const																				{ return Gauges[gauge].load(std::memory_order_relaxed); }
+
+		// Returns a short lowercase name for the counter, for example "timer_wakeups".
+		static const char* GetCounterName(Counter);
+
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> Counters[Counter_NumCounters];
+		};
+
+		// Every thread gets a shard of its own except that threads beyond the first MaxShards-1 all share the last one,
+		// which is updated with atomic adds instead. The app has a handful of threads.
+		static const int MaxShards = 16;
+		static const int SharedShard = MaxShards - 1;
+
+		inline Shard& GetShard();
+		Shard& ClaimShard();
+
+		Shard Shards[MaxShards];
+		std::atomic<int> NumShards;
+		std::atomic<int64_t> Gauges[Gauge_NumGauges];
+	};
+
+	// Serves the metrics on a Unix domain socket from its own thread, which sleeps in accept until a scrape arrives. A
+	// request beginning with GET (for example curl --unix-socket) gets an HTTP response. Anything else, including a
+	// client that just half-closes or sends nothing for a second, gets the bare text. On Linux a path beginning with @
+	// is placed in the abstract namespace.
+	class MetricsExporter
+	{
+	public:
+		MetricsExporter(const MetricsRegistry&, const IdleEngine&, const ActivityCoalescer&);
+		~MetricsExporter()																								{ Stop(); }
+
+		bool Start(const char* socketPath);
+		void Stop();
+
+		// Appends the Prometheus text exposition of every metric.
+		void Format(std::string&) const;
+
+		uint64_t GetNumScrapes() const																					{ return NumScrapes.load(std::memory_order_relaxed); }
+
+	private:
+		void Serve();
+		void ServeClient(intptr_t client);
+
+		const MetricsRegistry& Registry;
+		const IdleEngine& Engine;
+		const ActivityCoalescer& Coalescer;
+
+		std::string SocketPath;
+		intptr_t ListenSocket					= -1;
+		std::atomic<bool> Running;
+		std::atomic<uint64_t> NumScrapes;
+		std::thread Thread;
+	};
+}
+
+
+// Implementation below this line.
+
+
+inline Lockdown::MetricsRegistry::Shard& Lockdown::MetricsRegistry::GetShard()
+{
+	// A thread keeps its shard for its lifetime. Checking the owner lets more than one registry exist.
+	thread_local MetricsRegistry* owner = nullptr;
+	thread_local Shard* shard = nullptr;
+	if (owner != this)
+	{
+		shard = &ClaimShard();
+		owner = this;
+	}
+	return *shard;
+}
+
+
+inline void Lockdown::MetricsRegistry::Add(Counter counter, uint64_t amount)
+{
+	Shard& shard = GetShard();
+	std::atomic<uint64_t>& count = shard.Counters[counter];
+	if (&shard == &Shards[SharedShard])
+		count.fetch_add(amount, std::memory_order_relaxed);
+	else
+		count.store(count.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+// MouseFilter.h
+//
+// The mouse movement filter. A pointer position only counts as activity once it is further than a threshold from the
+// last position that counted. This ignores desk bumps and optical sensor jitter. Shared by the Windows mouse hook, the
+// trace replayer, and the benchmark so they all measure the same thing.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+
+
+namespace Lockdown
+{
+	class MouseFilter
+	{
+	public:
+		MouseFilter(int distanceThreshold)																				{ SetThreshold(distanceThreshold); }
+
+		void SetThreshold(int distanceThreshold)																		{ Threshold = distanceThreshold; ThresholdSq = int64_t(distanceThreshold)*distanceThreshold; }
+		int GetThreshold() const																						{ return Threshold; }
+
+		// Returns true if the position is further than the threshold from the anchor, in which case the position becomes
+		// the new anchor. Positions may be negative with multiple monitors. The comparison is done squared so there is no
+		// square root.
+		inline bool Update(int x, int y);
+
+		// The anchor starts at the origin, so the first real move almost always counts.
+		void Reset(int x = 0, int y = 0)																				{ AnchorX = x; AnchorY = y; }
+
+	private:
+		int Threshold							= 0;
+		int64_t ThresholdSq						= 0;
+		int AnchorX								= 0;
+		int AnchorY								= 0;
+	};
+}
+
+
+// Implementation below this line.
+
+
+inline bool Lockdown::MouseFilter::Update(int x, int y)
+{
+	int64_t dx = int64_t(x) - AnchorX;
+	int64_t dy = int64_t(y) - AnchorY;
+	if ((dx*dx + dy*dy) <= ThresholdSq)
+		return false;
+
+	AnchorX = x;
+	AnchorY = y;
+	return true;
+}
@@ -0,0 +1,160 @@
+// PolicyScheduler.cpp
+//
+// Staged idle policy on a timing wheel. See PolicyScheduler.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "PolicyScheduler.h"
+
+
+const char* Lockdown::GetStageName(PolicyStage stage)
+{
+	static const char* names[PolicyStage_NumStages] = { "warn", "blank", "lock", "logout" };
+	return ((stage >= 0) && (stage < PolicyStage_NumStages)) ? names[stage] : "unknown";
+}
+
+
+Lockdown::PolicyScheduler::PolicyScheduler(IdleEngine& engine) :
+	Engine(engine)
+{
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		Stages[s].Enabled = (s == PolicyStage_Lock);
+		Stages[s].OffsetMs = 0;
+		Stages[s].DueMs = 0;
+		Stages[s].Timer.ID = s;
+	}
+	SuspendTimer.ID = PolicyStage_NumStages;
+}
+
+
+void Lockdown::PolicyScheduler::SetStage(PolicyStage stage, bool enabled, int64_t offsetMs)
+{
+	// Setting a stage to what it already is must not re-arm, since that would cancel a countdown in progress.
+	if (stage == PolicyStage_Lock)
+		return;
+	if ((Stages[stage].Enabled == enabled) && (Stages[stage].OffsetMs == offsetMs))
+		return;
+
+	Stages[stage].Enabled = enabled;
+	Stages[stage].OffsetMs = offsetMs;
+
+	// Picked up by the next Update.
+	Armed = false;
+}
+
+
+uint32_t Lockdown::PolicyScheduler::Update(int64_t nowMs, int64_t& nextDeadlineMs)
+{
+	NumUpdates++;
+	if (!Started)
+	{
+		Wheel.Reset(nowMs);
+		Started = true;
+	}
+
+	uint32_t actions = PolicyAction_None;
+	if (Engine.IsEnabled(nowMs))
+	{
+		// A suspend that was being waited on has ended, either by expiring or by a resume.
+		if (SuspendTimer.IsArmed())
+		{
+			Wheel.Cancel(SuspendTimer);
+			actions |= PolicyAction_Resume;
+		}
+
+		// Activity or a command moved the countdown. However many events did it, this is one re-arm of each stage.
+		int64_t lockDeadlineMs = Engine.GetLockDeadline();
+		if (!Armed || (lockDeadlineMs != ArmedLockDeadlineMs))
+		{
+			if (Performed)
+				actions |= PolicyAction_Cancel;
+			Performed = 0;
+			ArmStages(lockDeadlineMs);
+		}
+	}
+	else
+	{
+		if (Armed)
+		{
+			if (Performed)
+				actions |= PolicyAction_Cancel;
+			Performed = 0;
+			CancelStages();
+		}
+		if (!SuspendTimer.IsArmed() || (SuspendTimer.DeadlineMs != Engine.GetSuspendDeadline()))
+			Wheel.Arm(SuspendTimer, Engine.GetSuspendDeadline());
+	}
+
+	// The suspend timer can't expire here. Its deadline is when the engine becomes enabled, which is handled above.
+	PolicyStage lastStage = GetLastStage();
+	WheelTimer* expired = Wheel.Advance(nowMs);
+	bool restart = false;
+	while (expired)
+	{
+		WheelTimer* timer = expired;
+		expired = TimingWheel::GetNextExpired(timer);
+		actions |= 1u << timer->ID;
+		Performed |= 1u << timer->ID;
+		if (timer->ID < PolicyStage_NumStages)
+			Stages[timer->ID].DueMs = timer->DeadlineMs;
+		if (timer->ID == lastStage)
+			restart = true;
+	}
+
+	// Restarting moves the lock deadline. The new stages are armed here so the move isn't seen as activity.
+	if (restart)
+	{
+		Engine.Restart(nowMs);
+		Performed = 0;
+		ArmStages(Engine.GetLockDeadline());
+	}
+
+	nextDeadlineMs = Wheel.GetNextDeadline();
+	return actions;
+}
+
+
+void Lockdown::PolicyScheduler::ArmStages(int64_t lockDeadlineMs)
+{
+	int64_t timeoutMs = Engine.GetTimeout();
+	for (Stage& stage : Stages)
+	{
+		if (stage.Enabled && (stage.OffsetMs > -timeoutMs))
+			Wheel.Arm(stage.Timer, lockDeadlineMs + stage.OffsetMs);
+		else
+			Wheel.Cancel(stage.Timer);
+	}
+	ArmedLockDeadlineMs = lockDeadlineMs;
+	Armed = true;
+}
+
+
+void Lockdown::PolicyScheduler::CancelStages()
+{
+	for (Stage& stage : Stages)
+		Wheel.Cancel(stage.Timer);
+	Armed = false;
+}
+
+
+Lockdown::PolicyStage Lockdown::PolicyScheduler::GetLastStage() const
+{
+	// The stage with the latest offset. Later stages win ties since that is the order they are performed in.
+	PolicyStage last = PolicyStage_Lock;
+	for (int s = 0; s < PolicyStage_NumStages; s++)
+	{
+		if (Stages[s].Enabled && (Stages[s].OffsetMs >= Stages[last].OffsetMs))
+			last = PolicyStage(s);
+	}
+	return last;
+}
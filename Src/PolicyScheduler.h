@@ -0,0 +1,103 @@
+// PolicyScheduler.h
+//
+// Staged idle policy. Rather than a single lock at the deadline, a countdown can pass through a series of stages, each
+// at a fixed offset from the lock deadline: a warning before it, blanking the display, the lock itself, and logging out
+// some time after. Each stage and the suspend expiry is a timer on a hierarchical timing wheel. As with the
+// LockScheduler, activity never touches a timer. When the platform timer fires and the lock deadline is found to have
+// moved, every stage is re-armed for the new deadline, which costs O(1) per stage however many events moved it, and
+// any stage already performed is reported as cancelled so it can be undone. With only the lock stage enabled the
+// behaviour and wakeups are exactly those of the LockScheduler.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include "IdleEngine.h"
+#include "TimingWheel.h"
+
+
+namespace Lockdown
+{
+	// In the order they happen in. Stages with the same offset are performed in this order too.
+	enum PolicyStage
+	{
+		PolicyStage_Warn,
+		PolicyStage_Blank,
+		PolicyStage_Lock,
+		PolicyStage_Logout,
+		PolicyStage_NumStages
+	};
+	const char* GetStageName(PolicyStage);
+
+	// Update returns a mask of these. Each stage has the bit 1 << stage.
+	enum PolicyAction : uint32_t
+	{
+		PolicyAction_None						= 0,
+		PolicyAction_Warn						= 1 << PolicyStage_Warn,
+		PolicyAction_Blank						= 1 << PolicyStage_Blank,
+		PolicyAction_Lock						= 1 << PolicyStage_Lock,
+		PolicyAction_Logout						= 1 << PolicyStage_Logout,
+		PolicyAction_Cancel						= 1 << PolicyStage_NumStages,	// Activity came after a stage was performed.
+		PolicyAction_Resume						= 1 << (PolicyStage_NumStages + 1)	// A suspend expired.
+	};
+
+	class PolicyScheduler
+	{
+	public:
+		// Only the lock stage is enabled to begin with.
+		PolicyScheduler(IdleEngine&);
+
+		// Offsets are from the lock deadline, negative for before it. A stage that would come before the countdown
+		// starts (an offset earlier than minus the timeout) is skipped. The lock stage is always enabled at offset zero
+		// so the engine's remaining time stays the time to the lock.
+		void SetStage(PolicyStage, bool enabled, int64_t offsetMs);
+		bool IsStageEnabled(PolicyStage stage) const																	{ return Stages[stage].Enabled; }
+		int64_t GetStageOffset(PolicyStage stage) const																	{ return Stages[stage].OffsetMs; }
+
+		// Call whenever the platform timer fires, or after anything that may have moved a deadline earlier. Returns the
+		// PolicyActions to perform now, stages in stage order, and fills in the absolute deadline the timer should next
+		// be armed for. When the last enabled stage is performed the countdown is restarted, so with no further input
+		// the stages repeat every timeout just as locking does with the LockScheduler.
+		uint32_t Update(int64_t nowMs, int64_t& nextDeadlineMs);
+
+		// Stages performed so far in the current countdown. Cleared by activity and by the restart after the last one.
+		uint32_t GetPerformed() const																					{ return Performed; }
+
+		// When a stage was last due, so how late it was performed can be measured. Zero if it never has been.
+		int64_t GetDueTime(PolicyStage stage) const																		{ return Stages[stage].DueMs; }
+		int64_t GetNumUpdates() const																					{ return NumUpdates; }
+
+	private:
+		struct Stage
+		{
+			bool Enabled;
+			int64_t OffsetMs;
+			int64_t DueMs;
+			WheelTimer Timer;
+		};
+
+		// Arms every enabled stage relative to the lock deadline. Each is an O(1) cancel and arm.
+		void ArmStages(int64_t lockDeadlineMs);
+		void CancelStages();
+		PolicyStage GetLastStage() const;
+
+		IdleEngine& Engine;
+		TimingWheel Wheel;
+		Stage Stages[PolicyStage_NumStages];
+		WheelTimer SuspendTimer;
+		bool Started							= false;
+		bool Armed								= false;
+		int64_t ArmedLockDeadlineMs				= 0;
+		uint32_t Performed						= 0;
+		int64_t NumUpdates						= 0;
+	};
+}
@@ -0,0 +1,194 @@
+// SessionTable.cpp
+//
+// Struct-of-arrays idle tracking for many sessions. See SessionTable.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <limits>
+#include "SessionTable.h"
+
+
+void Lockdown::SessionTable::SetTimeout(int64_t timeoutMs)
+{
+	TimeoutMs = timeoutMs;
+	for (int s = 0; s < GetNumSessions(); s++)
+		UpdateDeadline(s);
+}
+
+
+int Lockdown::SessionTable::Add(int64_t nowMs)
+{
+	if (NumSessions == int(DeadlineMs.size()))
+		DeadlineMs.resize(NumSessions + Lanes, std::numeric_limits<int64_t>::max());
+
+	int session = NumSessions++;
+	DeadlineMs[session] = nowMs + TimeoutMs;
+	LastActivityMs.push_back(nowMs);
+	SuspendUntilMs.push_back(std::numeric_limits<int64_t>::min());
+	Enabled.push_back(1);
+	return session;
+}
+
+
+int Lockdown::SessionTable::Remove(int session)
+{
+	int last = NumSessions - 1;
+	int moved = -1;
+	if (session != last)
+	{
+		DeadlineMs[session]		= DeadlineMs[last];
+		LastActivityMs[session]	= LastActivityMs[last];
+		SuspendUntilMs[session]	= SuspendUntilMs[last];
+		Enabled[session]		= Enabled[last];
+		moved = last;
+	}
+
+	// The vacated slot becomes padding.
+	DeadlineMs[last] = std::numeric_limits<int64_t>::max();
+	NumSessions--;
+	if (int(DeadlineMs.size()) - NumSessions >= 2*Lanes)
+		DeadlineMs.resize(DeadlineMs.size() - Lanes);
+	LastActivityMs.pop_back();
+	SuspendUntilMs.pop_back();
+	Enabled.pop_back();
+	return moved;
+}
+
+
+void Lockdown::SessionTable::Reserve(int numSessions)
+{
+	DeadlineMs.reserve(numSessions + Lanes);
+	LastActivityMs.reserve(numSessions);
+	SuspendUntilMs.reserve(numSessions);
+	Enabled.reserve(numSessions);
+}
+
+
+void Lockdown::SessionTable::ReportActivity(int session, int64_t timeMs)
+{
+	if (timeMs <= LastActivityMs[session])
+		return;
+
+	LastActivityMs[session] = timeMs;
+	if (Enabled[session])
+		UpdateDeadline(session);
+}
+
+
+int64_t Lockdown::SessionTable::GetLockDeadline(int session) const
+{
+	// As in the IdleEngine, a suspend that has ended counts as activity at the moment it ended.
+	int64_t lastActivity = LastActivityMs[session];
+	int64_t suspendUntil = SuspendUntilMs[session];
+	return ((suspendUntil > lastActivity) ? suspendUntil : lastActivity) + TimeoutMs;
+}
+
+
+void Lockdown::SessionTable::Suspend(int session, int64_t nowMs)
+{
+	SuspendUntilMs[session] = nowMs + MaxSuspendMs;
+	Enabled[session] = 0;
+	UpdateDeadline(session);
+}
+
+
+void Lockdown::SessionTable::Resume(int session, int64_t nowMs)
+{
+	if (Enabled[session])
+		return;
+
+	SuspendUntilMs[session] = nowMs;
+	Enabled[session] = 1;
+	UpdateDeadline(session);
+}
+
+
+void Lockdown::SessionTable::SetRemaining(int session, int64_t nowMs, int64_t remainingMs)
+{
+	SuspendUntilMs[session] = std::numeric_limits<int64_t>::min();
+	LastActivityMs[session] = nowMs + remainingMs - TimeoutMs;
+	Enabled[session] = 1;
+	UpdateDeadline(session);
+}
+
+
+int64_t Lockdown::SessionTable::CollectDue(int64_t nowMs, std::vector<int>& due) const
+{
+	// The sweep keeps a running earliest pending deadline per lane and a due flag per group of lanes. It is done with
+	// subtracts, shifts, and masks rather than comparisons because SSE2 has no 64-bit compare and without one the
+	// compiler won't vectorise a 64-bit min. For non-negative times the top bit of a - b - 1 is set exactly when a <= b.
+	// A due session's deadline is replaced by INT64_MAX so it doesn't count as pending.
+	const int64_t* deadlines = DeadlineMs.data();
+	int numGroups = int(DeadlineMs.size()) / Lanes;
+	int64_t earliest[Lanes];
+	for (int l = 0; l < Lanes; l++)
+		earliest[l] = std::numeric_limits<int64_t>::max();
+
+	for (int g = 0; g < numGroups; g++)
+	{
+		const int64_t* group = deadlines + g*Lanes;
+		uint64_t anyDue = 0;
+		for (int l = 0; l < Lanes; l++)
+		{
+			uint64_t isDue = uint64_t(group[l] - nowMs - 1) >> 63;
+			int64_t pending = group[l] | int64_t((0 - isDue) >> 1);
+			uint64_t isEarlier = uint64_t(pending - earliest[l]) >> 63;
+			earliest[l] ^= (pending ^ earliest[l]) & int64_t(0 - isEarlier);
+			anyDue |= isDue;
+		}
+
+		// Due sessions are rare so the group is only looked at again if it has one. Padding is never due.
+		if (anyDue)
+		{
+			for (int l = 0; l < Lanes; l++)
+				if (group[l] <= nowMs)
+					due.push_back(g*Lanes + l);
+		}
+	}
+
+	int64_t result = std::numeric_limits<int64_t>::max();
+	for (int l = 0; l < Lanes; l++)
+		result = (earliest[l] < result) ? earliest[l] : result;
+	return result;
+}
+
+
+Lockdown::LockScheduler::Action Lockdown::SessionTable::Update(int session, int64_t nowMs, int64_t& nextDeadlineMs)
+{
+	LockScheduler::Action action = LockScheduler::Action::None;
+	if (!Enabled[session] && (SuspendUntilMs[session] <= nowMs))
+		Enabled[session] = 1;
+
+	if (Enabled[session] && (GetLockDeadline(session) <= nowMs))
+	{
+		LastActivityMs[session] = nowMs;
+		action = LockScheduler::Action::Lock;
+	}
+
+	UpdateDeadline(session);
+	nextDeadlineMs = DeadlineMs[session];
+	return action;
+}
+
+
+size_t Lockdown::SessionTable::GetNumBytesAllocated() const
+{
+	return
+		DeadlineMs.capacity()*sizeof(int64_t) + LastActivityMs.capacity()*sizeof(int64_t) +
+		SuspendUntilMs.capacity()*sizeof(int64_t) + Enabled.capacity()*sizeof(uint8_t);
+}
+
+
+void Lockdown::SessionTable::UpdateDeadline(int session)
+{
+	DeadlineMs[session] = Enabled[session] ? GetLockDeadline(session) : SuspendUntilMs[session];
+}
@@ -0,0 +1,97 @@
+// SessionTable.h
+//
+// Idle tracking for many sessions at once, as used by the headless daemon. Each session has the same countdown and
+// suspend behaviour as the IdleEngine but the state is kept struct-of-arrays, one densely packed array per field. The
+// hot path is the sweep for due sessions, which reads only the array of next deadlines and so streams through 8 bytes
+// per session with no branches, in a form the compiler vectorises with nothing more than SSE2. Everything else about a
+// session (its name, how to probe it for activity) is kept by the caller in parallel arrays of its own, indexed the
+// same way. This file has no dependencies on windows.h or Tacent.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "LockScheduler.h"
+
+
+namespace Lockdown
+{
+	class SessionTable
+	{
+	public:
+		SessionTable(int64_t timeoutMs = 20*60*1000, int64_t maxSuspendMs = 3*60*60*1000)								: TimeoutMs(timeoutMs), MaxSuspendMs(maxSuspendMs) { }
+
+		// Configuration. The timeout applies to every session. Changing it moves the deadline of every enabled session.
+		void SetTimeout(int64_t timeoutMs);
+		int64_t GetTimeout() const																						{ return TimeoutMs; }
+		void SetMaxSuspend(int64_t maxSuspendMs)																		{ MaxSuspendMs = maxSuspendMs; }
+		int64_t GetMaxSuspend() const																					{ return MaxSuspendMs; }
+
+		// Adds a session whose countdown starts now and returns its index. Indices are dense. Remove moves the last
+		// session into the removed slot and returns the index it came from so the caller can move its own per-session
+		// data the same way. Returns -1 if nothing moved.
+		int Add(int64_t nowMs);
+		int Remove(int session);
+		int GetNumSessions() const																						{ return NumSessions; }
+		void Reserve(int numSessions);
+
+		// Activity only ever moves a countdown later. A time earlier than the last activity already recorded, as an
+		// activity probe may return, is ignored.
+		void ReportActivity(int session, int64_t timeMs);
+		int64_t GetLastActivity(int session) const																		{ return LastActivityMs[session]; }
+
+		// Per-session state with the same meaning as the IdleEngine functions of the same name.
+		bool IsEnabled(int session) const																				{ return Enabled[session] != 0; }
+		int64_t GetLockDeadline(int session) const;
+		int64_t GetSuspendDeadline(int session) const																	{ return SuspendUntilMs[session]; }
+		int64_t GetNextDeadline(int session) const																		{ return DeadlineMs[session]; }
+		int64_t GetRemaining(int session, int64_t nowMs) const															{ return GetLockDeadline(session) - nowMs; }
+		void Suspend(int session, int64_t nowMs);
+		void Resume(int session, int64_t nowMs);
+		void SetRemaining(int session, int64_t nowMs, int64_t remainingMs);
+
+		// Appends every session whose next deadline is at or before nowMs to due and returns the earliest deadline of
+		// the rest, or INT64_MAX if there are none. Call Update on each due session and take the earlier of the result
+		// and the deadlines Update hands back to know when to sweep next. Times must not be negative, which GetTimeMs
+		// times never are.
+		int64_t CollectDue(int64_t nowMs, std::vector<int>& due) const;
+
+		// The per-session equivalent of LockScheduler::Update. An expired suspend is resumed. If the lock deadline has
+		// passed the countdown is restarted and Lock is returned. Either way the session's next deadline is returned
+		// in nextDeadlineMs.
+		LockScheduler::Action Update(int session, int64_t nowMs, int64_t& nextDeadlineMs);
+
+		// Bytes of table state per session, and bytes currently allocated including spare capacity. Only the table's own
+		// arrays are counted. Whatever per-session data the caller keeps alongside it, like names, is not.
+		static constexpr size_t GetTableBytesPerSession()																{ return 3*sizeof(int64_t) + sizeof(uint8_t); }
+		size_t GetNumBytesAllocated() const;
+
+	private:
+		// The deadline array is padded with never-due entries to a whole number of lanes so the sweep has no remainder
+		// loop. Lanes is the most 64-bit values any target's vectors hold.
+		static const int Lanes = 8;
+
+		// Recomputes the one deadline the sweep reads from the rest of the session state.
+		void UpdateDeadline(int session);
+
+		int64_t TimeoutMs;
+		int64_t MaxSuspendMs;
+		int NumSessions = 0;
+
+		// The sweep only touches DeadlineMs. It is the lock deadline while enabled and the suspend expiry otherwise.
+		std::vector<int64_t> DeadlineMs;
+		std::vector<int64_t> LastActivityMs;
+		std::vector<int64_t> SuspendUntilMs;
+		std::vector<uint8_t> Enabled;																					// Zero while suspended.
+	};
+}
@@ -0,0 +1,57 @@
+// StatusText.cpp
+//
+// Status text for the tray and status watchers. See StatusText.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include "StatusText.h"
+
+
+bool Lockdown::StatusText::Update(const IdleEngine& engine, int64_t nowMs)
+{
+	char text[MaxLength+1];
+	if (!engine.IsEnabled(nowMs))
+	{
+		// Resuming is up to the engine, which re-evaluates the schedule when it happens.
+		snprintf(text, sizeof(text), "Lockdown Disabled");
+		NextChangeMs = NoChange;
+	}
+	else
+	{
+		// Rounded up, so the text reads 1 minute until the last minute starts and never shows zero before the lock.
+		int64_t remainingMs = engine.GetRemaining(nowMs);
+		int64_t minutes = (remainingMs + 59999) / 60000;
+		int64_t seconds = (remainingMs + 999) / 1000;
+		if (remainingMs <= 0)
+		{
+			snprintf(text, sizeof(text), "Locking");
+			NextChangeMs = NoChange;
+		}
+		else if (minutes > 1)
+		{
+			snprintf(text, sizeof(text), "Lock in %d minutes", int(minutes));
+			NextChangeMs = nowMs + remainingMs - (minutes - 1)*60000;
+		}
+		else
+		{
+			snprintf(text, sizeof(text), "Lock in %d second%s", int(seconds), (seconds == 1) ? "" : "s");
+			NextChangeMs = nowMs + remainingMs - (seconds - 1)*1000;
+		}
+	}
+
+	if (strcmp(text, Text) == 0)
+		return false;
+	memcpy(Text, text, sizeof(Text));
+	return true;
+}
@@ -0,0 +1,46 @@
+// StatusText.h
+//
+// The one line of status shown in the tray tooltip on Windows and sent to status watchers on Linux. It is the time left
+// before a lock, in minutes while that is more than a minute and in seconds after, or that auto-locking is suspended.
+// The text is only as fine as it is shown, so for most of a countdown it changes once a minute. Update says when it
+// changed, and the shell or a watcher is only bothered with actual changes. GetNextChange gives when the countdown
+// alone will next change it, for anyone showing it live. This file has no dependencies on windows.h or Tacent.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include "IdleEngine.h"
+
+
+namespace Lockdown
+{
+	class StatusText
+	{
+	public:
+		// Longest text, not counting the terminator. Fits the 128 character tray tooltip.
+		static const int MaxLength				= 63;
+
+		// Works out the text for the engine's state at nowMs. Returns true if it differs from the last time.
+		bool Update(const IdleEngine&, int64_t nowMs);
+		const char* Get() const																							{ return Text; }
+
+		// When the countdown next changes the text, in GetTimeMs time, or NoChange if only the engine can. Activity
+		// changes it too, which is not predicted. The text lags it until the next Update.
+		static const int64_t NoChange			= INT64_MAX;
+		int64_t GetNextChange() const																					{ return NextChangeMs; }
+
+	private:
+		char Text[MaxLength+1]					= { };
+		int64_t NextChangeMs					= NoChange;
+	};
+}
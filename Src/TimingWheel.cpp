@@ -0,0 +1,190 @@
+// TimingWheel.cpp
+//
+// Hierarchical timing wheel. See TimingWheel.h.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <bit>
+#include <limits>
+#include "TimingWheel.h"
+
+
+void Lockdown::TimingWheel::Reset(int64_t nowMs)
+{
+	for (WheelTimer*& head : Slots)
+	{
+		for (WheelTimer* timer = head; timer; timer = timer->Next)
+			timer->Slot = -1;
+		head = nullptr;
+	}
+	for (uint64_t& occupied : Occupied)
+		occupied = 0;
+	CurrentMs = nowMs;
+}
+
+
+void Lockdown::TimingWheel::Arm(WheelTimer& timer, int64_t deadlineMs)
+{
+	if (timer.IsArmed())
+		Unlink(timer);
+
+	timer.DeadlineMs = deadlineMs;
+	if (deadlineMs <= CurrentMs)
+	{
+		Link(timer, ExpiredSlot);
+		return;
+	}
+
+	// The level is the one holding the most significant bit the deadline differs from the current time in. Within that
+	// level the deadline's slot is always after the current one, which is what lets GetNextDeadline stop early.
+	uint64_t differs = uint64_t(deadlineMs) ^ uint64_t(CurrentMs);
+	int level = (63 - std::countl_zero(differs)) / SlotBits;
+	if (level >= NumLevels)
+		level = NumLevels - 1;
+	int slot = int(uint64_t(deadlineMs) >> (level*SlotBits)) & (NumSlots - 1);
+	Link(timer, level*NumSlots + slot);
+}
+
+
+void Lockdown::TimingWheel::Cancel(WheelTimer& timer)
+{
+	if (timer.IsArmed())
+		Unlink(timer);
+}
+
+
+Lockdown::WheelTimer* Lockdown::TimingWheel::Advance(int64_t nowMs)
+{
+	// Gather everything in a slot that has been passed. Once a level hasn't moved no coarser one has either.
+	WheelTimer* passed = Slots[ExpiredSlot];
+	Slots[ExpiredSlot] = nullptr;
+	if (nowMs > CurrentMs)
+	{
+		for (int level = 0; level < NumLevels; level++)
+		{
+			uint64_t currentPos = uint64_t(CurrentMs) >> (level*SlotBits);
+			uint64_t nowPos = uint64_t(nowMs) >> (level*SlotBits);
+			uint64_t numElapsed = nowPos - currentPos;
+			if (numElapsed == 0)
+				break;
+
+			uint64_t mask = ~uint64_t(0);
+			if (numElapsed < NumSlots)
+				mask = std::rotl((uint64_t(1) << numElapsed) - 1, int((currentPos + 1) & (NumSlots - 1)));
+			mask &= Occupied[level];
+			Occupied[level] &= ~mask;
+			while (mask)
+			{
+				int slot = level*NumSlots + std::countr_zero(mask);
+				mask &= mask - 1;
+
+				WheelTimer* tail = Slots[slot];
+				while (tail->Next)
+					tail = tail->Next;
+				tail->Next = passed;
+				passed = Slots[slot];
+				Slots[slot] = nullptr;
+			}
+		}
+		CurrentMs = nowMs;
+	}
+
+	// Due timers are returned in deadline order. The rest cascade to a finer level relative to the new time.
+	WheelTimer* expired = nullptr;
+	while (passed)
+	{
+		WheelTimer* timer = passed;
+		passed = passed->Next;
+		timer->Slot = -1;
+		timer->Prev = nullptr;
+		timer->Next = nullptr;
+		if (timer->DeadlineMs > CurrentMs)
+		{
+			Arm(*timer, timer->DeadlineMs);
+			continue;
+		}
+
+		// Few timers expire at once so an insertion sort is fine. Equal deadlines go in ID order.
+		WheelTimer** link = &expired;
+		while
+		(
+			*link && (((*link)->DeadlineMs < timer->DeadlineMs) ||
+			(((*link)->DeadlineMs == timer->DeadlineMs) && ((*link)->ID <= timer->ID)))
+		)
+			link = &(*link)->Next;
+		timer->Next = *link;
+		*link = timer;
+	}
+
+	return expired;
+}
+
+
+int64_t Lockdown::TimingWheel::GetNextDeadline() const
+{
+	int64_t earliest = std::numeric_limits<int64_t>::max();
+	for (const WheelTimer* timer = Slots[ExpiredSlot]; timer; timer = timer->Next)
+		earliest = (timer->DeadlineMs < earliest) ? timer->DeadlineMs : earliest;
+
+	// At each level every timer is in a slot after the current one, so the first occupied slot after it holds that
+	// level's earliest. Deadlines too far out for the top level may be anywhere in it, so it is searched in full.
+	for (int level = 0; level < NumLevels; level++)
+	{
+		uint64_t occupied = Occupied[level];
+		if (level < NumLevels - 1)
+		{
+			int currentSlot = int(uint64_t(CurrentMs) >> (level*SlotBits)) & (NumSlots - 1);
+			occupied &= (currentSlot == NumSlots - 1) ? 0 : (~uint64_t(0) << (currentSlot + 1));
+			occupied &= -occupied;
+		}
+
+		while (occupied)
+		{
+			int slot = level*NumSlots + std::countr_zero(occupied);
+			occupied &= occupied - 1;
+			for (const WheelTimer* timer = Slots[slot]; timer; timer = timer->Next)
+				earliest = (timer->DeadlineMs < earliest) ? timer->DeadlineMs : earliest;
+		}
+	}
+
+	return earliest;
+}
+
+
+void Lockdown::TimingWheel::Link(WheelTimer& timer, int slot)
+{
+	timer.Slot = slot;
+	timer.Prev = nullptr;
+	timer.Next = Slots[slot];
+	if (timer.Next)
+		timer.Next->Prev = &timer;
+	Slots[slot] = &timer;
+	if (slot != ExpiredSlot)
+		Occupied[slot / NumSlots] |= uint64_t(1) << (slot % NumSlots);
+}
+
+
+void Lockdown::TimingWheel::Unlink(WheelTimer& timer)
+{
+	if (timer.Prev)
+		timer.Prev->Next = timer.Next;
+	else
+		Slots[timer.Slot] = timer.Next;
+	if (timer.Next)
+		timer.Next->Prev = timer.Prev;
+
+	if (!Slots[timer.Slot] && (timer.Slot != ExpiredSlot))
+		Occupied[timer.Slot / NumSlots] &= ~(uint64_t(1) << (timer.Slot % NumSlots));
+	timer.Slot = -1;
+	timer.Prev = nullptr;
+	timer.Next = nullptr;
+}
@@ -0,0 +1,77 @@
+// TimingWheel.h
+//
+// A hierarchical timing wheel of intrusive millisecond timers. Arming and cancelling are O(1): a timer is linked into
+// the slot of the coarsest level its deadline differs from the current time in, and unlinked again. Advancing the
+// wheel only visits the slots that have been passed, found from a per-level occupancy mask, so a jump of hours costs
+// the same as a jump of a millisecond. Timers that land in a passed slot but aren't due yet cascade to a finer level.
+// The next deadline is exact rather than a slot boundary so the platform timer never wakes just to cascade. This file
+// has no dependencies on windows.h or Tacent.
+//
+// Copyright (c) 2025 Tristan Grimmer.
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <cstdint>
+
+
+namespace Lockdown
+{
+	// Embed one of these per thing that needs a deadline. It must not move or be destroyed while armed.
+	struct WheelTimer
+	{
+		int64_t DeadlineMs						= 0;
+		int ID									= 0;														// For the owner to tell its timers apart.
+		bool IsArmed() const																							{ return Slot >= 0; }
+
+	private:
+		friend class TimingWheel;
+		WheelTimer* Prev						= nullptr;
+		WheelTimer* Next						= nullptr;
+		int Slot								= -1;														// Level*NumSlots + slot, or ExpiredSlot.
+	};
+
+	class TimingWheel
+	{
+	public:
+		// Times must not be negative, which GetTimeMs times never are.
+		TimingWheel(int64_t nowMs = 0)																					: CurrentMs(nowMs) { }
+
+		// Forgets every timer and restarts the wheel at nowMs.
+		void Reset(int64_t nowMs);
+		int64_t GetCurrentTime() const																					{ return CurrentMs; }
+
+		// Arms or re-arms a timer. A deadline at or before the current time fires on the next Advance.
+		void Arm(WheelTimer&, int64_t deadlineMs);
+		void Cancel(WheelTimer&);
+
+		// Moves the wheel to nowMs and returns every timer that expired, earliest deadline first, linked through
+		// GetNextExpired. The returned timers are no longer armed. Get the next one before re-arming any. A time before
+		// the current time doesn't move the wheel.
+		WheelTimer* Advance(int64_t nowMs);
+		static WheelTimer* GetNextExpired(const WheelTimer* timer)														{ return timer->Next; }
+
+		// The earliest deadline of all armed timers, or INT64_MAX if none are.
+		int64_t GetNextDeadline() const;
+
+	private:
+		static const int SlotBits				= 6;
+		static const int NumSlots				= 1 << SlotBits;
+		static const int NumLevels				= 6;														// 2^36 ms is a little over two years.
+		static const int ExpiredSlot			= NumLevels*NumSlots;
+
+		void Link(WheelTimer&, int slot);
+		void Unlink(WheelTimer&);
+
+		int64_t CurrentMs;
+		uint64_t Occupied[NumLevels]			= { };
+		WheelTimer* Slots[NumLevels*NumSlots + 1] = { };													// The last is the expired list.
+	};
+}
@@ -1,5 +1,5 @@
 #pragma once
-#define set(verStr) namespace LockdownVersion { extern int Major, Minor, Revision; struct Parser { Parser(const char*);  }; static Parser parser(#verStr); }
+#define set(verStr) namespace LockdownVersion { constexpr int GetComponent(const char* str, int index) { while (*str && ((*str < '0') || (*str > '9'))) str++; for (; *str && (index > 0); str++) if (*str == '.') index--; int value = 0; for (; (*str >= '0') && (*str <= '9'); str++) value = 10*value + (*str - '0'); return value; } constexpr int Major = GetComponent(verStr, 0); constexpr int Minor = GetComponent(verStr, 1); constexpr int Revision = GetComponent(verStr, 2); }
 
 set("LOCKDOWN_VERSION" "1.0.4")
 